@@ -0,0 +1,47 @@
+#include "AST.h"
+
+namespace
+{
+	const size_t maxPooledLists = 1024;	// per thread
+
+	/**
+	 * Spare lists of one thread. Lists released after the thread's
+	 * spares are gone are simply freed.
+	 */
+	struct SpareLists
+	{
+		vector<vector<Statement*>> lists;
+		bool open = true;
+
+		~SpareLists()
+		{
+			open = false;
+		}
+	};
+
+	thread_local SpareLists spareLists;
+}
+
+vector<Statement*> StatementListPool::take()
+{
+	vector<Statement*> list;
+	if (spareLists.open && !spareLists.lists.empty())
+	{
+		list.swap(spareLists.lists.back());
+		spareLists.lists.pop_back();
+	}
+	return list;
+}
+
+void StatementListPool::release(vector<Statement*>& list)
+{
+	// Nodes may be deleted on another thread than the one that made them
+	// (see Pipeline), so the spares are capped like NodePool's
+	list.clear();
+	if (list.capacity() == 0 || !spareLists.open || spareLists.lists.size() >= maxPooledLists)
+	{
+		return;
+	}
+	spareLists.lists.emplace_back();
+	spareLists.lists.back().swap(list);
+}
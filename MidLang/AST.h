@@ -3,18 +3,36 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <cstddef>
+#include "NodePool.h"
 
 using namespace std;
 
 /**
  * Abstract Syntax Tree (AST) nodes.
  * The AST represents the structure of the program.
+ * Each node owns its children and deletes them when destroyed.
  */
 
 // Forward declarations
 class Statement;
 class Expression;
 
+/**
+ * Recycles the storage of the statement lists of deleted nodes (per
+ * thread), for the parser and the passes that build new lists. The nodes
+ * themselves come from NodePool.
+ */
+class StatementListPool
+{
+public:
+	// An empty list, with the storage of one released before if there is one
+	static vector<Statement*> take();
+
+	// Keeps the storage of list for take() and leaves list empty
+	static void release(vector<Statement*>& list);
+};
+
 /**
  * Root node representing an entire program.
  */
@@ -22,10 +40,23 @@ class ProgramNode
 {
 public:
 	vector<Statement*> statements;
+	const vector<string>* slotNames = nullptr;	// variable name of each slot: the Resolver's, set by it
 
 	ProgramNode(vector<Statement*> stmts)
-		: statements(stmts)
+		: statements(move(stmts))
+	{
+	}
+
+	~ProgramNode();
+
+	static void* operator new(size_t size)
+	{
+		return NodePool::allocate(size);
+	}
+
+	static void operator delete(void* block, size_t size)
 	{
+		NodePool::release(block, size);
 	}
 };
 
@@ -36,6 +67,16 @@ class Statement
 {
 public:
 	virtual ~Statement() = default;
+
+	static void* operator new(size_t size)
+	{
+		return NodePool::allocate(size);
+	}
+
+	static void operator delete(void* block, size_t size)
+	{
+		NodePool::release(block, size);
+	}
 };
 
 /**
@@ -46,11 +87,16 @@ class VarDeclarationStatement : public Statement
 public:
 	string variableName;
 	Expression* expression;
+	int slot = -1;	// assigned by Resolver
+	int line = 0;
+	int column = 0;
 
-	VarDeclarationStatement(const string& name, Expression* expr)
-		: variableName(name), expression(expr)
+	VarDeclarationStatement(string name, Expression* expr)
+		: variableName(move(name)), expression(expr)
 	{
 	}
+
+	~VarDeclarationStatement();
 };
 
 /**
@@ -61,11 +107,16 @@ class AssignmentStatement : public Statement
 public:
 	string variableName;
 	Expression* expression;
+	int slot = -1;	// assigned by Resolver
+	int line = 0;
+	int column = 0;
 
-	AssignmentStatement(const string& name, Expression* expr)
-		: variableName(name), expression(expr)
+	AssignmentStatement(string name, Expression* expr)
+		: variableName(move(name)), expression(expr)
 	{
 	}
+
+	~AssignmentStatement();
 };
 
 /**
@@ -80,6 +131,8 @@ public:
 		: expression(expr)
 	{
 	}
+
+	~PrintStatement();
 };
 
 /**
@@ -89,6 +142,16 @@ class Expression
 {
 public:
 	virtual ~Expression() = default;
+
+	static void* operator new(size_t size)
+	{
+		return NodePool::allocate(size);
+	}
+
+	static void operator delete(void* block, size_t size)
+	{
+		NodePool::release(block, size);
+	}
 };
 
 /**
@@ -111,8 +174,11 @@ class VariableReference : public Expression
 {
 public:
 	string name;
+	int slot = -1;	// assigned by Resolver
+	int line = 0;
+	int column = 0;
 
-	VariableReference(const string& n) : name(n)
+	VariableReference(string n) : name(move(n))
 	{
 	}
 };
@@ -132,6 +198,12 @@ public:
 		: left(l), op(o), right(r)
 	{
 	}
+
+	~BinaryExpression()
+	{
+		delete left;
+		delete right;
+	}
 };
 
 /**
@@ -161,6 +233,12 @@ public:
 		: left(l), op(o), right(r)
 	{
 	}
+
+	~BooleanExpression()
+	{
+		delete left;
+		delete right;
+	}
 };
 
 /**
@@ -175,6 +253,11 @@ public:
 		: expression(expr)
 	{
 	}
+
+	~PrintLineStatement()
+	{
+		delete expression;
+	}
 };
 
 /**
@@ -188,9 +271,24 @@ public:
 	vector<Statement*> elseStatements; // empty if no else clause
 
 	IfStatement(BooleanExpression* cond, vector<Statement*> thenStmts, vector<Statement*> elseStmts = {})
-		: condition(cond), thenStatements(thenStmts), elseStatements(elseStmts)
+		: condition(cond), thenStatements(move(thenStmts)), elseStatements(move(elseStmts))
 	{
 	}
+
+	~IfStatement()
+	{
+		delete condition;
+		for (auto* stmt : thenStatements)
+		{
+			delete stmt;
+		}
+		for (auto* stmt : elseStatements)
+		{
+			delete stmt;
+		}
+		StatementListPool::release(thenStatements);
+		StatementListPool::release(elseStatements);
+	}
 };
 
 /**
@@ -203,7 +301,43 @@ public:
 	vector<Statement*> bodyStatements;
 
 	WhileStatement(BooleanExpression* cond, vector<Statement*> bodyStmts)
-		: condition(cond), bodyStatements(bodyStmts)
+		: condition(cond), bodyStatements(move(bodyStmts))
+	{
+	}
+
+	~WhileStatement()
+	{
+		delete condition;
+		for (auto* stmt : bodyStatements)
+		{
+			delete stmt;
+		}
+		StatementListPool::release(bodyStatements);
+	}
+};
+
+// Destructors that need the complete Statement/Expression types
+
+inline ProgramNode::~ProgramNode()
+{
+	for (auto* stmt : statements)
 	{
+		delete stmt;
 	}
-};
\ No newline at end of file
+	StatementListPool::release(statements);
+}
+
+inline VarDeclarationStatement::~VarDeclarationStatement()
+{
+	delete expression;
+}
+
+inline AssignmentStatement::~AssignmentStatement()
+{
+	delete expression;
+}
+
+inline PrintStatement::~PrintStatement()
+{
+	delete expression;
+}
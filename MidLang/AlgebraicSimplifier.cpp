@@ -0,0 +1,561 @@
+#include "AlgebraicSimplifier.h"
+#include "AllocProfiler.h"
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	// a compare b is b mirrored a
+	IrCompare mirror(IrCompare compare)
+	{
+		switch (compare)
+		{
+		case IrCompare::Less: return IrCompare::Greater;
+		case IrCompare::Greater: return IrCompare::Less;
+		case IrCompare::LessEqual: return IrCompare::GreaterEqual;
+		case IrCompare::GreaterEqual: return IrCompare::LessEqual;
+		default: return compare;
+		}
+	}
+
+	// 1 for + and -, 2 for *, 0 for the rest
+	int family(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+		case IrOpcode::Add:
+		case IrOpcode::Subtract:
+			return 1;
+		case IrOpcode::Multiply:
+			return 2;
+		default:
+			return 0;
+		}
+	}
+
+	bool fits(long long value)
+	{
+		return value >= INT_MIN && value <= INT_MAX;
+	}
+}
+
+AlgebraicSimplifier::AlgebraicSimplifier()
+	: currentBlock(0), simplifiedCount(0), removedOperationCount(0), normalizedCount(0)
+{
+}
+
+void AlgebraicSimplifier::reset()
+{
+	simplifiedCount = 0;
+	removedOperationCount = 0;
+	normalizedCount = 0;
+}
+
+void AlgebraicSimplifier::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	countUses(program);
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		vector<IrInstruction>& instructions = program.blocks[b].instructions;
+		currentBlock = static_cast<int>(b);
+		findLinks(instructions);
+		replacement.assign(instructions.size(), make_pair(-1, -1));
+		dropped.assign(instructions.size(), 0);
+		added.clear();
+
+		// Chains are read from their last operation; the links they take
+		// are dropped once the last one is rebuilt
+		bool changed = false;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const IrInstruction& instruction = instructions[i];
+			if (!instruction.definesValue() || isLink(instruction.dest))
+			{
+				continue;
+			}
+
+			int begin = static_cast<int>(added.size());
+			bool rebuilt = false;
+			if (instruction.opcode == IrOpcode::Divide)
+			{
+				rebuilt = simplifyDivide(instruction);
+			}
+			else if (family(instruction.opcode) != 0)
+			{
+				Chain chain = { 0, false, 0, 1, instruction.opcode == IrOpcode::Multiply ? 1u : 0u, false, false };
+				links.clear();
+				copies.clear();
+				terms.clear();
+				collect(instructions, instruction, false, chain);
+				rebuilt = instruction.opcode == IrOpcode::Multiply
+					? rebuildProduct(program, instruction, chain) : rebuildSum(program, instruction, chain);
+				for (size_t k = 0; rebuilt && k < links.size(); k++)
+				{
+					dropped[links[k]] = 1;
+				}
+				for (size_t k = 0; rebuilt && k < copies.size(); k++)
+				{
+					replacement[copies[k]].second = replacement[copies[k]].first;
+				}
+			}
+			if (rebuilt)
+			{
+				replacement[i] = make_pair(begin, static_cast<int>(added.size()));
+				changed = true;
+			}
+		}
+
+		if (changed)
+		{
+			rewritten.clear();
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (replacement[i].first >= 0)
+				{
+					rewritten.insert(rewritten.end(), added.begin() + replacement[i].first,
+						added.begin() + replacement[i].second);
+				}
+				else if (!dropped[i])
+				{
+					rewritten.push_back(instructions[i]);
+				}
+			}
+			instructions.swap(rewritten);
+		}
+		normalize(instructions);
+	}
+}
+
+void AlgebraicSimplifier::countUses(const IrProgram& program)
+{
+	size_t count = static_cast<size_t>(program.temporaryCount);
+	useCount.assign(count, 0);
+	use.assign(count, make_pair(-1, -1));
+	definition.assign(count, -1);
+	link.assign(count, 0);
+	reducedTo.assign(count, IrOperand());
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[b].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			for (const IrOperand* operand : { &instructions[i].left, &instructions[i].right })
+			{
+				if (operand->kind == IrOperand::Temporary)
+				{
+					useCount[operand->value]++;
+					use[operand->value] = make_pair(static_cast<int>(b), static_cast<int>(i));
+				}
+			}
+		}
+	}
+}
+
+void AlgebraicSimplifier::findLinks(const vector<IrInstruction>& instructions)
+{
+	storesBefore.resize(instructions.size() + 1);
+	int stores = 0;
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		storesBefore[i] = stores;
+		if (instructions[i].definesValue() && instructions[i].dest.kind == IrOperand::Variable)
+		{
+			stores++;
+		}
+	}
+	storesBefore[instructions.size()] = stores;
+
+	// A link is used once, later in the block, by an operation of its own
+	// kind, and no variable it may read is stored before that
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		const IrInstruction& instruction = instructions[i];
+		if (!instruction.definesValue() || instruction.dest.kind != IrOperand::Temporary)
+		{
+			continue;
+		}
+		int temporary = instruction.dest.value;
+		definition[temporary] = static_cast<int>(i);
+		int user = use[temporary].second;
+		link[temporary] = family(instruction.opcode) != 0 && useCount[temporary] == 1 && use[temporary].first == currentBlock
+			&& user > static_cast<int>(i) && family(instructions[user].opcode) == family(instruction.opcode)
+			&& storesBefore[user] == storesBefore[i + 1];
+	}
+}
+
+bool AlgebraicSimplifier::isLink(const IrOperand& operand) const
+{
+	return operand.kind == IrOperand::Temporary && static_cast<size_t>(operand.value) < link.size()
+		&& link[operand.value];
+}
+
+void AlgebraicSimplifier::collect(const vector<IrInstruction>& instructions, const IrInstruction& operation,
+	bool negative, Chain& chain)
+{
+	chain.operations++;
+	chain.wraps |= operation.wraps;
+	for (const IrOperand* operand : { &operation.left, &operation.right })
+	{
+		bool subtracted = negative != (operand == &operation.right && operation.opcode == IrOpcode::Subtract);
+		if (isLink(*operand))
+		{
+			links.push_back(definition[operand->value]);
+			collect(instructions, instructions[definition[operand->value]], subtracted, chain);
+			continue;
+		}
+
+		IrOperand term = *operand;
+		if (term.kind == IrOperand::Temporary && static_cast<size_t>(term.value) < reducedTo.size()
+			&& reducedTo[term.value].kind != IrOperand::None)
+		{
+			// Only this chain reads the copy, so it goes if the chain is rebuilt
+			copies.push_back(definition[term.value]);
+			term = reducedTo[term.value];
+		}
+		if (term.kind != IrOperand::Constant)
+		{
+			terms.push_back(Term{ term, subtracted });
+		}
+		else if (operation.opcode == IrOpcode::Multiply)
+		{
+			chain.zero |= term.value == 0;
+			chain.modular *= static_cast<unsigned>(term.value);
+			if (!chain.overflowed)
+			{
+				chain.product *= term.value;
+				chain.overflowed = !fits(chain.product);
+			}
+		}
+		else
+		{
+			chain.sum += subtracted ? -static_cast<long long>(term.value) : term.value;
+			chain.modular += subtracted ? 0u - static_cast<unsigned>(term.value) : static_cast<unsigned>(term.value);
+		}
+	}
+}
+
+bool AlgebraicSimplifier::rebuildSum(IrProgram& program, const IrInstruction& root, const Chain& chain)
+{
+	// A term added and subtracted again cancels out; long chains, which
+	// rarely repeat a term, are not searched
+	if (terms.size() <= 64)
+	{
+		for (size_t i = 0; i < terms.size(); i++)
+		{
+			for (size_t j = i + 1; j < terms.size() && terms[i].operand.kind != IrOperand::None; j++)
+			{
+				if (terms[j].operand == terms[i].operand && terms[j].negative != terms[i].negative)
+				{
+					terms[i].operand = IrOperand();
+					terms[j].operand = IrOperand();
+				}
+			}
+		}
+	}
+	size_t count = 0;
+	size_t first = terms.size();	// the first added term
+	for (size_t i = 0; i < terms.size(); i++)
+	{
+		if (terms[i].operand.kind != IrOperand::None)
+		{
+			count++;
+			if (!terms[i].negative && first == terms.size())
+			{
+				first = i;
+			}
+		}
+	}
+
+	bool zero = chain.wraps ? chain.modular == 0 : chain.sum == 0;
+	size_t operations = count == 0 ? 0 : first < terms.size() ? count - 1 + (zero ? 0 : 1) : count;
+	if (operations >= chain.operations)
+	{
+		return false;
+	}
+
+	// One operation gives the exact result; more, or a wrapping chain,
+	// compute modulo 2^32
+	bool wraps = chain.wraps || operations > 1;
+	long long constant = wraps ? static_cast<int>(chain.modular) : chain.sum;
+	steps.clear();
+	IrOperand value;
+	if (first < terms.size())
+	{
+		value = terms[first].operand;
+		for (size_t i = 0; i < terms.size(); i++)
+		{
+			if (i != first && terms[i].operand.kind != IrOperand::None)
+			{
+				steps.push_back(make_pair(terms[i].negative ? IrOpcode::Subtract : IrOpcode::Add, terms[i].operand));
+			}
+		}
+		if (constant > 0 && constant <= INT_MAX)
+		{
+			steps.push_back(make_pair(IrOpcode::Add, IrOperand::constant(static_cast<int>(constant))));
+		}
+		else if (constant < 0 && constant > INT_MIN)
+		{
+			steps.push_back(make_pair(IrOpcode::Subtract, IrOperand::constant(static_cast<int>(-constant))));
+		}
+		else if (constant == INT_MIN || constant == INT_MAX + 1LL)
+		{
+			// x + INT_MIN, and x + 2^31 as x - INT_MIN
+			steps.push_back(make_pair(constant == INT_MIN ? IrOpcode::Add : IrOpcode::Subtract,
+				IrOperand::constant(INT_MIN)));
+		}
+		else if (constant != 0)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Only subtracted terms: c - x - y
+		if (!fits(constant))
+		{
+			return false;
+		}
+		value = IrOperand::constant(static_cast<int>(constant));
+		for (size_t i = 0; i < terms.size(); i++)
+		{
+			if (terms[i].operand.kind != IrOperand::None)
+			{
+				steps.push_back(make_pair(IrOpcode::Subtract, terms[i].operand));
+			}
+		}
+	}
+
+	emit(program, root, value, false, wraps);
+	simplifiedCount++;
+	removedOperationCount += chain.operations - operations;
+	return true;
+}
+
+bool AlgebraicSimplifier::rebuildProduct(IrProgram& program, const IrInstruction& root, const Chain& chain)
+{
+	bool zero = chain.zero || (chain.wraps && chain.modular == 0);
+	if (zero)
+	{
+		terms.clear();
+	}
+	else if (chain.overflowed && !chain.wraps)
+	{
+		return false;		// overflows unless a term is 0; left for the program to run into
+	}
+
+	int constant = zero ? 0 : static_cast<int>(chain.modular);
+	bool negate = !terms.empty() && constant == -1;
+	bool unit = constant == 1 || negate;
+	size_t operations = terms.empty() ? 0 : terms.size() - 1 + (unit && !negate ? 0 : 1);
+	if (operations >= chain.operations)
+	{
+		return false;
+	}
+
+	bool wraps = chain.wraps || operations > 1;
+	steps.clear();
+	IrOperand value = IrOperand::constant(constant);
+	if (!terms.empty())
+	{
+		value = terms[0].operand;
+		for (size_t i = 1; i < terms.size(); i++)
+		{
+			steps.push_back(make_pair(IrOpcode::Multiply, terms[i].operand));
+		}
+		if (!unit)
+		{
+			steps.push_back(make_pair(IrOpcode::Multiply, IrOperand::constant(constant)));
+		}
+	}
+
+	emit(program, root, value, negate, wraps);
+	simplifiedCount++;
+	removedOperationCount += chain.operations - operations;
+	return true;
+}
+
+bool AlgebraicSimplifier::simplifyDivide(const IrInstruction& instruction)
+{
+	if (instruction.right.kind != IrOperand::Constant)
+	{
+		return false;
+	}
+	int divisor = instruction.right.value;
+	IrInstruction simplified(IrOpcode::Copy);
+	simplified.dest = instruction.dest;
+	if (instruction.left.kind == IrOperand::Constant && divisor != 0
+		&& !(instruction.left.value == INT_MIN && divisor == -1))
+	{
+		simplified.left = IrOperand::constant(instruction.left.value / divisor);
+	}
+	else if (divisor == 1)
+	{
+		simplified.left = instruction.left;
+	}
+	else if (divisor == -1)
+	{
+		// Both overflow for INT_MIN
+		simplified.opcode = IrOpcode::Subtract;
+		simplified.left = IrOperand::constant(0);
+		simplified.right = instruction.left;
+	}
+	else
+	{
+		return false;
+	}
+
+	added.push_back(simplified);
+	noteCopy(simplified);
+	simplifiedCount++;
+	removedOperationCount += simplified.opcode == IrOpcode::Copy ? 1 : 0;
+	return true;
+}
+
+void AlgebraicSimplifier::emit(IrProgram& program, const IrInstruction& root, IrOperand value, bool negate, bool wraps)
+{
+	size_t count = steps.size() + (negate ? 1 : 0);
+	if (count == 0)
+	{
+		IrInstruction copy(IrOpcode::Copy);
+		copy.dest = root.dest;
+		copy.left = value;
+		added.push_back(copy);
+		noteCopy(copy);
+		return;
+	}
+
+	// Each step on the result of the one before, the last into the
+	// destination of the chain
+	for (size_t k = 0; k < count; k++)
+	{
+		IrInstruction operation(k < steps.size() ? steps[k].first : IrOpcode::Subtract);
+		operation.left = k < steps.size() ? value : IrOperand::constant(0);
+		operation.right = k < steps.size() ? steps[k].second : value;
+		operation.wraps = wraps;
+		operation.dest = k + 1 == count ? root.dest : IrOperand::temporary(program.newTemporary());
+		added.push_back(operation);
+		value = operation.dest;
+	}
+}
+
+void AlgebraicSimplifier::noteCopy(const IrInstruction& copy)
+{
+	// A variable may be stored before the copy is used, so only a constant
+	// or a temporary stands in for it, and only in its own block
+	if (copy.opcode == IrOpcode::Copy && copy.dest.kind == IrOperand::Temporary
+		&& copy.left.kind != IrOperand::Variable && useCount[copy.dest.value] == 1
+		&& use[copy.dest.value].first == currentBlock)
+	{
+		reducedTo[copy.dest.value] = copy.left;
+	}
+}
+
+void AlgebraicSimplifier::normalize(vector<IrInstruction>& instructions)
+{
+	if (instructions.empty() || instructions.back().opcode != IrOpcode::Branch)
+	{
+		return;
+	}
+	IrInstruction& branch = instructions.back();
+	if (branch.left.kind == IrOperand::Constant && branch.right.kind != IrOperand::Constant)
+	{
+		swap(branch.left, branch.right);
+		branch.compare = mirror(branch.compare);
+		normalizedCount++;
+	}
+
+	for (;;)
+	{
+		IrOperand left = instructions.back().left;
+		IrOperand right = instructions.back().right;
+		IrCompare compare = instructions.back().compare;
+		if (right.kind != IrOperand::Constant || left.kind != IrOperand::Temporary
+			|| static_cast<size_t>(left.value) >= useCount.size() || useCount[left.value] != 1)
+		{
+			return;
+		}
+
+		// The + or - that computes the left side, with no variable stored
+		// between it and the branch
+		size_t index = instructions.size() - 1;
+		bool found = false;
+		while (!found && index > 0)
+		{
+			const IrInstruction& instruction = instructions[--index];
+			if (!instruction.definesValue())
+			{
+				continue;
+			}
+			if (instruction.dest == left)
+			{
+				found = true;
+			}
+			else if (instruction.dest.kind == IrOperand::Variable)
+			{
+				return;
+			}
+		}
+		if (!found)
+		{
+			return;
+		}
+		const IrInstruction& operation = instructions[index];
+		if (operation.wraps || family(operation.opcode) != 1
+			|| (operation.left.kind == IrOperand::Constant && operation.right.kind == IrOperand::Constant))
+		{
+			return;
+		}
+
+		long long bound = right.value;
+		if (operation.right.kind == IrOperand::Constant)
+		{
+			// x + c < k is x < k - c, and x - c < k is x < k + c
+			left = operation.left;
+			bound += operation.opcode == IrOpcode::Add ? -static_cast<long long>(operation.right.value)
+				: operation.right.value;
+		}
+		else if (operation.left.kind == IrOperand::Constant)
+		{
+			// c + x < k is x < k - c, and c - x < k is x > c - k
+			left = operation.right;
+			if (operation.opcode == IrOpcode::Add)
+			{
+				bound -= operation.left.value;
+			}
+			else
+			{
+				bound = operation.left.value - bound;
+				compare = mirror(compare);
+			}
+		}
+		else if (operation.opcode == IrOpcode::Subtract && right.value == 0)
+		{
+			// x - y < 0 is x < y
+			left = operation.left;
+			right = operation.right;
+		}
+		else
+		{
+			return;
+		}
+		if (right.kind == IrOperand::Constant)
+		{
+			if (!fits(bound))
+			{
+				return;
+			}
+			right = IrOperand::constant(static_cast<int>(bound));
+		}
+
+		instructions.erase(instructions.begin() + index);
+		instructions.back().left = left;
+		instructions.back().right = right;
+		instructions.back().compare = compare;
+		normalizedCount++;
+		removedOperationCount++;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "IR.h"
+
+/**
+ * AlgebraicSimplifier (Optimization pass on the IR)
+ *
+ * Purpose: Rewrites arithmetic into fewer operations that compute the
+ * same value. x + 0, x * 1 and x / 1 become x, x - x and x * 0 become 0,
+ * and the constants of a chain are grouped, so that
+ *     y = 2 * (x * 3) + 1 - 4;
+ * becomes y = x * 6 - 3.
+ *
+ * How it works:
+ * 1. A chain of + and - (or of *) is read as the list of its terms: the
+ *    operands of its last operation, and of each operation whose
+ *    temporary only it uses, in the same block with no variable stored
+ *    in between
+ * 2. The constant terms are combined into one, a term that is both added
+ *    and subtracted cancels out, and a product with a zero term is zero.
+ *    A term that an earlier rewrite reduced to a constant or temporary,
+ *    as x * 0 in x * 0 + y, is read as that
+ * 3. If that leaves fewer operations, the chain is rebuilt from the
+ *    remaining terms in their order, with the constant last: x + y - z + 3
+ * 4. x / -1 becomes 0 - x, and a division of two constants its quotient
+ * 5. A branch compares against a constant on the right: 5 > x becomes
+ *    x < 5. Then x + c < k becomes x < k - c, c - x < k becomes x > c - k
+ *    and x - y < 0 becomes x < y, where only the branch uses the result
+ *    of the + or -
+ *
+ * Only wrapping operations (IrInstruction::wraps) may overflow. A chain
+ * rebuilt into a single operation computes its exact result, which fits
+ * wherever the original did. A longer one may overflow in between where
+ * the original did not, as x + y in (x + 1) + (y - 2), so its operations
+ * wrap; modulo 2^32 the result is the same. A chain that contains a
+ * wrapping operation is computed modulo 2^32 as a whole, and step 5 only
+ * applies to operations that do not wrap, with a constant that fits.
+ * (A negated comparison, as in the goto form of a loop, is already
+ * written as its opposite: !(a < b) as a >= b.)
+ */
+class AlgebraicSimplifier
+{
+	struct Term
+	{
+		IrOperand operand;
+		bool negative;		// subtracted, in a chain of + and -
+	};
+
+	struct Chain
+	{
+		size_t operations;
+		bool wraps;				// contains a wrapping operation
+		long long sum;			// of the constant terms of + and -
+		long long product;		// of the constant terms of *, while it fits in an int
+		unsigned modular;		// the sum or product modulo 2^32
+		bool overflowed;		// the product does not fit in an int
+		bool zero;				// a constant term of * is 0
+	};
+
+	int currentBlock;				// being simplified
+	std::vector<int> useCount;		// by temporary
+	std::vector<std::pair<int, int>> use;	// by temporary: block and index of its last use
+	std::vector<int> definition;	// by temporary: index in its block
+	std::vector<char> link;			// by temporary: part of the chain of its only user
+	std::vector<IrOperand> reducedTo;	// by temporary: the constant or temporary a rewrite made it a copy of
+	std::vector<int> storesBefore;	// by index: variable stores earlier in the block
+	std::vector<std::pair<int, int>> replacement;	// by index: range of added, or -1 if kept
+	std::vector<char> dropped;		// by index: a link of a rebuilt chain
+	std::vector<int> links;			// indices of the links of the chain being read
+	std::vector<int> copies;		// indices of the reduced copies it reads
+	std::vector<Term> terms;
+	std::vector<std::pair<IrOpcode, IrOperand>> steps;	// of a rebuilt chain, after its first term
+	std::vector<IrInstruction> added;
+	std::vector<IrInstruction> rewritten;
+
+	void countUses(const IrProgram& program);
+	void findLinks(const std::vector<IrInstruction>& instructions);
+	bool isLink(const IrOperand& operand) const;
+	void collect(const std::vector<IrInstruction>& instructions, const IrInstruction& operation, bool negative,
+		Chain& chain);
+	bool rebuildSum(IrProgram& program, const IrInstruction& root, const Chain& chain);
+	bool rebuildProduct(IrProgram& program, const IrInstruction& root, const Chain& chain);
+	bool simplifyDivide(const IrInstruction& instruction);
+	void emit(IrProgram& program, const IrInstruction& root, IrOperand value, bool negate, bool wraps);
+	void noteCopy(const IrInstruction& copy);
+	void normalize(std::vector<IrInstruction>& instructions);
+
+public:
+	// Statistics since the last reset()
+	size_t simplifiedCount;		// chains and divisions rewritten
+	size_t removedOperationCount;	// operations left out by the rewrites
+	size_t normalizedCount;		// branch comparisons rewritten
+
+	AlgebraicSimplifier();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Simplifies a whole program or one fragment in place.
+	 */
+	void run(IrProgram& program);
+};
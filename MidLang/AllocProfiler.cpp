@@ -0,0 +1,292 @@
+#include "AllocProfiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	const size_t phaseCount = static_cast<size_t>(AllocPhase::Count);
+	const size_t categoryCount = static_cast<size_t>(AllocCategory::Count);
+	const size_t topSiteCount = 5;
+
+	struct AtomicCounter
+	{
+		atomic<size_t> allocations;
+		atomic<size_t> bytes;
+	};
+
+	AtomicCounter counters[phaseCount][categoryCount];
+
+	thread_local AllocPhase currentPhase = AllocPhase::Other;
+	thread_local AllocCategory currentCategory = AllocCategory::Other;
+	thread_local size_t threadCount = 0;
+
+	double perToken(size_t allocations, size_t tokenCount)
+	{
+		return tokenCount == 0 ? 0.0 : static_cast<double>(allocations) / tokenCount;
+	}
+
+	void writeCounter(ostream& out, const AllocProfiler::Counter& counter, size_t tokenCount)
+	{
+		out << counter.allocations << " allocations, " << counter.bytes << " bytes";
+		if (tokenCount > 0)
+		{
+			out << " (" << perToken(counter.allocations, tokenCount) << " per token)";
+		}
+		out << endl;
+	}
+}
+
+bool AllocProfiler::enabled()
+{
+#ifdef MIDLANG_ALLOC_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AllocProfiler::reset()
+{
+	for (auto& row : counters)
+	{
+		for (auto& counter : row)
+		{
+			counter.allocations.store(0, memory_order_relaxed);
+			counter.bytes.store(0, memory_order_relaxed);
+		}
+	}
+}
+
+AllocProfiler::Counter AllocProfiler::total()
+{
+	Counter sum = { 0, 0 };
+	for (size_t p = 0; p < phaseCount; p++)
+	{
+		Counter counter = phase(static_cast<AllocPhase>(p));
+		sum.allocations += counter.allocations;
+		sum.bytes += counter.bytes;
+	}
+	return sum;
+}
+
+AllocProfiler::Counter AllocProfiler::phase(AllocPhase phase)
+{
+	Counter sum = { 0, 0 };
+	for (size_t c = 0; c < categoryCount; c++)
+	{
+		Counter counter = site(phase, static_cast<AllocCategory>(c));
+		sum.allocations += counter.allocations;
+		sum.bytes += counter.bytes;
+	}
+	return sum;
+}
+
+AllocProfiler::Counter AllocProfiler::compiler()
+{
+	Counter sum = total();
+	Counter other = phase(AllocPhase::Other);
+	sum.allocations -= other.allocations;
+	sum.bytes -= other.bytes;
+	return sum;
+}
+
+double AllocProfiler::allocationsPerToken(size_t tokenCount)
+{
+	return perToken(compiler().allocations, tokenCount);
+}
+
+AllocProfiler::Counter AllocProfiler::site(AllocPhase phase, AllocCategory category)
+{
+	const AtomicCounter& counter = counters[static_cast<size_t>(phase)][static_cast<size_t>(category)];
+	return { counter.allocations.load(memory_order_relaxed), counter.bytes.load(memory_order_relaxed) };
+}
+
+size_t AllocProfiler::threadAllocations()
+{
+	return threadCount;
+}
+
+void AllocProfiler::report(ostream& out, size_t tokenCount)
+{
+	// Take a snapshot first, since writing the report allocates too
+	Counter snapshot[phaseCount][categoryCount];
+	Counter phases[phaseCount];
+	Counter sum = { 0, 0 };
+	vector<pair<size_t, size_t>> sites;
+	sites.reserve(phaseCount * categoryCount);
+	for (size_t p = 0; p < phaseCount; p++)
+	{
+		phases[p] = { 0, 0 };
+		for (size_t c = 0; c < categoryCount; c++)
+		{
+			snapshot[p][c] = site(static_cast<AllocPhase>(p), static_cast<AllocCategory>(c));
+			phases[p].allocations += snapshot[p][c].allocations;
+			phases[p].bytes += snapshot[p][c].bytes;
+			if (snapshot[p][c].allocations > 0)
+			{
+				sites.emplace_back(p, c);
+			}
+		}
+		sum.allocations += phases[p].allocations;
+		sum.bytes += phases[p].bytes;
+	}
+
+	// Without a per-token figure, which is only given for the compiler
+	out << "Allocations: ";
+	writeCounter(out, sum, 0);
+
+	// Totals per phase
+	for (size_t p = 0; p < phaseCount; p++)
+	{
+		out << "  " << name(static_cast<AllocPhase>(p)) << ": ";
+		writeCounter(out, phases[p], tokenCount);
+	}
+
+	// The same figure as allocationsPerToken()
+	const Counter& other = phases[static_cast<size_t>(AllocPhase::Other)];
+	Counter compiled = { sum.allocations - other.allocations, sum.bytes - other.bytes };
+	out << "Compiler (all but other): ";
+	writeCounter(out, compiled, tokenCount);
+
+	// Busiest phase/category sites
+	sort(sites.begin(), sites.end(), [&](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b)
+	{
+		return snapshot[a.first][a.second].allocations > snapshot[b.first][b.second].allocations;
+	});
+
+	out << "Top allocation sites:" << endl;
+	for (size_t i = 0; i < sites.size() && i < topSiteCount; i++)
+	{
+		out << "  " << i + 1 << ". " << name(static_cast<AllocPhase>(sites[i].first)) << " / "
+			<< name(static_cast<AllocCategory>(sites[i].second)) << ": ";
+		writeCounter(out, snapshot[sites[i].first][sites[i].second], tokenCount);
+	}
+}
+
+const char* AllocProfiler::name(AllocPhase phase)
+{
+	switch (phase)
+	{
+		case AllocPhase::Lex: return "lex";
+		case AllocPhase::Parse: return "parse";
+		case AllocPhase::Analyze: return "analyze";
+		case AllocPhase::Lower: return "lower";
+		case AllocPhase::Optimize: return "optimize";
+		case AllocPhase::Codegen: return "codegen";
+		default: return "other";
+	}
+}
+
+const char* AllocProfiler::name(AllocCategory category)
+{
+	switch (category)
+	{
+		case AllocCategory::TokenStrings: return "token strings";
+		case AllocCategory::AstNodes: return "AST nodes";
+		case AllocCategory::Vectors: return "vectors";
+		case AllocCategory::CodegenTemporaries: return "codegen temporaries";
+		default: return "other";
+	}
+}
+
+void AllocProfiler::record(size_t bytes)
+{
+	AtomicCounter& counter = counters[static_cast<size_t>(currentPhase)][static_cast<size_t>(currentCategory)];
+	counter.allocations.fetch_add(1, memory_order_relaxed);
+	counter.bytes.fetch_add(bytes, memory_order_relaxed);
+	threadCount++;
+}
+
+AllocPhaseScope::AllocPhaseScope(AllocPhase phase)
+	: saved(currentPhase)
+{
+	currentPhase = phase;
+}
+
+AllocPhaseScope::~AllocPhaseScope()
+{
+	currentPhase = saved;
+}
+
+AllocCategoryScope::AllocCategoryScope(AllocCategory category)
+	: saved(currentCategory)
+{
+	currentCategory = category;
+}
+
+AllocCategoryScope::~AllocCategoryScope()
+{
+	currentCategory = saved;
+}
+
+#ifdef MIDLANG_ALLOC_PROFILE
+
+// Counting replacements for the global allocation functions
+
+void* operator new(size_t size)
+{
+	void* block = malloc(size == 0 ? 1 : size);
+	if (block == nullptr)
+	{
+		throw bad_alloc();
+	}
+	AllocProfiler::record(size);
+	return block;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	void* block = malloc(size == 0 ? 1 : size);
+	if (block != nullptr)
+	{
+		AllocProfiler::record(size);
+	}
+	return block;
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* block) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+	free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept
+{
+	free(block);
+}
+
+void operator delete(void* block, const nothrow_t&) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void* block, const nothrow_t&) noexcept
+{
+	free(block);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+/**
+ * Compiler phase an allocation happened in.
+ */
+enum class AllocPhase
+{
+	Other,
+	Lex,
+	Parse,
+	Analyze,	// Resolver and the passes on the syntax tree
+	Lower,		// IrBuilder
+	Optimize,	// passes on the IR
+	Codegen,
+	Count
+};
+
+/**
+ * Kind of call site an allocation came from.
+ */
+enum class AllocCategory
+{
+	Other,
+	TokenStrings,		// token text built by the lexer and token copies
+	AstNodes,			// AST nodes and the names they hold
+	Vectors,			// token and statement vectors growing
+	CodegenTemporaries,	// strings built while generating code
+	Count
+};
+
+/**
+ * AllocProfiler (Allocation profiling)
+ * 
+ * Purpose: Counts heap allocations per compiler phase and call-site
+ * category, to track allocation regressions in the hot paths.
+ * 
+ * How it works:
+ * 1. Building with -DMIDLANG_ALLOC_PROFILE=ON replaces the global
+ *    operator new/delete with counting versions
+ * 2. The MIDLANG_ALLOC_PHASE/MIDLANG_ALLOC_CATEGORY scopes in the Lexer,
+ *    Parser, passes and code generators tag the current thread's
+ *    allocations. PassManager also counts them per pass
+ * 3. report() prints the totals and the busiest phase/category sites
+ * 
+ * In normal builds the scopes compile to nothing and enabled() is false.
+ */
+class AllocProfiler
+{
+public:
+	struct Counter
+	{
+		size_t allocations;
+		size_t bytes;
+	};
+
+	/**
+	 * True if this build counts allocations.
+	 */
+	static bool enabled();
+
+	static void reset();
+	static Counter total();
+	static Counter phase(AllocPhase phase);
+
+	/**
+	 * Allocations in every phase but Other, which holds the caller's own
+	 * and the debug checks': what the compiler itself allocated.
+	 */
+	static Counter compiler();
+	static Counter site(AllocPhase phase, AllocCategory category);
+
+	/**
+	 * Allocations made by the calling thread since it started, in any
+	 * phase; the difference over a call counts what the call allocated.
+	 */
+	static size_t threadAllocations();
+
+	/**
+	 * compiler() allocations per token, the figure --alloc-budget checks
+	 * and report() prints. Returns 0 if tokenCount is 0.
+	 */
+	static double allocationsPerToken(size_t tokenCount);
+
+	/**
+	 * Writes the total, the totals per phase, the compiler() total and
+	 * the top allocation sites. Per-token figures are included when
+	 * tokenCount is non-zero.
+	 */
+	static void report(std::ostream& out, size_t tokenCount = 0);
+
+	static const char* name(AllocPhase phase);
+	static const char* name(AllocCategory category);
+
+	// Called by the counting operator new
+	static void record(size_t bytes);
+};
+
+/**
+ * Tags allocations on this thread with a phase until the end of scope.
+ */
+class AllocPhaseScope
+{
+	AllocPhase saved;
+
+public:
+	AllocPhaseScope(AllocPhase phase);
+	~AllocPhaseScope();
+};
+
+/**
+ * Tags allocations on this thread with a category until the end of scope.
+ */
+class AllocCategoryScope
+{
+	AllocCategory saved;
+
+public:
+	AllocCategoryScope(AllocCategory category);
+	~AllocCategoryScope();
+};
+
+#ifdef MIDLANG_ALLOC_PROFILE
+#define MIDLANG_ALLOC_PHASE(phase) AllocPhaseScope allocPhaseScope(phase)
+#define MIDLANG_ALLOC_CATEGORY(category) AllocCategoryScope allocCategoryScope(category)
+#else
+#define MIDLANG_ALLOC_PHASE(phase) ((void)0)
+#define MIDLANG_ALLOC_CATEGORY(category) ((void)0)
+#endif
@@ -0,0 +1,165 @@
+#include "AssemblyCodeGenerator.h"
+#include "AllocProfiler.h"
+#include <iostream>
+
+using namespace std;
+
+AssemblyCodeGenerator::AssemblyCodeGenerator(ostream& out)
+	: output(out), indentLevel(0)
+{
+}
+
+void AssemblyCodeGenerator::generate(const IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writer.analyze(program);
+
+	writeHeader(CppWriter::needsCstdint(program));
+	writeLine("int main() {");
+	indentLevel++;
+
+	// Declare all variables at the start (assembly-style), including
+	// those of nested blocks and the temporaries that are stored
+	writeLine("// Variable declarations");
+	code.clear();
+	for (int slot = 0; slot < static_cast<int>(program.variableNames.size()); slot++)
+	{
+		code += "    ";
+		code += writer.typeName(IrOperand::variable(slot));
+		code += ' ';
+		writer.appendName(code, IrOperand::variable(slot));
+		code += ";\n";
+	}
+	for (int temporary = 0; temporary < program.temporaryCount; temporary++)
+	{
+		if (writer.isStored(temporary))
+		{
+			code += "    int ";
+			writer.appendName(code, IrOperand::temporary(temporary));
+			code += ";\n";
+		}
+	}
+	code += '\n';
+
+	writer.writeBlocks(program, code, "    ");
+	output << code;
+
+	indentLevel--;
+	writeLine("}");
+}
+
+void AssemblyCodeGenerator::begin()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writeHeader(false);
+	writeLine("struct Program {");
+	indentLevel++;
+	writeLine("void run() {");
+	indentLevel++;
+}
+
+void AssemblyCodeGenerator::generateFragment(const IrProgram& fragment)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writer.analyze(fragment);
+	for (const IrBlock& block : fragment.blocks)
+	{
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			if (!writer.isInlined(instruction))
+			{
+				writer.forEachName(instruction, [this](const IrOperand& operand) { declare(operand); });
+			}
+		}
+	}
+
+	code.clear();
+	writer.writeBlocks(fragment, code, "        ");
+	output << code << endl;
+}
+
+void AssemblyCodeGenerator::end()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writeLine("return;");
+	indentLevel--;
+	writeLine("}");
+	writeLine("");
+
+	// Variable declarations collected while streaming
+	writeLine("// Variable declarations");
+	output << declarations;
+
+	indentLevel--;
+	writeLine("};");
+	writeLine("");
+	writeLine("int main() {");
+	indentLevel++;
+	writeLine("Program program{};");
+	writeLine("program.run();");
+	writeLine("return 0;");
+	indentLevel--;
+	writeLine("}");
+}
+
+void AssemblyCodeGenerator::reset()
+{
+	indentLevel = 0;
+	writer.reset();
+	declarations.clear();
+	declaredSlots.clear();
+	declaredTemporaries.clear();
+}
+
+void AssemblyCodeGenerator::declare(const IrOperand& operand)
+{
+	// Temporaries are numbered from zero in every fragment, so one
+	// member serves all temporaries with the same number
+	vector<char>& declared = operand.kind == IrOperand::Variable ? declaredSlots : declaredTemporaries;
+	if (static_cast<size_t>(operand.value) >= declared.size())
+	{
+		declared.resize(operand.value + 1, 0);
+	}
+	if (!declared[operand.value])
+	{
+		declared[operand.value] = 1;
+		declarations += "    int ";
+		writer.appendName(declarations, operand);
+		declarations += ";\n";
+	}
+}
+
+void AssemblyCodeGenerator::writeHeader(bool cstdint)
+{
+	// Write C++ header
+	if (cstdint)
+	{
+		writeLine("#include <cstdint>");
+	}
+	writeLine("#include <iostream>");
+	writeLine("#include <string>");
+	writeLine("using namespace std;");
+	writeLine("");
+}
+
+void AssemblyCodeGenerator::writeIndent()
+{
+	for (int i = 0; i < indentLevel; i++)
+	{
+		output << "    ";
+	}
+}
+
+void AssemblyCodeGenerator::writeLine(const char* line)
+{
+	writeIndent();
+	output << line << endl;
+}
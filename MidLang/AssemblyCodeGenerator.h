@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include "Backend.h"
+#include "CppWriter.h"
+
+/**
+ * AssemblyCodeGenerator (Assembly-style Transpiler)
+ * 
+ * Purpose: Generates C++ code with goto statements and labels,
+ * treating C++ as an assembly language replacement.
+ * 
+ * How it works:
+ * 1. Walks the basic blocks of the IR in order
+ * 2. Writes each block as a label followed by its instructions
+ * 3. Turns jumps and branches into gotos (no structured if/while)
+ */
+class AssemblyCodeGenerator : public Backend
+{
+	std::ostream& output;
+	int indentLevel;
+	CppWriter writer;
+	std::string code;
+
+	// Streaming mode: declarations are collected while emitting and
+	// written in a section after the code
+	std::string declarations;
+	std::vector<char> declaredSlots;
+	std::vector<char> declaredTemporaries;
+
+	// Helper methods
+	void writeHeader(bool cstdint);	// with <cstdint> for narrow variables
+	void writeIndent();
+	void writeLine(const char* line);
+	void declare(const IrOperand& operand);
+
+public:
+	AssemblyCodeGenerator(std::ostream& out);
+
+	/**
+	 * Generates assembly-style C++ code from a program.
+	 * Uses goto statements and labels instead of structured control flow.
+	 */
+	void generate(const IrProgram& program) override;
+
+	/**
+	 * Streaming interface: begin() writes the prologue, generateFragment()
+	 * emits one top-level statement and end() writes the epilogue.
+	 * Since variables are only known once every statement has been seen,
+	 * the code is emitted as the body of Program::run() and the variable
+	 * declarations follow as members of Program, after the code.
+	 */
+	void begin() override;
+	void generateFragment(const IrProgram& fragment) override;
+	void end() override;
+	void reset() override;
+};
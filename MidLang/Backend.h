@@ -0,0 +1,36 @@
+#pragma once
+
+#include "IR.h"
+
+/**
+ * Backend - Interface shared by the code generators.
+ * 
+ * Lets the compiler, the pipeline and the drivers produce either output
+ * style without knowing which generator they are talking to. Both emit
+ * from the three-address code built by IrBuilder.
+ */
+class Backend
+{
+public:
+	virtual ~Backend() = default;
+
+	/**
+	 * Generates code for a complete program.
+	 */
+	virtual void generate(const IrProgram& program) = 0;
+
+	/**
+	 * Streaming interface: begin() writes the prologue, generateFragment()
+	 * emits one top-level statement (see IrBuilder::lowerFragment) and
+	 * end() writes the epilogue.
+	 */
+	virtual void begin() = 0;
+	virtual void generateFragment(const IrProgram& fragment) = 0;
+	virtual void end() = 0;
+
+	/**
+	 * Clears all per-program state (keeping allocated capacity) so the
+	 * generator can be reused for another program.
+	 */
+	virtual void reset() = 0;
+};
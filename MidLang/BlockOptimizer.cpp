@@ -0,0 +1,251 @@
+#include "BlockOptimizer.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+
+using namespace std;
+
+BlockOptimizer::BlockOptimizer()
+	: threadedJumpCount(0), returnedJumpCount(0), rotatedLoopCount(0), mergedBlockCount(0), removedBlockCount(0)
+{
+}
+
+void BlockOptimizer::reset()
+{
+	threadedJumpCount = 0;
+	returnedJumpCount = 0;
+	rotatedLoopCount = 0;
+	mergedBlockCount = 0;
+	removedBlockCount = 0;
+}
+
+void BlockOptimizer::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	threadJumps(program);
+	graph.build(program);
+	if (rotateLoops(program))
+	{
+		graph.build(program);
+	}
+
+	int count = static_cast<int>(program.blocks.size());
+	int tail = program.fragment ? count - 1 : -1;	// the open block, which must stay last
+	removed.assign(count, 0);
+	for (int block = 0; block < count; block++)
+	{
+		if (!graph.isReachable(block) && block != tail)
+		{
+			removed[block] = 1;
+			removedBlockCount++;
+		}
+	}
+
+	tail = mergeBlocks(program, tail);
+	layOut(program, tail);
+	program.reorderBlocks(order);
+}
+
+int BlockOptimizer::finalTarget(const IrProgram& program, int block) const
+{
+	// Bounded, since jump-only blocks may form a cycle
+	for (size_t steps = 0; steps < program.blocks.size(); steps++)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		if (instructions.size() != 1 || instructions[0].opcode != IrOpcode::Jump)
+		{
+			break;
+		}
+		block = instructions[0].target;
+	}
+	return block;
+}
+
+void BlockOptimizer::threadJumps(IrProgram& program)
+{
+	for (IrBlock& block : program.blocks)
+	{
+		if (!block.isTerminated())
+		{
+			continue;
+		}
+
+		IrInstruction& last = block.instructions.back();
+		if (last.opcode != IrOpcode::Jump && last.opcode != IrOpcode::Branch)
+		{
+			continue;
+		}
+		for (int* target : { &last.target, &last.falseTarget })
+		{
+			if (*target < 0)
+			{
+				continue;
+			}
+			int final = finalTarget(program, *target);
+			if (final != *target)
+			{
+				*target = final;
+				threadedJumpCount++;
+			}
+		}
+
+		if (last.opcode == IrOpcode::Branch && last.target == last.falseTarget)
+		{
+			IrInstruction jump(IrOpcode::Jump);
+			jump.target = last.target;
+			last = jump;
+		}
+
+		// A jump to the end of the program returns right away
+		const vector<IrInstruction>& destination = program.blocks[last.target].instructions;
+		if (last.opcode == IrOpcode::Jump && destination.size() == 1 && destination[0].opcode == IrOpcode::Return)
+		{
+			last = destination[0];
+			returnedJumpCount++;
+		}
+	}
+}
+
+bool BlockOptimizer::rotateLoops(IrProgram& program)
+{
+	// The header keeps its own test, which now only runs on entry
+	bool changed = false;
+	for (int block : graph.order)
+	{
+		IrBlock& latch = program.blocks[block];
+		if (!latch.isTerminated() || latch.terminator().opcode != IrOpcode::Jump)
+		{
+			continue;
+		}
+		int header = latch.terminator().target;
+		const vector<IrInstruction>& test = program.blocks[header].instructions;
+		if (test.size() == 1 && test[0].opcode == IrOpcode::Branch && graph.isBackEdge(block, header))
+		{
+			latch.instructions.back() = test[0];
+			rotatedLoopCount++;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+int BlockOptimizer::mergeBlocks(IrProgram& program, int tail)
+{
+	for (int block : graph.order)
+	{
+		if (removed[block])
+		{
+			continue;
+		}
+
+		vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		while (!instructions.empty() && instructions.back().opcode == IrOpcode::Jump)
+		{
+			// Predecessor counts stay right as blocks merge: the block
+			// that takes over the jumps had the only edge into the other
+			int next = instructions.back().target;
+			if (next == block || next == 0 || removed[next] || graph.predecessors[next].size() != 1)
+			{
+				break;
+			}
+
+			vector<IrInstruction>& merged = program.blocks[next].instructions;
+			instructions.pop_back();
+			instructions.insert(instructions.end(), merged.begin(), merged.end());
+			merged.clear();
+			removed[next] = 1;
+			mergedBlockCount++;
+			if (next == tail)
+			{
+				tail = block;
+			}
+		}
+	}
+	return tail;
+}
+
+void BlockOptimizer::layOut(IrProgram& program, int tail)
+{
+	int count = static_cast<int>(program.blocks.size());
+	placed.assign(removed.begin(), removed.end());
+	if (tail >= 0)
+	{
+		placed[tail] = 1;	// kept for the end
+	}
+
+	// Each chain starts with the first block (in source order) that is
+	// ready, so code stays in source order where no edge says otherwise
+	order.clear();
+	int first = 0;		// every block before it is placed
+	int block = 0;
+	while (block >= 0)
+	{
+		int start = block;
+		while (block >= 0 && !placed[block] && (block == start || isReady(block)))
+		{
+			placed[block] = 1;
+			order.push_back(block);
+			block = preferredSuccessor(program.blocks[block]);
+		}
+
+		while (first < count && placed[first])
+		{
+			first++;
+		}
+		block = -1;
+		for (int candidate = first; candidate < count && block < 0; candidate++)
+		{
+			if (!placed[candidate] && isReady(candidate))
+			{
+				block = candidate;
+			}
+		}
+		if (block < 0 && first < count)
+		{
+			block = first;	// only in control flow that is not reducible
+		}
+	}
+
+	if (tail >= 0)
+	{
+		order.push_back(tail);
+	}
+}
+
+bool BlockOptimizer::isReady(int block) const
+{
+	// A block where control flow meets again waits until every block
+	// that reaches it from earlier in the source is placed, so if/else
+	// comes out as then-arm, else-arm, rest
+	for (int predecessor : graph.predecessors[block])
+	{
+		if (!placed[predecessor] && !graph.isBackEdge(predecessor, block))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int BlockOptimizer::preferredSuccessor(const IrBlock& block) const
+{
+	if (!block.isTerminated())
+	{
+		return -1;
+	}
+
+	const IrInstruction& last = block.terminator();
+	if (last.opcode == IrOpcode::Jump)
+	{
+		return last.target;
+	}
+	if (last.opcode == IrOpcode::Branch)
+	{
+		// The then-arm or loop body comes first in the source
+		int first = min(last.target, last.falseTarget);
+		int second = max(last.target, last.falseTarget);
+		return placed[first] ? second : first;
+	}
+	return -1;
+}
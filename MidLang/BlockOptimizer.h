@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * BlockOptimizer (Optimization pass on the IR)
+ *
+ * Purpose: Cleans up the control flow of the IR before it is written with
+ * labels and gotos, so only the jumps that are really needed remain.
+ *
+ * How it works:
+ * 1. Jump threading: an edge to a block that does nothing but jump on is
+ *    sent to the final target instead; a branch whose two targets end up
+ *    the same becomes a jump, and a jump to a block that only returns
+ *    becomes that return
+ * 2. Loop rotation: a jump back to a loop header that only tests the
+ *    condition becomes a copy of that test, so the loop ends in one
+ *    conditional backward jump and the header is left as the guard in
+ *    front of it, as in
+ *        if (x < 5) { do { ... } while (x < 5); }
+ * 3. Blocks that can no longer be reached are dropped
+ * 4. Block merging: a block that ends in a jump to a block with no other
+ *    predecessor takes over that block's instructions
+ * 5. Layout: blocks are placed in chains, each followed by the target of
+ *    its jump, or by the first target of its branch, if that is not
+ *    placed yet, so as many edges as possible become fall-throughs. A
+ *    block where two paths meet waits for the blocks before it, and a
+ *    new chain starts at the first block (in source order) left over
+ *
+ * The entry stays first, and the open block of a fragment stays last.
+ */
+class BlockOptimizer
+{
+	ControlFlowGraph graph;
+	std::vector<char> removed;		// by block: unreachable or merged into another
+	std::vector<char> placed;
+	std::vector<int> order;
+
+	int finalTarget(const IrProgram& program, int block) const;
+	void threadJumps(IrProgram& program);
+	bool rotateLoops(IrProgram& program);
+	int mergeBlocks(IrProgram& program, int tail);
+	void layOut(IrProgram& program, int tail);
+	bool isReady(int block) const;
+	int preferredSuccessor(const IrBlock& block) const;
+
+public:
+	// Statistics since the last reset()
+	size_t threadedJumpCount;		// edges sent past a jump-only block
+	size_t returnedJumpCount;		// jumps to a return, replaced by it
+	size_t rotatedLoopCount;		// back edges that test the condition themselves
+	size_t mergedBlockCount;
+	size_t removedBlockCount;		// unreachable blocks
+
+	BlockOptimizer();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Optimizes a whole program or one fragment in place.
+	 */
+	void run(IrProgram& program);
+};
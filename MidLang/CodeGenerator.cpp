@@ -0,0 +1,514 @@
+#include "CodeGenerator.h"
+#include "AllocProfiler.h"
+#include <iostream>
+
+using namespace std;
+
+CodeGenerator::CodeGenerator(ostream& out)
+	: output(out), indentLevel(0), program(nullptr)
+{
+}
+
+void CodeGenerator::generate(const IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writeHeader(CppWriter::needsCstdint(program));
+	generateCode(program, -1);
+	end();
+}
+
+void CodeGenerator::begin()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	writeHeader(false);
+}
+
+void CodeGenerator::writeHeader(bool cstdint)
+{
+	// Write C++ header
+	if (cstdint)
+	{
+		writeLine("#include <cstdint>");
+	}
+	writeLine("#include <iostream>");
+	writeLine("#include <string>");
+	writeLine("using namespace std;");
+	writeLine("");
+	writeLine("int main() {");
+	indentLevel++;
+}
+
+void CodeGenerator::generateFragment(const IrProgram& fragment)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	// Every path through the statement ends in the open last block
+	generateCode(fragment, static_cast<int>(fragment.blocks.size()) - 1);
+}
+
+void CodeGenerator::end()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Codegen);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::CodegenTemporaries);
+
+	indentLevel--;
+	writeLine("    return 0;");
+	writeLine("}");
+}
+
+void CodeGenerator::reset()
+{
+	indentLevel = 0;
+	writer.reset();
+	declaredSlots.clear();
+	declaredTemporaries.clear();
+}
+
+void CodeGenerator::generateCode(const IrProgram& code, int stop)
+{
+	program = &code;
+	writer.analyze(code);
+	body.clear();
+	statement.clear();
+	declarations.clear();
+	declaredNow.clear();
+
+	try
+	{
+		// Most statements are a single open block, with no control flow
+		if (stop != 0)
+		{
+			analyzeStructure();
+			generateRegion(0, stop);
+		}
+		if (stop >= 0)
+		{
+			generateInstructions(stop);
+		}
+		finishStatement();
+	}
+	catch (const Unstructured&)
+	{
+		for (const IrOperand& operand : declaredNow)
+		{
+			declared(operand) = 0;
+		}
+		body.clear();
+		statement.clear();
+		declarations.clear();
+		loops.clear();
+		indentLevel = 1;
+		generateGotos(code);
+	}
+
+	output << body;
+	program = nullptr;
+}
+
+void CodeGenerator::analyzeStructure()
+{
+	int count = static_cast<int>(program->blocks.size());
+	graph.build(*program);
+	const vector<vector<int>>& successors = graph.successors;
+	const vector<vector<int>>& predecessors = graph.predecessors;
+	const vector<int>& number = graph.orderNumber;
+
+	loopExit.assign(count, -2);
+	emitted.assign(count, 0);
+	loops.clear();
+
+	loopOf.assign(count, -1);	// header of the loop being collected
+	for (int header = 0; header < count; header++)
+	{
+		if (number[header] < 0)
+		{
+			continue;
+		}
+
+		members.clear();
+		for (int latch : predecessors[header])
+		{
+			if (number[latch] < number[header])
+			{
+				continue;
+			}
+
+			// A loop must be entered through its header
+			if (!graph.dominates(header, latch))
+			{
+				throw Unstructured();
+			}
+			if (loopOf[latch] != header)
+			{
+				loopOf[latch] = header;
+				members.push_back(latch);
+			}
+		}
+		if (members.empty())
+		{
+			continue;
+		}
+
+		// The loop is everything that reaches a latch without the header
+		loopOf[header] = header;
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			if (members[i] == header)
+			{
+				continue;
+			}
+			for (int predecessor : predecessors[members[i]])
+			{
+				if (number[predecessor] >= 0 && loopOf[predecessor] != header)
+				{
+					loopOf[predecessor] = header;
+					members.push_back(predecessor);
+				}
+			}
+		}
+
+		int exit = -1;
+		members.push_back(header);
+		for (int member : members)
+		{
+			for (int successor : successors[member])
+			{
+				if (loopOf[successor] == header)
+				{
+					continue;
+				}
+				if (exit >= 0 && exit != successor)
+				{
+					throw Unstructured();	// would need a goto out of the loop
+				}
+				exit = successor;
+			}
+		}
+		loopExit[header] = exit;
+
+		// Blocks of an inner loop may belong to this one too
+		for (int member : members)
+		{
+			loopOf[member] = -1;
+		}
+	}
+}
+
+void CodeGenerator::generateRegion(int block, int stop)
+{
+	while (block != stop && block >= 0)
+	{
+		if (atTopLevel())
+		{
+			finishStatement();
+		}
+
+		if (!loops.empty())
+		{
+			if (block == loops.back().first)
+			{
+				line("continue;");
+				return;
+			}
+			if (block == loops.back().second)
+			{
+				line("break;");
+				return;
+			}
+			for (const pair<int, int>& loop : loops)
+			{
+				if (block == loop.first || block == loop.second)
+				{
+					throw Unstructured();	// continue or break of an outer loop
+				}
+			}
+		}
+		if (emitted[block])
+		{
+			throw Unstructured();
+		}
+
+		block = loopExit[block] != -2 ? generateLoop(block) : generateBlock(block, stop);
+	}
+}
+
+int CodeGenerator::generateLoop(int header)
+{
+	int exit = loopExit[header];
+	loops.emplace_back(header, exit);
+	emitted[header] = 1;
+
+	// while (condition) if the header only tests the condition
+	const IrBlock& block = program->blocks[header];
+	bool simple = block.isTerminated() && block.terminator().opcode == IrOpcode::Branch
+		&& (block.terminator().target == exit) != (block.terminator().falseTarget == exit);
+	for (size_t i = 0; simple && i + 1 < block.instructions.size(); i++)
+	{
+		simple = writer.isInlined(block.instructions[i]);
+	}
+
+	if (simple)
+	{
+		const IrInstruction& branch = block.terminator();
+		bool exitWhenTrue = branch.target == exit;
+		startLine();
+		statement += "while (";
+		appendCondition(branch, exitWhenTrue);
+		statement += ") {\n";
+		indentLevel++;
+		generateRegion(exitWhenTrue ? branch.falseTarget : branch.target, header);
+		indentLevel--;
+	}
+	else
+	{
+		line("while (true) {");
+		indentLevel++;
+		generateRegion(generateBlock(header, header), header);
+		indentLevel--;
+	}
+	line("}");
+
+	loops.pop_back();
+	return exit;
+}
+
+int CodeGenerator::generateBlock(int block, int stop)
+{
+	emitted[block] = 1;
+	generateInstructions(block);
+
+	const IrBlock& current = program->blocks[block];
+	if (!current.isTerminated())
+	{
+		return -1;
+	}
+
+	const IrInstruction& last = current.terminator();
+	if (last.opcode == IrOpcode::Return)
+	{
+		if (!atTopLevel())
+		{
+			line("return 0;");
+		}
+		return -1;
+	}
+
+	int whenTrue = skipEmpty(last.target);
+	int whenFalse = skipEmpty(last.falseTarget);
+	if (last.opcode == IrOpcode::Jump || whenTrue == whenFalse)
+	{
+		if (last.opcode == IrOpcode::Branch && (writer.readsInput(last.left) || writer.readsInput(last.right)
+			|| writer.mayTrap(last.left) || writer.mayTrap(last.right)))
+		{
+			// Both arms are empty, but the condition still reads input or
+			// may divide by zero
+			startLine();
+			statement += "(void)";
+			appendCondition(last, false);
+			statement += ";\n";
+		}
+		return last.target;
+	}
+
+	// A branch out of or back to the innermost loop
+	if (!loops.empty())
+	{
+		for (int target : { whenTrue, whenFalse })
+		{
+			bool isExit = target == loops.back().second;
+			if (target != stop && (isExit || target == loops.back().first))
+			{
+				bool onTrue = target == whenTrue;
+				startLine();
+				statement += "if (";
+				appendCondition(last, !onTrue);
+				statement += isExit ? ") break;\n" : ") continue;\n";
+				return onTrue ? whenFalse : whenTrue;
+			}
+		}
+	}
+
+	// if/else, with both arms ending where they meet again
+	int merge = graph.postDominator[block];
+	int end = skipEmpty(merge);
+	if (whenTrue == end)
+	{
+		startLine();
+		statement += "if (";
+		appendCondition(last, true);
+		statement += ") {\n";
+		indentLevel++;
+		generateRegion(whenFalse, merge);
+		indentLevel--;
+	}
+	else
+	{
+		startLine();
+		statement += "if (";
+		appendCondition(last, false);
+		statement += ") {\n";
+		indentLevel++;
+		generateRegion(whenTrue, merge);
+		indentLevel--;
+		if (whenFalse != end)
+		{
+			line("} else {");
+			indentLevel++;
+			generateRegion(whenFalse, merge);
+			indentLevel--;
+		}
+	}
+	line("}");
+	return merge;
+}
+
+int CodeGenerator::skipEmpty(int block)
+{
+	// Blocks that only jump on, such as the then block of an if without
+	// statements; bounded in case they jump around in a circle
+	for (size_t steps = 0; block >= 0 && steps < program->blocks.size(); steps++)
+	{
+		const vector<IrInstruction>& instructions = program->blocks[block].instructions;
+		if (loopExit[block] != -2 || instructions.size() != 1 || instructions[0].opcode != IrOpcode::Jump)
+		{
+			break;
+		}
+		block = instructions[0].target;
+	}
+	return block;
+}
+
+void CodeGenerator::generateInstructions(int block)
+{
+	for (const IrInstruction& instruction : program->blocks[block].instructions)
+	{
+		if (!instruction.isTerminator() && !writer.isInlined(instruction))
+		{
+			generateInstruction(instruction);
+		}
+	}
+}
+
+void CodeGenerator::generateInstruction(const IrInstruction& instruction)
+{
+	IrInstruction reads = instruction;
+	reads.dest = IrOperand();
+	bool readsDest = instruction.opcode == IrOpcode::CopyIf;
+	writer.forEachName(reads, [&](const IrOperand& operand)
+	{
+		readsDest |= operand == instruction.dest;
+		declareBefore(operand);
+	});
+
+	startLine();
+	if (instruction.definesValue())
+	{
+		// The first store at the top level declares the variable
+		if (!declared(instruction.dest) && atTopLevel() && !readsDest)
+		{
+			declared(instruction.dest) = 1;
+			declaredNow.push_back(instruction.dest);
+			statement += writer.typeName(instruction.dest);
+			statement += ' ';
+		}
+		declareBefore(instruction.dest);
+	}
+	writer.appendStatement(statement, instruction);
+	statement += '\n';
+}
+
+void CodeGenerator::appendCondition(const IrInstruction& branch, bool negated)
+{
+	writer.forEachName(branch, [this](const IrOperand& operand) { declareBefore(operand); });
+	writer.appendCondition(statement, branch, negated);
+}
+
+void CodeGenerator::generateGotos(const IrProgram& code)
+{
+	// Gotos may not jump over a declaration with an initializer
+	for (const IrBlock& block : code.blocks)
+	{
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			if (!writer.isInlined(instruction))
+			{
+				writer.forEachName(instruction, [this](const IrOperand& operand) { declareBefore(operand); });
+			}
+		}
+	}
+	writer.writeBlocks(code, statement, "    ");
+	finishStatement();
+}
+
+char& CodeGenerator::declared(const IrOperand& operand)
+{
+	// Temporaries are numbered from zero in every streamed statement, so
+	// one declaration serves all temporaries with the same number
+	vector<char>& names = operand.kind == IrOperand::Variable ? declaredSlots : declaredTemporaries;
+	if (static_cast<size_t>(operand.value) >= names.size())
+	{
+		names.resize(operand.value + 1, 0);
+	}
+	return names[operand.value];
+}
+
+void CodeGenerator::declareBefore(const IrOperand& operand)
+{
+	if (!declared(operand))
+	{
+		declared(operand) = 1;
+		declaredNow.push_back(operand);
+		declarations += "    ";
+		declarations += writer.typeName(operand);
+		declarations += ' ';
+		writer.appendName(declarations, operand);
+		declarations += ";\n";
+	}
+}
+
+bool CodeGenerator::atTopLevel() const
+{
+	return indentLevel == 1;
+}
+
+void CodeGenerator::finishStatement()
+{
+	body += declarations;
+	body += statement;
+	declarations.clear();
+	statement.clear();
+}
+
+void CodeGenerator::startLine()
+{
+	for (int i = 0; i < indentLevel; i++)
+	{
+		statement += "    ";
+	}
+}
+
+void CodeGenerator::line(const char* text)
+{
+	startLine();
+	statement += text;
+	statement += '\n';
+}
+
+void CodeGenerator::writeIndent()
+{
+	for (int i = 0; i < indentLevel; i++)
+	{
+		output << "    ";
+	}
+}
+
+void CodeGenerator::writeLine(const char* line)
+{
+	writeIndent();
+	output << line << endl;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "Backend.h"
+#include "ControlFlowGraph.h"
+#include "CppWriter.h"
+
+/**
+ * CodeGenerator (Transpiler)
+ *
+ * Purpose: Generates structured C++ source code (if/else and while) from
+ * the IR.
+ *
+ * How it works:
+ * 1. Finds the loops (blocks that a later block jumps back to) and the
+ *    point where the two arms of each branch meet again (its immediate
+ *    post-dominator)
+ * 2. Walks the blocks from the entry: a loop header becomes a while, a
+ *    branch an if/else whose arms end at the meeting point, and a jump
+ *    out of or back to the innermost loop a break or continue
+ * 3. A variable gets its declaration at its first store if that is at
+ *    the top level of main(), otherwise just before the top-level
+ *    statement that first uses it
+ *
+ * Control flow that has no such structure is written with labels and
+ * gotos instead, as the assembly-style generator does.
+ */
+class CodeGenerator : public Backend
+{
+	struct Unstructured {};
+
+	std::ostream& output;
+	int indentLevel;
+	CppWriter writer;
+
+	// Structure of the program being generated, by block
+	const IrProgram* program;
+	ControlFlowGraph graph;
+	std::vector<int> loopExit;			// -1 if none, -2 if not a loop header
+	std::vector<char> emitted;
+	std::vector<std::pair<int, int>> loops;	// open loops: header and exit
+	std::vector<int> loopOf;			// work space of analyzeStructure()
+	std::vector<int> members;
+
+	// Declarations
+	std::vector<char> declaredSlots;
+	std::vector<char> declaredTemporaries;
+	std::vector<IrOperand> declaredNow;		// by this call, undone if it falls back to gotos
+
+	std::string body;			// generated by this call
+	std::string statement;		// current top-level statement
+	std::string declarations;	// needed before it
+
+	// Helper methods
+	void writeHeader(bool cstdint);		// and the start of main()
+	void writeIndent();
+	void writeLine(const char* line);
+	void startLine();
+	void line(const char* text);
+	bool atTopLevel() const;
+	void finishStatement();
+	char& declared(const IrOperand& operand);
+	void declareBefore(const IrOperand& operand);
+
+	// Generation methods
+	void generateCode(const IrProgram& program, int stop);
+	void analyzeStructure();
+	void generateRegion(int block, int stop);
+	int generateLoop(int header);
+	int generateBlock(int block, int stop);
+	int skipEmpty(int block);
+	void generateInstruction(const IrInstruction& instruction);
+	void generateInstructions(int block);
+	void appendCondition(const IrInstruction& branch, bool negated);
+	void generateGotos(const IrProgram& program);
+
+public:
+	CodeGenerator(std::ostream& out);
+
+	/**
+	 * Generates C++ code from a program.
+	 * Wraps the generated code in a complete C++ program with main().
+	 */
+	void generate(const IrProgram& program) override;
+
+	/**
+	 * Streaming interface: begin() writes the program prologue,
+	 * generateFragment() emits one top-level statement and end() closes
+	 * main().
+	 */
+	void begin() override;
+	void generateFragment(const IrProgram& fragment) override;
+	void end() override;
+	void reset() override;
+};
@@ -0,0 +1,304 @@
+#include "Compiler.h"
+#include "AllocProfiler.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "CodeGenerator.h"
+#include "AssemblyCodeGenerator.h"
+#include "Pipeline.h"
+
+using namespace std;
+
+Compiler::Compiler(BackendKind backend)
+	: sink(nullptr), backend(backend), irListing(nullptr), tokenCount(0), statementCount(0), slotCount(0)
+{
+	structuredGenerator = createBackend(BackendKind::Structured, sink);
+	assemblyGenerator = createBackend(BackendKind::Assembly, sink);
+
+	// -O1 keeps the passes that work on straight-line code and jumps,
+	// -Os leaves out unrolling, reduction splitting, partial evaluation and
+	// strength reduction (a division by a constant becomes up to six
+	// operations), which trade size for speed
+	const unsigned all = PassManager::optimizingLevels;
+	const unsigned basic = PassManager::levelBit(OptimizationLevel::Basic);
+	const unsigned size = PassManager::levelBit(OptimizationLevel::Size);
+	foldPass = passes.add("constant-folder", all, [this] { folder.reset(); },
+		[this] { return folder.foldCount + folder.propagationCount; },
+		[this](ostream& out)
+		{
+			out << "Folded " << folder.foldCount << " constant expression(s) and propagated "
+				<< folder.propagationCount << " variable value(s)";
+		});
+	eliminationPass = passes.add("dead-code-eliminator", all, [this] { eliminator.reset(); },
+		[this] { return eliminator.removedBranchCount + eliminator.removedStatementCount; },
+		[this](ostream& out)
+		{
+			out << "Removed " << eliminator.removedBranchCount << " unreachable branch(es) and "
+				<< eliminator.removedStatementCount << " dead store(s)";
+		});
+	fusionPass = passes.add("loop-fuser", all & ~basic, [this] { fuser.reset(); },
+		[this] { return fuser.fusedCount; },
+		[this](ostream& out) { out << "Fused " << fuser.fusedCount << " loop(s) into the loop before them"; });
+	passes.add("partial-evaluator", all & ~basic & ~size, [this] { partialEvaluator.reset(); },
+		[this] { return partialEvaluator.evaluatedCount; },
+		[this](ostream& out)
+		{
+			out << "Evaluated " << partialEvaluator.evaluatedCount << " IR instruction(s) while compiling, printing "
+				<< partialEvaluator.printedCount << " character(s) and presetting " << partialEvaluator.presetCount
+				<< " variable(s)";
+		},
+		[this](IrProgram& program) { partialEvaluator.settings = evaluation; partialEvaluator.run(program); });
+	passes.add("algebraic-simplifier", all, [this] { simplifier.reset(); },
+		[this] { return simplifier.simplifiedCount + simplifier.normalizedCount; },
+		[this](ostream& out)
+		{
+			out << "Simplified " << simplifier.simplifiedCount << " arithmetic chain(s), leaving out "
+				<< simplifier.removedOperationCount << " operation(s), and normalized " << simplifier.normalizedCount
+				<< " comparison(s)";
+		},
+		[this](IrProgram& program) { simplifier.run(program); });
+	passes.add("value-numbering", all, [this] { valueNumbering.reset(); },
+		[this] { return valueNumbering.reusedCount; },
+		[this](ostream& out) { out << "Reused " << valueNumbering.reusedCount << " common subexpression(s)"; },
+		[this](IrProgram& program) { valueNumbering.run(program); });
+	passes.add("loop-invariant-motion", all & ~basic, [this] { invariantMotion.reset(); },
+		[this] { return invariantMotion.hoistedCount; },
+		[this](ostream& out) { out << "Hoisted " << invariantMotion.hoistedCount << " loop-invariant expression(s)"; },
+		[this](IrProgram& program) { invariantMotion.run(program); });
+	passes.add("loop-collapser", all & ~basic, [this] { loopCollapser.reset(); },
+		[this] { return loopCollapser.collapsedCount; },
+		[this](ostream& out) { out << "Collapsed " << loopCollapser.collapsedCount << " counting loop(s) to closed forms"; },
+		[this](IrProgram& program) { loopCollapser.run(program); });
+	passes.add("range-optimizer", all & ~basic, [this] { rangeOptimizer.reset(); },
+		[this]
+		{
+			return rangeOptimizer.decidedBranchCount + rangeOptimizer.unwrappedCount + rangeOptimizer.narrowedCount;
+		},
+		[this](ostream& out)
+		{
+			out << "Decided " << rangeOptimizer.decidedBranchCount << " comparison(s) from value ranges, removed the "
+				<< "wraparound of " << rangeOptimizer.unwrappedCount << " operation(s) and narrowed "
+				<< rangeOptimizer.narrowedCount << " variable(s) to 8 or 16 bits";
+		},
+		[this](IrProgram& program) { rangeOptimizer.run(program); });
+	passes.add("loop-unroller", all & ~basic & ~size, [this] { loopUnroller.reset(); },
+		[this] { return loopUnroller.fullCount + loopUnroller.partialCount; },
+		[this](ostream& out)
+		{
+			out << "Unrolled " << loopUnroller.fullCount << " loop(s) fully and " << loopUnroller.partialCount
+				<< " by a factor of " << unrolling.factor << ", adding " << loopUnroller.copiedInstructionCount
+				<< " and removing " << loopUnroller.removedInstructionCount << " IR instruction(s)";
+		},
+		[this](IrProgram& program) { loopUnroller.settings = unrolling; loopUnroller.run(program); });
+	passes.add("reduction-splitter", all & ~basic & ~size, [this] { reductionSplitter.reset(); },
+		[this] { return reductionSplitter.splitCount; },
+		[this](ostream& out)
+		{
+			out << "Split the reductions of " << reductionSplitter.splitCount << " loop(s), adding "
+				<< reductionSplitter.accumulatorCount << " accumulator(s)";
+		},
+		[this](IrProgram& program) { reductionSplitter.settings = reduction; reductionSplitter.run(program); });
+	passes.add("strength-reducer", all & ~size, [this] { strengthReducer.reset(); },
+		[this] { return strengthReducer.reducedCount + strengthReducer.inductionCount; },
+		[this](ostream& out)
+		{
+			out << "Strength-reduced " << strengthReducer.reducedCount << " multiplication(s) and division(s), and "
+				<< strengthReducer.inductionCount << " induction variable product(s)";
+		},
+		[this](IrProgram& program) { strengthReducer.run(program); });
+	blockPass = passes.add("block-optimizer", all, [this] { blockOptimizer.reset(); },
+		[this]
+		{
+			return blockOptimizer.threadedJumpCount + blockOptimizer.returnedJumpCount + blockOptimizer.rotatedLoopCount
+				+ blockOptimizer.mergedBlockCount + blockOptimizer.removedBlockCount;
+		},
+		[this](ostream& out)
+		{
+			out << "Threaded " << blockOptimizer.threadedJumpCount << " jump(s), replaced "
+				<< blockOptimizer.returnedJumpCount << " jump(s) by a return, rotated "
+				<< blockOptimizer.rotatedLoopCount << " loop(s), merged " << blockOptimizer.mergedBlockCount
+				<< " block(s) and dropped " << blockOptimizer.removedBlockCount << " unreachable block(s)";
+		},
+		[this](IrProgram& program) { blockOptimizer.run(program); });
+	passes.add("slot-allocator", all & ~basic, [this] { slotAllocator.reset(); },
+		[this] { return slotAllocator.savedSlotCount + slotAllocator.removedCopyCount; },
+		[this](ostream& out)
+		{
+			out << "Saved " << slotAllocator.savedSlotCount << " variable slot(s) by sharing them, and removed "
+				<< slotAllocator.removedCopyCount << " copy instruction(s)";
+		},
+		[this](IrProgram& program) { slotAllocator.run(program); });
+	passes.add("if-converter", all & ~basic, [this] { ifConverter.reset(); },
+		[this] { return ifConverter.selectCount + ifConverter.conditionalCount; },
+		[this](ostream& out)
+		{
+			out << "Converted " << ifConverter.selectCount << " if/else(s) into selects and "
+				<< ifConverter.conditionalCount << " if(s) into conditional copies";
+		},
+		[this](IrProgram& program) { ifConverter.settings = selection; ifConverter.run(program); });
+}
+
+void Compiler::compile(const char* source, size_t length, ostream& out)
+{
+	startPasses();
+
+	// Stage 1: Lexical Analysis
+	lexer.reset(source, length);
+	lexer.tokenize(tokens);
+	tokenCount = tokens.size();
+
+	// Stage 2: Parsing
+	parser.reset(tokens);
+	unique_ptr<ProgramNode> ast(parser.parse());
+	statementCount = ast->statements.size();
+
+	// Stage 3: Semantic Analysis
+	resolver.reset();
+	resolver.resolve(ast.get());
+	slotCount = ast->slotNames->size();
+
+	// Stage 4: Optimization
+	passes.run(foldPass, [&] { folder.run(ast.get()); });
+	passes.run(eliminationPass, [&] { eliminator.run(ast.get()); });
+	fuser.settings = fusion;
+	passes.run(fusionPass, [&] { fuser.run(ast.get()); });
+
+	// Stage 5: Lowering to three-address code and IR optimization
+	builder.lower(ast.get(), ir);
+	optimizeIr();
+	checkIr();
+
+	// Stage 6: Code Generation
+	Backend& generator = backend == BackendKind::Assembly ? *assemblyGenerator : *structuredGenerator;
+	generator.reset();
+	sink.rdbuf(out.rdbuf());
+	generator.generate(ir);
+	sink.flush();
+	if (!sink)
+	{
+		out.setstate(ios::badbit);
+	}
+	sink.rdbuf(nullptr);
+}
+
+void Compiler::compile(const string& source, ostream& out)
+{
+	compile(source.data(), source.length(), out);
+}
+
+void Compiler::compileStreaming(istream& in, ostream& out)
+{
+	Lexer lexer(in);
+	Parser parser(lexer);
+	auto generator = createBackend(backend, out);
+
+	tokenCount = 0;
+	statementCount = 0;
+	resolver.reset();
+	startPasses();
+	builder.reset();
+	ir.clear();
+	generator->begin();
+	while (Statement* parsed = parser.parseNext())
+	{
+		Statement* statement;
+		try
+		{
+			statement = prepareTopLevel(parsed);
+		}
+		catch (...)
+		{
+			delete parsed;
+			throw;
+		}
+		if (statement == nullptr)
+		{
+			continue;
+		}
+
+		unique_ptr<Statement> owned(statement);
+		generateTopLevel(*generator, statement);
+		statementCount++;
+	}
+	generator->end();
+	slotCount = resolver.slots().size();
+}
+
+void Compiler::compilePipelined(istream& in, ostream& out, ostream* stats)
+{
+	auto generator = createBackend(backend, out);
+	Pipeline pipeline(in,
+		[&](Statement* statement) { generateTopLevel(*generator, statement); },
+		[this](Statement* statement) { return prepareTopLevel(statement); });
+
+	resolver.reset();
+	startPasses();
+	builder.reset();
+	ir.clear();
+	generator->begin();
+	pipeline.run();
+	generator->end();
+	tokenCount = pipeline.tokenCount;
+	statementCount = pipeline.statementCount;
+	slotCount = resolver.slots().size();
+
+	if (stats != nullptr)
+	{
+		pipeline.reportStats(*stats);
+	}
+}
+
+void Compiler::startPasses()
+{
+	passes.configure();
+	fuser.settings = fusion;
+	if (backend != BackendKind::Assembly)
+	{
+		passes.disable(blockPass);
+	}
+	passes.reset();
+}
+
+Statement* Compiler::prepareTopLevel(Statement* statement)
+{
+	resolver.resolveTopLevel(statement);
+	passes.run(foldPass, [&] { folder.runTopLevel(statement); });
+	passes.run(eliminationPass, [&] { statement = eliminator.runTopLevel(statement); });
+	if (statement != nullptr)
+	{
+		passes.run(fusionPass, [&] { fuser.runTopLevel(statement); });
+	}
+	return statement;
+}
+
+void Compiler::generateTopLevel(Backend& generator, Statement* statement)
+{
+	builder.lowerFragment(statement, ir);
+	optimizeIr();
+	checkIr();
+	generator.generateFragment(ir);
+}
+
+void Compiler::optimizeIr()
+{
+	passes.runIr(ir);
+}
+
+void Compiler::checkIr()
+{
+#ifndef NDEBUG
+	ir.verify();
+#endif
+	if (irListing != nullptr)
+	{
+		ir.print(*irListing);
+	}
+}
+
+unique_ptr<Backend> Compiler::createBackend(BackendKind kind, ostream& out)
+{
+	if (kind == BackendKind::Assembly)
+	{
+		return unique_ptr<Backend>(new AssemblyCodeGenerator(out));
+	}
+	return unique_ptr<Backend>(new CodeGenerator(out));
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Backend.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "ConstantFolder.h"
+#include "DeadCodeEliminator.h"
+#include "LoopFuser.h"
+#include "IR.h"
+#include "IrBuilder.h"
+#include "PartialEvaluator.h"
+#include "AlgebraicSimplifier.h"
+#include "ValueNumbering.h"
+#include "LoopInvariantMotion.h"
+#include "LoopCollapser.h"
+#include "LoopUnroller.h"
+#include "ReductionSplitter.h"
+#include "RangeOptimizer.h"
+#include "StrengthReducer.h"
+#include "BlockOptimizer.h"
+#include "SlotAllocator.h"
+#include "IfConverter.h"
+#include "PassManager.h"
+
+/**
+ * BackendKind - Output style of the generated C++ code.
+ */
+enum class BackendKind
+{
+	Structured,	// if/while blocks (CodeGenerator)
+	Assembly	// labels and gotos (AssemblyCodeGenerator)
+};
+
+/**
+ * Compiler (Compilation context)
+ * 
+ * Purpose: Runs the Lexer -> Parser -> Resolver -> ConstantFolder ->
+ * DeadCodeEliminator -> LoopFuser -> IrBuilder -> PartialEvaluator ->
+ * AlgebraicSimplifier -> ValueNumbering -> LoopInvariantMotion ->
+ * LoopCollapser -> RangeOptimizer -> LoopUnroller -> ReductionSplitter ->
+ * StrengthReducer -> (BlockOptimizer) -> SlotAllocator -> IfConverter ->
+ * code generator stages as one call.
+ * BlockOptimizer only runs for assembly-style output, since the structured
+ * generator finds its own way through the blocks. Which optimization passes
+ * run is up to passes: each compilation applies its level and disabled
+ * passes first.
+ * 
+ * A Compiler has no shared or global state, so separate instances may be
+ * used from separate threads at the same time, and one instance may be
+ * reused for any number of compilations. compile() keeps the lexer,
+ * parser, token list and code generators between calls, so once their
+ * buffers have grown to fit, further compilations barely allocate.
+ */
+class Compiler
+{
+	Lexer lexer;
+	Parser parser;
+	Resolver resolver;
+	ConstantFolder folder;
+	DeadCodeEliminator eliminator;
+	LoopFuser fuser;
+	IrBuilder builder;
+	PartialEvaluator partialEvaluator;
+	AlgebraicSimplifier simplifier;
+	ValueNumbering valueNumbering;
+	LoopInvariantMotion invariantMotion;
+	LoopCollapser loopCollapser;
+	RangeOptimizer rangeOptimizer;
+	LoopUnroller loopUnroller;
+	ReductionSplitter reductionSplitter;
+	StrengthReducer strengthReducer;
+	BlockOptimizer blockOptimizer;
+	SlotAllocator slotAllocator;
+	IfConverter ifConverter;
+	IrProgram ir;
+	int foldPass;			// numbers of the AST passes in passes
+	int eliminationPass;
+	int fusionPass;
+	int blockPass;
+	std::vector<Token> tokens;
+	std::ostream sink;	// the generators write here; forwards to the caller's stream
+	std::unique_ptr<Backend> structuredGenerator;
+	std::unique_ptr<Backend> assemblyGenerator;
+
+	void startPasses();
+	Statement* prepareTopLevel(Statement* statement);
+	void generateTopLevel(Backend& generator, Statement* statement);
+	void optimizeIr();
+	void checkIr();
+
+public:
+	BackendKind backend;
+	std::ostream* irListing;	// if set, the IR is written here before code generation
+	FusionSettings fusion;		// how large a fused loop may be
+	EvaluationSettings evaluation;	// how much of the program may run while compiling
+	UnrollSettings unrolling;	// how much code loop unrolling may add
+	ReductionSettings reduction;	// how many accumulators a reduction is split into
+	SelectSettings selection;	// how much work an if may do on both ways
+	PassManager passes;			// optimization level, disabled passes and per-pass statistics
+
+	// Statistics of the last compilation (tokens are not counted when streaming);
+	// those of the optimization passes are kept by passes
+	size_t tokenCount;
+	size_t statementCount;
+	size_t slotCount;
+
+	Compiler(BackendKind backend = BackendKind::Structured);
+
+	/**
+	 * Compiles a complete in-memory program. Throws runtime_error on
+	 * syntax errors and undeclared or duplicate variables, in which case
+	 * nothing is written to out.
+	 */
+	void compile(const char* source, size_t length, std::ostream& out);
+	void compile(const std::string& source, std::ostream& out);
+
+	/**
+	 * Compiles one top-level statement at a time, so memory is bounded
+	 * by the largest statement. Statements before an error have already
+	 * been written when it is thrown.
+	 */
+	void compileStreaming(std::istream& in, std::ostream& out);
+
+	/**
+	 * Like compileStreaming(), with the lexer and parser on their own
+	 * threads. Queue statistics are written to stats if it is given.
+	 */
+	void compilePipelined(std::istream& in, std::ostream& out, std::ostream* stats = nullptr);
+
+	/**
+	 * Creates the code generator for the given output style.
+	 */
+	static std::unique_ptr<Backend> createBackend(BackendKind kind, std::ostream& out);
+};
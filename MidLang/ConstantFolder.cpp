@@ -0,0 +1,266 @@
+#include "ConstantFolder.h"
+#include "AllocProfiler.h"
+#include <climits>
+
+using namespace std;
+
+ConstantFolder::ConstantFolder()
+	: foldCount(0), propagationCount(0)
+{
+}
+
+void ConstantFolder::reset()
+{
+	values.clear();
+	savedDepth = 0;
+	foldCount = 0;
+	propagationCount = 0;
+}
+
+void ConstantFolder::run(ProgramNode* program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	foldBlock(program->statements);
+}
+
+void ConstantFolder::runTopLevel(Statement* statement)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	foldStatement(statement);
+}
+
+bool ConstantFolder::evaluate(const string& op, int left, int right, int& result)
+{
+	long long wide;
+	if (op == "+")
+	{
+		wide = static_cast<long long>(left) + right;
+	}
+	else if (op == "-")
+	{
+		wide = static_cast<long long>(left) - right;
+	}
+	else if (op == "*")
+	{
+		wide = static_cast<long long>(left) * right;
+	}
+	else if (op == "/")
+	{
+		if (right == 0)
+		{
+			return false;
+		}
+		wide = static_cast<long long>(left) / right;	// truncates toward zero, like C++
+	}
+	else
+	{
+		return false;
+	}
+
+	// INT_MIN has no literal of type int in C++, so it is not folded either
+	if (wide <= INT_MIN || wide > INT_MAX)
+	{
+		return false;
+	}
+	result = static_cast<int>(wide);
+	return true;
+}
+
+bool ConstantFolder::compare(const string& op, int left, int right)
+{
+	if (op == "==") return left == right;
+	if (op == "!=") return left != right;
+	if (op == "<") return left < right;
+	if (op == ">") return left > right;
+	if (op == "<=") return left <= right;
+	return left >= right;
+}
+
+bool ConstantFolder::decide(const BooleanExpression* condition, bool& result)
+{
+	const IntegerLiteral* left = dynamic_cast<const IntegerLiteral*>(condition->left);
+	const IntegerLiteral* right = dynamic_cast<const IntegerLiteral*>(condition->right);
+	if (left == nullptr || right == nullptr)
+	{
+		return false;
+	}
+
+	result = compare(condition->op, left->value, right->value);
+	return true;
+}
+
+void ConstantFolder::foldBlock(const vector<Statement*>& statements)
+{
+	for (auto* statement : statements)
+	{
+		foldStatement(statement);
+	}
+}
+
+void ConstantFolder::foldStatement(Statement* statement)
+{
+	if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+	{
+		varDecl->expression = foldExpression(varDecl->expression);
+		assign(varDecl->slot, varDecl->expression);
+	}
+	else if (AssignmentStatement* assignment = dynamic_cast<AssignmentStatement*>(statement))
+	{
+		assignment->expression = foldExpression(assignment->expression);
+		assign(assignment->slot, assignment->expression);
+	}
+	else if (PrintStatement* print = dynamic_cast<PrintStatement*>(statement))
+	{
+		print->expression = foldExpression(print->expression);
+	}
+	else if (PrintLineStatement* println = dynamic_cast<PrintLineStatement*>(statement))
+	{
+		println->expression = foldExpression(println->expression);
+	}
+	else if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+	{
+		foldCondition(ifStmt->condition);
+
+		// The saved values before the if become those after the then branch
+		size_t saved = save();
+		foldBlock(ifStmt->thenStatements);
+		values.swap(savedValues[saved]);
+		foldBlock(ifStmt->elseStatements);
+
+		bool taken;
+		if (decide(ifStmt->condition, taken))
+		{
+			if (taken)
+			{
+				values.swap(savedValues[saved]);
+			}
+		}
+		else
+		{
+			merge(savedValues[saved]);
+		}
+		savedDepth--;
+	}
+	else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+	{
+		// Anything the body assigns may differ from one iteration to the next
+		forgetAssigned(whileStmt->bodyStatements);
+		foldCondition(whileStmt->condition);
+
+		size_t saved = save();
+		foldBlock(whileStmt->bodyStatements);
+		values.swap(savedValues[saved]);
+		savedDepth--;
+	}
+}
+
+size_t ConstantFolder::save()
+{
+	if (savedDepth == savedValues.size())
+	{
+		savedValues.emplace_back();
+	}
+	savedValues[savedDepth] = values;
+	return savedDepth++;
+}
+
+Expression* ConstantFolder::foldExpression(Expression* expression)
+{
+	if (VariableReference* varRef = dynamic_cast<VariableReference*>(expression))
+	{
+		if (varRef->slot >= 0 && static_cast<size_t>(varRef->slot) < values.size() && values[varRef->slot].known)
+		{
+			propagationCount++;
+			int value = values[varRef->slot].value;
+			delete varRef;
+			return new IntegerLiteral(value);
+		}
+	}
+	else if (BinaryExpression* binExpr = dynamic_cast<BinaryExpression*>(expression))
+	{
+		binExpr->left = foldExpression(binExpr->left);
+		binExpr->right = foldExpression(binExpr->right);
+
+		IntegerLiteral* left = dynamic_cast<IntegerLiteral*>(binExpr->left);
+		IntegerLiteral* right = dynamic_cast<IntegerLiteral*>(binExpr->right);
+		int result;
+		if (left != nullptr && right != nullptr && evaluate(binExpr->op, left->value, right->value, result))
+		{
+			foldCount++;
+			delete binExpr;
+			return new IntegerLiteral(result);
+		}
+	}
+	else if (BooleanExpression* boolExpr = dynamic_cast<BooleanExpression*>(expression))
+	{
+		foldCondition(boolExpr);
+	}
+	return expression;
+}
+
+void ConstantFolder::foldCondition(BooleanExpression* condition)
+{
+	condition->left = foldExpression(condition->left);
+	condition->right = foldExpression(condition->right);
+}
+
+void ConstantFolder::assign(int slot, const Expression* expression)
+{
+	if (slot < 0)
+	{
+		return;
+	}
+	if (static_cast<size_t>(slot) >= values.size())
+	{
+		values.resize(slot + 1, Value{ false, 0 });
+	}
+
+	const IntegerLiteral* literal = dynamic_cast<const IntegerLiteral*>(expression);
+	values[slot] = literal != nullptr ? Value{ true, literal->value } : Value{ false, 0 };
+}
+
+void ConstantFolder::forgetAssigned(const vector<Statement*>& statements)
+{
+	for (auto* statement : statements)
+	{
+		int slot = -1;
+		if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+		{
+			slot = varDecl->slot;
+		}
+		else if (AssignmentStatement* assignment = dynamic_cast<AssignmentStatement*>(statement))
+		{
+			slot = assignment->slot;
+		}
+		else if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+		{
+			forgetAssigned(ifStmt->thenStatements);
+			forgetAssigned(ifStmt->elseStatements);
+		}
+		else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+		{
+			forgetAssigned(whileStmt->bodyStatements);
+		}
+
+		if (slot >= 0 && static_cast<size_t>(slot) < values.size())
+		{
+			values[slot].known = false;
+		}
+	}
+}
+
+void ConstantFolder::merge(const vector<Value>& other)
+{
+	// A slot first assigned in only one branch is unknown after the if
+	if (values.size() > other.size())
+	{
+		values.resize(other.size());
+	}
+	for (size_t slot = 0; slot < values.size(); slot++)
+	{
+		if (values[slot].known && (!other[slot].known || other[slot].value != values[slot].value))
+		{
+			values[slot].known = false;
+		}
+	}
+}
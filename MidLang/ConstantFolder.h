@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AST.h"
+
+/**
+ * ConstantFolder (Optimization pass)
+ *
+ * Purpose: Replaces expressions whose value is known at compile time with
+ * integer literals, so the generated C++ does not compute them at run time.
+ *
+ * How it works:
+ * 1. Walks the resolved AST in program order, remembering which variable
+ *    slots hold a known constant
+ * 2. Replaces references to such variables with their value (propagation)
+ * 3. Replaces binary expressions on two literals with the result (folding)
+ * 4. At an if, follows both branches and keeps only the values they agree
+ *    on, or just the taken branch when the condition is a constant
+ * 5. At a while, forgets every variable the loop body assigns before
+ *    looking at the condition or the body
+ *
+ * The pass needs the slots assigned by Resolver. It never folds a division
+ * by zero, or an operation whose result does not fit in an int (signed
+ * overflow is undefined in the generated C++); those are left for run time.
+ */
+class ConstantFolder
+{
+	struct Value
+	{
+		bool known;
+		int value;
+	};
+
+	std::vector<Value> values;	// indexed by slot
+	std::vector<std::vector<Value>> savedValues;	// by nesting depth, kept between programs
+	size_t savedDepth = 0;
+
+	void foldBlock(const vector<Statement*>& statements);
+	void foldStatement(Statement* statement);
+	Expression* foldExpression(Expression* expression);
+	void foldCondition(BooleanExpression* condition);
+	void assign(int slot, const Expression* expression);
+	void forgetAssigned(const vector<Statement*>& statements);
+	void merge(const std::vector<Value>& other);
+	size_t save();	// copies values to the next saved level and returns its index
+
+public:
+	// Statistics since the last reset()
+	size_t foldCount;			// binary expressions replaced by a literal
+	size_t propagationCount;	// variable references replaced by a literal
+
+	ConstantFolder();
+
+	/**
+	 * Forgets all known values and statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Folds a whole resolved program in place.
+	 */
+	void run(ProgramNode* program);
+
+	/**
+	 * Folds one top-level statement of a streamed program. Values known
+	 * after earlier statements are used.
+	 */
+	void runTopLevel(Statement* statement);
+
+	/**
+	 * Computes left op right for +, -, * and /. Returns false if the
+	 * result is not a well-defined int (division by zero or overflow).
+	 */
+	static bool evaluate(const std::string& op, int left, int right, int& result);
+
+	/**
+	 * Computes left op right for ==, !=, <, >, <= and >=.
+	 */
+	static bool compare(const std::string& op, int left, int right);
+
+	/**
+	 * Decides a condition whose operands are both literals. Returns false
+	 * if the condition cannot be decided at compile time.
+	 */
+	static bool decide(const BooleanExpression* condition, bool& result);
+};
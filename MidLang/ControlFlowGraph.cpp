@@ -0,0 +1,255 @@
+#include "ControlFlowGraph.h"
+
+using namespace std;
+
+void ControlFlowGraph::build(const IrProgram& program)
+{
+	int count = static_cast<int>(program.blocks.size());
+
+	successors.resize(count);
+	predecessors.resize(count);
+	for (int block = 0; block < count; block++)
+	{
+		vector<int>& targets = successors[block];
+		targets.clear();
+		predecessors[block].clear();
+
+		const IrBlock& current = program.blocks[block];
+		if (!current.isTerminated())
+		{
+			continue;
+		}
+		const IrInstruction& last = current.terminator();
+		if (last.opcode == IrOpcode::Jump || last.opcode == IrOpcode::Branch)
+		{
+			targets.push_back(last.target);
+		}
+		if (last.opcode == IrOpcode::Branch && last.falseTarget != last.target)
+		{
+			targets.push_back(last.falseTarget);
+		}
+	}
+	for (int block = 0; block < count; block++)
+	{
+		for (int successor : successors[block])
+		{
+			predecessors[successor].push_back(block);
+		}
+	}
+
+	computeDominators(successors, predecessors, 0, dominator);
+
+	// Reverse postorder of the blocks reachable from the entry
+	order.assign(postorder.rbegin(), postorder.rend());
+	orderNumber.assign(count, -1);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		orderNumber[order[i]] = static_cast<int>(i);
+	}
+
+	// Unreachable blocks have no say in what comes after a reachable one
+	for (int block = 0; block < count; block++)
+	{
+		vector<int>& sources = predecessors[block];
+		size_t kept = 0;
+		for (int source : sources)
+		{
+			if (orderNumber[source] >= 0)
+			{
+				sources[kept++] = source;
+			}
+		}
+		sources.resize(kept);
+	}
+
+	// Post-dominators are the dominators of the reversed graph, entered
+	// from a virtual node that every end of the program leads to
+	reverseSuccessors.resize(count + 1);
+	reversePredecessors.resize(count + 1);
+	reverseSuccessors[count].clear();
+	reversePredecessors[count].clear();
+	for (int block = 0; block < count; block++)
+	{
+		reverseSuccessors[block] = predecessors[block];
+		reversePredecessors[block] = successors[block];
+		if (successors[block].empty() && orderNumber[block] >= 0)
+		{
+			reverseSuccessors[count].push_back(block);
+			reversePredecessors[block].push_back(count);
+		}
+	}
+	computeDominators(reverseSuccessors, reversePredecessors, count, reverseDominator);
+
+	postDominator.assign(reverseDominator.begin(), reverseDominator.end() - 1);
+	for (int& block : postDominator)
+	{
+		if (block == count)
+		{
+			block = -1;
+		}
+	}
+}
+
+void ControlFlowGraph::computeDominators(const vector<vector<int>>& forward, const vector<vector<int>>& backward,
+	int entry, vector<int>& idom)
+{
+	size_t count = forward.size();
+	number.assign(count, -1);
+	postorder.clear();
+	idom.assign(count, -1);
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Depth-first postorder; -2 marks a node that is on the stack
+	stack.clear();
+	stack.emplace_back(entry, 0);
+	number[entry] = -2;
+	while (!stack.empty())
+	{
+		int node = stack.back().first;
+		size_t& next = stack.back().second;
+		if (next < forward[node].size())
+		{
+			int successor = forward[node][next++];
+			if (number[successor] == -1)
+			{
+				number[successor] = -2;
+				stack.emplace_back(successor, 0);
+			}
+			continue;
+		}
+		number[node] = static_cast<int>(postorder.size());
+		postorder.push_back(node);
+		stack.pop_back();
+	}
+
+	// Cooper-Harvey-Kennedy: intersect the dominators of the processed
+	// predecessors, in reverse postorder, until nothing changes
+	idom[entry] = entry;
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = postorder.size(); i-- > 0;)
+		{
+			int node = postorder[i];
+			if (node == entry)
+			{
+				continue;
+			}
+
+			int candidate = -1;
+			for (int predecessor : backward[node])
+			{
+				if (number[predecessor] < 0 || idom[predecessor] < 0)
+				{
+					continue;
+				}
+				if (candidate < 0)
+				{
+					candidate = predecessor;
+					continue;
+				}
+				int a = predecessor;
+				int b = candidate;
+				while (a != b)
+				{
+					while (number[a] < number[b]) a = idom[a];
+					while (number[b] < number[a]) b = idom[b];
+				}
+				candidate = a;
+			}
+			if (candidate != idom[node])
+			{
+				idom[node] = candidate;
+				changed = true;
+			}
+		}
+	}
+	idom[entry] = -1;
+}
+
+bool ControlFlowGraph::dominates(int a, int b) const
+{
+	if (orderNumber[a] < 0 || orderNumber[b] < 0)
+	{
+		return false;
+	}
+
+	// A dominator comes earlier in reverse postorder than what it dominates
+	while (b >= 0 && orderNumber[b] > orderNumber[a])
+	{
+		b = dominator[b];
+	}
+	return b == a;
+}
+
+bool ControlFlowGraph::isBackEdge(int from, int to) const
+{
+	return orderNumber[from] >= 0 && orderNumber[to] >= 0
+		&& orderNumber[to] <= orderNumber[from] && dominates(to, from);
+}
+
+bool ControlFlowGraph::collectLoop(int header, vector<int>& members, vector<int>& loopOf) const
+{
+	members.clear();
+	for (int latch : predecessors[header])
+	{
+		if (isBackEdge(latch, header) && loopOf[latch] != header)
+		{
+			loopOf[latch] = header;
+			members.push_back(latch);
+		}
+	}
+	if (members.empty())
+	{
+		return false;
+	}
+	if (loopOf[header] != header)
+	{
+		loopOf[header] = header;
+		members.push_back(header);
+	}
+
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		if (members[i] == header)
+		{
+			continue;
+		}
+		for (int predecessor : predecessors[members[i]])
+		{
+			if (loopOf[predecessor] != header)
+			{
+				loopOf[predecessor] = header;
+				members.push_back(predecessor);
+			}
+		}
+	}
+	return true;
+}
+
+int ControlFlowGraph::findPreheader(const IrProgram& program, int header, const vector<int>& loopOf) const
+{
+	int preheader = -1;
+	for (int predecessor : predecessors[header])
+	{
+		if (loopOf[predecessor] == header)
+		{
+			continue;
+		}
+		if (preheader >= 0)
+		{
+			return -1;
+		}
+		preheader = predecessor;
+	}
+	if (preheader < 0 || !program.blocks[preheader].isTerminated()
+		|| program.blocks[preheader].terminator().opcode != IrOpcode::Jump)
+	{
+		return -1;
+	}
+	return preheader;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "IR.h"
+
+/**
+ * ControlFlowGraph (CFG analysis)
+ *
+ * Purpose: The edges between the basic blocks of an IrProgram, with the
+ * block order and dominator trees that the passes and generators need.
+ *
+ * How it works:
+ * 1. Collects the successors of each block from its terminator, and the
+ *    predecessors from those
+ * 2. Numbers the blocks reachable from the entry in reverse postorder
+ * 3. Computes immediate dominators and post-dominators with the
+ *    Cooper-Harvey-Kennedy iteration over that order
+ *
+ * build() keeps the capacity of all its vectors, so one graph can be
+ * rebuilt for many programs without allocating.
+ */
+class ControlFlowGraph
+{
+	// Work space, kept between builds
+	std::vector<int> number;		// postorder number, -1 if not reached
+	std::vector<int> postorder;
+	std::vector<std::pair<int, size_t>> stack;
+	std::vector<std::vector<int>> reverseSuccessors;	// the reversed graph, with
+	std::vector<std::vector<int>> reversePredecessors;	// a virtual exit node
+	std::vector<int> reverseDominator;
+
+	void computeDominators(const std::vector<std::vector<int>>& forward,
+		const std::vector<std::vector<int>>& backward, int entry, std::vector<int>& idom);
+
+public:
+	std::vector<std::vector<int>> successors;		// by block
+	std::vector<std::vector<int>> predecessors;		// by block, reachable ones only
+	std::vector<int> order;				// reachable blocks in reverse postorder
+	std::vector<int> orderNumber;		// position in order, -1 if unreachable
+	std::vector<int> dominator;			// immediate dominator, -1 for the entry and unreachable blocks
+	std::vector<int> postDominator;		// immediate post-dominator, -1 if it is the end of the program
+
+	/**
+	 * Analyzes program, whose entry is blocks[0]. Blocks without a
+	 * successor (a Return, or the open block of a fragment) end it.
+	 */
+	void build(const IrProgram& program);
+
+	bool isReachable(int block) const { return orderNumber[block] >= 0; }
+
+	/**
+	 * True if every path from the entry to b goes through a.
+	 */
+	bool dominates(int a, int b) const;
+
+	/**
+	 * True if the edge from -> to jumps back to a block that dominates
+	 * from, making to the header of a loop.
+	 */
+	bool isBackEdge(int from, int to) const;
+
+	/**
+	 * Collects the loop of header into members: the header and every
+	 * block that reaches an edge back to it without passing through it.
+	 * The members are marked with header in loopOf (by block, assigned
+	 * once per build by the caller). Returns false if no edge goes back
+	 * to header.
+	 */
+	bool collectLoop(int header, std::vector<int>& members, std::vector<int>& loopOf) const;
+
+	/**
+	 * The block that enters the loop collected for header: its only
+	 * predecessor outside the loop, if that ends in a jump. -1 if there
+	 * is none (IrBuilder always creates one).
+	 */
+	int findPreheader(const IrProgram& program, int header, const std::vector<int>& loopOf) const;
+};
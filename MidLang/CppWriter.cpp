@@ -0,0 +1,489 @@
+#include "CppWriter.h"
+#include <cctype>
+
+using namespace std;
+
+namespace
+{
+	bool looksLikeTemporary(const string& name)
+	{
+		if (name.size() < 3 || name[0] != '_' || name[1] != 't')
+		{
+			return false;
+		}
+		for (size_t i = 2; i < name.size(); i++)
+		{
+			if (!isdigit(static_cast<unsigned char>(name[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void CppWriter::reset()
+{
+	names.clear();
+	bits.clear();
+	usedNames.clear();
+	definitions.clear();
+	inlined.clear();
+}
+
+void CppWriter::analyze(const IrProgram& program)
+{
+	bits = program.variableBits;
+	texts = &program.texts;
+	nameSlots(program);
+	chooseInlined(program);
+	findLabels(program);
+}
+
+void CppWriter::findLabels(const IrProgram& program)
+{
+	// Control falls through to the next block, so only the other
+	// targets need a label
+	labelled.assign(program.blocks.size(), 0);
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		if (!program.blocks[b].isTerminated())
+		{
+			continue;
+		}
+		const IrInstruction& last = program.blocks[b].terminator();
+		int next = static_cast<int>(b) + 1;
+		if (last.opcode == IrOpcode::Jump && last.target != next)
+		{
+			labelled[last.target] = 1;
+		}
+		if (last.opcode == IrOpcode::Branch)
+		{
+			// Written as a jump on the condition to the target, unless
+			// the target is next (then on its negation to the false target)
+			if (last.target == next || last.falseTarget != next)
+			{
+				labelled[last.falseTarget] = 1;
+			}
+			if (last.target != next)
+			{
+				labelled[last.target] = 1;
+			}
+		}
+	}
+}
+
+void CppWriter::nameSlots(const IrProgram& program)
+{
+	for (size_t slot = names.size(); slot < program.variableNames.size(); slot++)
+	{
+		string base = program.variableNames[slot];
+		if (base.empty())
+		{
+			base = "v" + to_string(slot);
+		}
+
+		string name = base;
+		for (int suffix = 1; looksLikeTemporary(name) || usedNames.count(name) != 0; suffix++)
+		{
+			name = base + "_" + to_string(suffix);
+		}
+		usedNames.insert(name);
+		names.push_back(name);
+	}
+}
+
+void CppWriter::chooseInlined(const IrProgram& program)
+{
+	size_t count = static_cast<size_t>(program.temporaryCount);
+	definitions.assign(count, nullptr);
+	inlined.assign(count, 0);
+	useCount.assign(count, 0);
+	use.assign(count, make_pair(-1, -1));
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[b].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const IrInstruction& instruction = instructions[i];
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary)
+				{
+					useCount[operand->value]++;
+					use[operand->value] = make_pair(static_cast<int>(b), static_cast<int>(i));
+				}
+			}
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+			{
+				definitions[instruction.dest.value] = &instruction;
+			}
+		}
+	}
+
+	// What the expression of each inlined temporary reads and does
+	hasInput.assign(count, 0);
+	hasDivide.assign(count, 0);
+
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[b].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const IrInstruction& instruction = instructions[i];
+			if (!instruction.definesValue() || instruction.dest.kind != IrOperand::Temporary)
+			{
+				continue;
+			}
+
+			int temporary = instruction.dest.value;
+			if (useCount[temporary] != 1 || use[temporary].first != static_cast<int>(b)
+				|| use[temporary].second <= static_cast<int>(i))
+			{
+				continue;
+			}
+
+			// The value of a CopyIf is computed in front of it; inside the
+			// ?: compilers would only compute it on one way, with a jump
+			const IrInstruction& user = instructions[use[temporary].second];
+			if (user.opcode == IrOpcode::CopyIf && user.left == instruction.dest)
+			{
+				continue;
+			}
+
+			// Operands are defined before their user, so theirs is known
+			hasInput[temporary] = instruction.opcode == IrOpcode::Input;
+			hasDivide[temporary] = instruction.opcode == IrOpcode::Divide;
+			reads.clear();
+			forEachName(instruction, [&](const IrOperand& operand)
+			{
+				if (operand.kind == IrOperand::Variable)
+				{
+					reads.push_back(operand.value);
+				}
+			});
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary && inlined[operand->value])
+				{
+					hasInput[temporary] |= hasInput[operand->value];
+					hasDivide[temporary] |= hasDivide[operand->value];
+				}
+			}
+
+			bool movable = true;
+			for (int k = static_cast<int>(i) + 1; movable && k < use[temporary].second; k++)
+			{
+				const IrInstruction& between = instructions[k];
+				if (between.definesValue() && between.dest.kind == IrOperand::Variable)
+				{
+					for (int slot : reads)
+					{
+						movable &= slot != between.dest.value;
+					}
+				}
+				if (hasInput[temporary] && between.hasSideEffects())
+				{
+					movable = false;
+				}
+				if (hasDivide[temporary] && between.hasSideEffects() && between.opcode != IrOpcode::Input)
+				{
+					movable = false;
+				}
+			}
+			inlined[temporary] = movable;
+		}
+	}
+}
+
+bool CppWriter::isInlined(const IrInstruction& instruction) const
+{
+	return instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary
+		&& inlined[instruction.dest.value];
+}
+
+bool CppWriter::isStored(int temporary) const
+{
+	return definitions[temporary] != nullptr && !inlined[temporary];
+}
+
+bool CppWriter::readsInput(const IrOperand& operand) const
+{
+	return operand.kind == IrOperand::Temporary && inlined[operand.value] && hasInput[operand.value];
+}
+
+bool CppWriter::mayTrap(const IrOperand& operand) const
+{
+	if (operand.kind != IrOperand::Temporary || !inlined[operand.value])
+	{
+		return false;
+	}
+	const IrInstruction& definition = *definitions[operand.value];
+	if (definition.opcode == IrOpcode::Divide
+		&& (definition.right.kind != IrOperand::Constant || definition.right.value == 0))
+	{
+		return true;
+	}
+	return mayTrap(definition.left) || mayTrap(definition.right);
+}
+
+const char* CppWriter::typeName(const IrOperand& operand) const
+{
+	int width = operand.kind == IrOperand::Variable && static_cast<size_t>(operand.value) < bits.size()
+		? bits[operand.value] : 32;
+	return width == 8 ? "int8_t" : width == 16 ? "int16_t" : "int";
+}
+
+bool CppWriter::needsCstdint(const IrProgram& program)
+{
+	for (unsigned char width : program.variableBits)
+	{
+		if (width < 32)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void CppWriter::appendName(string& out, const IrOperand& operand) const
+{
+	if (operand.kind == IrOperand::Variable)
+	{
+		out += names[operand.value];
+		return;
+	}
+	out += "_t";
+	out += to_string(operand.value);
+}
+
+void CppWriter::appendExpression(string& out, const IrOperand& operand) const
+{
+	if (operand.kind == IrOperand::Constant)
+	{
+		out += to_string(operand.value);
+	}
+	else if (operand.kind == IrOperand::Temporary && inlined[operand.value])
+	{
+		appendValue(out, *definitions[operand.value]);
+	}
+	else
+	{
+		appendName(out, operand);
+	}
+}
+
+void CppWriter::appendValue(string& out, const IrInstruction& instruction) const
+{
+	if (instruction.opcode == IrOpcode::Input)
+	{
+		out += "([]() { int val; cin >> val; return val; })()";
+		return;
+	}
+	if (instruction.opcode == IrOpcode::Copy)
+	{
+		appendExpression(out, instruction.left);
+		return;
+	}
+	if (instruction.opcode == IrOpcode::ShiftRightLogical)
+	{
+		out += "(int)((unsigned)";
+		appendExpression(out, instruction.left);
+		out += " >> ";
+		appendExpression(out, instruction.right);
+		out += ')';
+		return;
+	}
+	if (instruction.opcode == IrOpcode::ShiftLeft)
+	{
+		// Shifting a negative number left is undefined before C++20
+		out += "(int)((unsigned)";
+		appendExpression(out, instruction.left);
+		out += " << ";
+		appendExpression(out, instruction.right);
+		out += ')';
+		return;
+	}
+	if (instruction.opcode == IrOpcode::MultiplyHigh)
+	{
+		out += "(int)(((long long)";
+		appendExpression(out, instruction.left);
+		out += " * ";
+		appendExpression(out, instruction.right);
+		out += ") >> 32)";
+		return;
+	}
+	if (instruction.opcode == IrOpcode::Compare)
+	{
+		appendCondition(out, instruction, false);
+		return;
+	}
+	if (instruction.opcode == IrOpcode::CopyIf)
+	{
+		// Both ways are plain values, so compilers choose with a
+		// conditional move instead of a jump
+		out += '(';
+		appendExpression(out, instruction.right);
+		out += " ? ";
+		appendExpression(out, instruction.left);
+		out += " : ";
+		appendName(out, instruction.dest);
+		out += ')';
+		return;
+	}
+	if (instruction.wraps)
+	{
+		// Unsigned arithmetic wraps around; converting back is modular in
+		// C++20, and in every compiler before it
+		out += "(int)((unsigned)";
+		appendExpression(out, instruction.left);
+		out += ' ';
+		out += IrProgram::opcodeSymbol(instruction.opcode);
+		out += " (unsigned)";
+		appendExpression(out, instruction.right);
+		out += ')';
+		return;
+	}
+	out += '(';
+	appendExpression(out, instruction.left);
+	out += ' ';
+	out += IrProgram::opcodeSymbol(instruction.opcode);
+	out += ' ';
+	appendExpression(out, instruction.right);
+	out += ')';
+}
+
+void CppWriter::appendCondition(string& out, const IrInstruction& branch, bool negated) const
+{
+	out += '(';
+	appendExpression(out, branch.left);
+	out += ' ';
+	out += IrProgram::compareSymbol(negated ? IrProgram::negate(branch.compare) : branch.compare);
+	out += ' ';
+	appendExpression(out, branch.right);
+	out += ')';
+}
+
+void CppWriter::appendStatement(string& out, const IrInstruction& instruction) const
+{
+	if (instruction.opcode == IrOpcode::Print || instruction.opcode == IrOpcode::PrintLine)
+	{
+		// An int8_t is a char to cout, so it is printed as an int
+		IrOperand printed = instruction.left;
+		while (printed.kind == IrOperand::Temporary && inlined[printed.value]
+			&& definitions[printed.value]->opcode == IrOpcode::Copy)
+		{
+			printed = definitions[printed.value]->left;
+		}
+		out += "cout << ";
+		if (printed.kind == IrOperand::Variable && static_cast<size_t>(printed.value) < bits.size()
+			&& bits[printed.value] == 8)
+		{
+			out += "(int)";
+		}
+		appendExpression(out, instruction.left);
+		out += instruction.opcode == IrOpcode::PrintLine ? " << endl;" : ";";
+		return;
+	}
+	if (instruction.opcode == IrOpcode::PrintText)
+	{
+		// One literal of at most 4095 characters each, the least that
+		// compilers have to accept
+		const string& text = (*texts)[instruction.left.value];
+		out += "cout";
+		for (size_t start = 0; start < text.size(); start += 4095)
+		{
+			out += " << \"";
+			for (size_t i = start; i < text.size() && i < start + 4095; i++)
+			{
+				if (text[i] == '\n')
+				{
+					out += "\\n";
+				}
+				else if (text[i] == '"' || text[i] == '\\')
+				{
+					out += '\\';
+					out += text[i];
+				}
+				else
+				{
+					out += text[i];
+				}
+			}
+			out += '"';
+		}
+		// Flushed as the endl of each println would have, so that the text
+		// is not lost if the program then stops with an error
+		out += " << flush;";
+		return;
+	}
+	appendName(out, instruction.dest);
+	out += " = ";
+	appendValue(out, instruction);
+	out += ';';
+}
+
+void CppWriter::writeBlocks(const IrProgram& program, string& out, const string& indent) const
+{
+	size_t start = out.size();
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		const IrBlock& block = program.blocks[b];
+		if (labelled[b])
+		{
+			if (out.size() > start)
+			{
+				out += '\n';
+			}
+			out += indent;
+			out += block.label;
+			out += ":\n";
+		}
+
+		int next = static_cast<int>(b) + 1;
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			if (isInlined(instruction))
+			{
+				continue;
+			}
+			if (instruction.opcode == IrOpcode::Jump && instruction.target == next)
+			{
+				continue;
+			}
+
+			out += indent;
+			switch (instruction.opcode)
+			{
+			case IrOpcode::Jump:
+				out += "goto ";
+				out += program.blocks[instruction.target].label;
+				out += ';';
+				break;
+			case IrOpcode::Branch:
+				// Jump on whichever outcome does not fall through
+				out += "if ";
+				appendCondition(out, instruction, instruction.target == next);
+				out += " goto ";
+				out += program.blocks[instruction.target == next ? instruction.falseTarget : instruction.target].label;
+				out += ';';
+				if (instruction.target != next && instruction.falseTarget != next)
+				{
+					out += '\n';
+					out += indent;
+					out += "goto ";
+					out += program.blocks[instruction.falseTarget].label;
+					out += ';';
+				}
+				break;
+			case IrOpcode::Return:
+				out += "return 0;";
+				break;
+			default:
+				appendStatement(out, instruction);
+				break;
+			}
+			out += '\n';
+		}
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "IR.h"
+#include "NodePool.h"
+
+/**
+ * CppWriter (C++ from three-address code)
+ *
+ * Purpose: The part of emitting C++ that both code generators share:
+ * names for variables and temporaries, and turning instructions back into
+ * nested C++ expressions and statements.
+ *
+ * How it works:
+ * 1. Every variable slot gets a C++ name: its MidLang name, or that name
+ *    with a numeric suffix if another slot already uses it or it looks
+ *    like a temporary (_t0, _t1, ...)
+ * 2. A temporary that is used once, later in the same block, is written
+ *    into the expression that uses it instead of being stored, unless
+ *    that would move it past a store to a variable it reads, move an
+ *    input past another input or output, or move a division past output
+ * 3. The remaining instructions become C++ statements
+ */
+class CppWriter
+{
+	std::vector<std::string> names;		// C++ name by slot
+	std::vector<unsigned char> bits;	// by slot, of the program analyzed last
+	const std::vector<std::string>* texts = nullptr;	// of PrintText, in that program
+	PooledSet<std::string> usedNames;
+
+	// Per program (or fragment), by temporary number
+	std::vector<const IrInstruction*> definitions;
+	std::vector<char> inlined;
+	std::vector<int> useCount;
+	std::vector<std::pair<int, int>> use;	// block and instruction
+	std::vector<char> hasInput;
+	std::vector<char> hasDivide;
+	std::vector<int> reads;
+
+	std::vector<char> labelled;		// by block: jumped to other than by falling through
+
+	void nameSlots(const IrProgram& program);
+	void chooseInlined(const IrProgram& program);
+	void findLabels(const IrProgram& program);
+
+public:
+	/**
+	 * Forgets all names, for a new program.
+	 */
+	void reset();
+
+	/**
+	 * Names the slots that are new in program and decides which of its
+	 * temporaries are inlined. Must be called before writing any of it;
+	 * the program must outlive the calls that write it.
+	 */
+	void analyze(const IrProgram& program);
+
+	const std::string& variableName(int slot) const { return names[slot]; }
+
+	/**
+	 * C++ type of a variable or temporary: int, or int16_t or int8_t for
+	 * a slot with fewer bits (see IrProgram::variableBits).
+	 */
+	const char* typeName(const IrOperand& operand) const;
+
+	/**
+	 * True if a slot of program has a type from <cstdint>.
+	 */
+	static bool needsCstdint(const IrProgram& program);
+
+	/**
+	 * True if the instruction defines an inlined temporary, so it is
+	 * written where the temporary is used rather than on its own.
+	 */
+	bool isInlined(const IrInstruction& instruction) const;
+
+	/**
+	 * True if the temporary is stored, so it needs a declaration.
+	 */
+	bool isStored(int temporary) const;
+
+	/**
+	 * True if the operand is an inlined temporary whose expression reads
+	 * input, so it must be written even where its value is not needed.
+	 */
+	bool readsInput(const IrOperand& operand) const;
+
+	/**
+	 * True if the operand is an inlined temporary whose expression divides
+	 * by anything but a non-zero constant, so it may trap and must be
+	 * written even where its value is not needed (as in
+	 * DeadCodeEliminator::hasSideEffects).
+	 */
+	bool mayTrap(const IrOperand& operand) const;
+
+	// The append methods add C++ text to the end of out
+
+	void appendName(std::string& out, const IrOperand& operand) const;	// variable or stored temporary
+	void appendExpression(std::string& out, const IrOperand& operand) const;
+	void appendValue(std::string& out, const IrInstruction& instruction) const;	// what is stored in dest
+
+	/**
+	 * Condition of a Branch or Compare, "(a < b)", or its negation.
+	 */
+	void appendCondition(std::string& out, const IrInstruction& branch, bool negated = false) const;
+
+	/**
+	 * An assignment or print as a C++ statement, without indentation.
+	 */
+	void appendStatement(std::string& out, const IrInstruction& instruction) const;
+
+	/**
+	 * Appends the blocks of program as statements and gotos, one per line
+	 * with the given indentation. A jump to the next block is left out,
+	 * and only blocks that are still jumped to get a label, after a blank
+	 * line.
+	 */
+	void writeBlocks(const IrProgram& program, std::string& out, const std::string& indent) const;
+
+	/**
+	 * Calls visit with each variable or stored temporary the instruction
+	 * reads or writes, including those read by its inlined operands.
+	 */
+	template <typename Visitor>
+	void forEachName(const IrInstruction& instruction, Visitor visit) const
+	{
+		if (instruction.dest.kind == IrOperand::Variable
+			|| (instruction.dest.kind == IrOperand::Temporary && !inlined[instruction.dest.value]))
+		{
+			visit(instruction.dest);
+		}
+		for (const IrOperand* operand : { &instruction.left, &instruction.right })
+		{
+			if (operand->kind == IrOperand::Temporary && inlined[operand->value])
+			{
+				forEachName(*definitions[operand->value], visit);
+			}
+			else if (operand->kind == IrOperand::Variable || operand->kind == IrOperand::Temporary)
+			{
+				visit(*operand);
+			}
+		}
+	}
+};
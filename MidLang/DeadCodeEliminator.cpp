@@ -0,0 +1,398 @@
+#include "DeadCodeEliminator.h"
+#include "AllocProfiler.h"
+#include "ConstantFolder.h"
+
+using namespace std;
+
+namespace
+{
+	int storedSlot(const Statement* statement)
+	{
+		if (const VarDeclarationStatement* varDecl = dynamic_cast<const VarDeclarationStatement*>(statement))
+		{
+			return varDecl->slot;
+		}
+		if (const AssignmentStatement* assignment = dynamic_cast<const AssignmentStatement*>(statement))
+		{
+			return assignment->slot;
+		}
+		return -1;
+	}
+
+	const Expression* storedValue(const Statement* statement)
+	{
+		if (const VarDeclarationStatement* varDecl = dynamic_cast<const VarDeclarationStatement*>(statement))
+		{
+			return varDecl->expression;
+		}
+		if (const AssignmentStatement* assignment = dynamic_cast<const AssignmentStatement*>(statement))
+		{
+			return assignment->expression;
+		}
+		return nullptr;
+	}
+
+	bool readsSlot(const Expression* expression, int slot)
+	{
+		if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+		{
+			return varRef->slot == slot;
+		}
+		if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+		{
+			return readsSlot(binExpr->left, slot) || readsSlot(binExpr->right, slot);
+		}
+		if (const BooleanExpression* boolExpr = dynamic_cast<const BooleanExpression*>(expression))
+		{
+			return readsSlot(boolExpr->left, slot) || readsSlot(boolExpr->right, slot);
+		}
+		return false;
+	}
+
+	void deleteAll(vector<Statement*>& statements)
+	{
+		for (auto* statement : statements)
+		{
+			delete statement;
+		}
+		statements.clear();
+	}
+}
+
+DeadCodeEliminator::DeadCodeEliminator()
+	: changed(false), removedBranchCount(0), removedStatementCount(0)
+{
+}
+
+void DeadCodeEliminator::reset()
+{
+	removedBranchCount = 0;
+	removedStatementCount = 0;
+}
+
+bool DeadCodeEliminator::hasSideEffects(const Expression* expression)
+{
+	if (dynamic_cast<const InputIntExpression*>(expression) != nullptr)
+	{
+		return true;
+	}
+	if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+	{
+		// A division traps unless its divisor is known to be non-zero,
+		// so removing it would change the program
+		if (binExpr->op == "/")
+		{
+			const IntegerLiteral* divisor = dynamic_cast<const IntegerLiteral*>(binExpr->right);
+			if (divisor == nullptr || divisor->value == 0)
+			{
+				return true;
+			}
+		}
+		return hasSideEffects(binExpr->left) || hasSideEffects(binExpr->right);
+	}
+	if (const BooleanExpression* boolExpr = dynamic_cast<const BooleanExpression*>(expression))
+	{
+		return hasSideEffects(boolExpr->left) || hasSideEffects(boolExpr->right);
+	}
+	return false;
+}
+
+void DeadCodeEliminator::run(ProgramNode* program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	size_t slotCount = program->slotNames->size();
+
+	do
+	{
+		changed = false;
+		prune(program->statements, true);
+
+		live.assign(slotCount, false);
+		pinned.assign(slotCount, false);
+		storedValues.resize(slotCount);
+		for (auto& values : storedValues)
+		{
+			values.clear();
+		}
+
+		collectStores(program->statements);
+		while (!worklist.empty())
+		{
+			int slot = worklist.back();
+			worklist.pop_back();
+			for (const Expression* value : storedValues[slot])
+			{
+				markLive(value);
+			}
+		}
+
+		removeDeadStores(program->statements);
+	} while (changed);
+}
+
+Statement* DeadCodeEliminator::runTopLevel(Statement* statement)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	// A top-level if is never spliced here: its declarations could clash
+	// with top-level declarations that have not been parsed yet
+	vector<Statement*> statements = StatementListPool::take();
+	statements.push_back(statement);
+	prune(statements, false);
+	Statement* pruned = statements.empty() ? nullptr : statements[0];
+	StatementListPool::release(statements);
+	return pruned;
+}
+
+void DeadCodeEliminator::prune(vector<Statement*>& statements, bool canSplice)
+{
+	// The names of this block follow those of the enclosing blocks
+	size_t firstName = declaredNames.size();
+	if (canSplice)
+	{
+		for (auto* statement : statements)
+		{
+			if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+			{
+				declaredNames.push_back(&varDecl->variableName);
+			}
+		}
+	}
+
+	vector<Statement*> result = StatementListPool::take();
+	result.reserve(statements.size());
+
+	for (auto* statement : statements)
+	{
+		if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+		{
+			prune(ifStmt->thenStatements, true);
+			prune(ifStmt->elseStatements, true);
+
+			bool taken;
+			if (ConstantFolder::decide(ifStmt->condition, taken))
+			{
+				vector<Statement*>& kept = taken ? ifStmt->thenStatements : ifStmt->elseStatements;
+				vector<Statement*>& dropped = taken ? ifStmt->elseStatements : ifStmt->thenStatements;
+				bool removed = !dropped.empty();
+				deleteAll(dropped);
+
+				if (canSplice && canSpliceInto(kept, firstName))
+				{
+					for (auto* keptStatement : kept)
+					{
+						if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(keptStatement))
+						{
+							declaredNames.push_back(&varDecl->variableName);
+						}
+						result.push_back(keptStatement);
+					}
+					kept.clear();
+					delete ifStmt;
+					removed = true;
+				}
+				else
+				{
+					// The if stays only to scope the declarations of the taken branch
+					result.push_back(ifStmt);
+				}
+
+				if (removed)
+				{
+					removedBranchCount++;
+					changed = true;
+				}
+				continue;
+			}
+
+			if (ifStmt->thenStatements.empty() && ifStmt->elseStatements.empty() && !hasSideEffects(ifStmt->condition))
+			{
+				delete ifStmt;
+				removedBranchCount++;
+				changed = true;
+				continue;
+			}
+		}
+		else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+		{
+			bool taken;
+			if (ConstantFolder::decide(whileStmt->condition, taken) && !taken)
+			{
+				delete whileStmt;
+				removedBranchCount++;
+				changed = true;
+				continue;
+			}
+			prune(whileStmt->bodyStatements, true);
+		}
+
+		result.push_back(statement);
+	}
+
+	declaredNames.resize(firstName);
+	statements.swap(result);
+	StatementListPool::release(result);
+	mergeStores(statements);
+}
+
+bool DeadCodeEliminator::canSpliceInto(const vector<Statement*>& branch, size_t firstName)
+{
+	spliceNames.clear();
+	for (size_t i = firstName; i < declaredNames.size(); i++)
+	{
+		spliceNames.insert(*declaredNames[i]);
+	}
+	for (auto* statement : branch)
+	{
+		if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+		{
+			if (spliceNames.count(varDecl->variableName) != 0)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void DeadCodeEliminator::mergeStores(vector<Statement*>& statements)
+{
+	vector<Statement*> result = StatementListPool::take();
+	result.reserve(statements.size());
+
+	for (auto* statement : statements)
+	{
+		AssignmentStatement* assignment = dynamic_cast<AssignmentStatement*>(statement);
+		Statement* previous = result.empty() ? nullptr : result.back();
+
+		// x = a; x = b;  (b does not read x)  ->  x = b;
+		if (assignment != nullptr && previous != nullptr && assignment->slot >= 0
+			&& storedSlot(previous) == assignment->slot
+			&& !hasSideEffects(storedValue(previous))
+			&& !readsSlot(assignment->expression, assignment->slot))
+		{
+			if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(previous))
+			{
+				// var x = a; x = b;  ->  var x = b;
+				delete varDecl->expression;
+				varDecl->expression = assignment->expression;
+				assignment->expression = nullptr;
+				delete assignment;
+			}
+			else
+			{
+				delete previous;
+				result.back() = assignment;
+			}
+			removedStatementCount++;
+			changed = true;
+			continue;
+		}
+
+		result.push_back(statement);
+	}
+
+	statements.swap(result);
+	StatementListPool::release(result);
+}
+
+void DeadCodeEliminator::collectStores(const vector<Statement*>& statements)
+{
+	for (auto* statement : statements)
+	{
+		int slot = storedSlot(statement);
+		if (slot >= 0)
+		{
+			const Expression* value = storedValue(statement);
+			if (hasSideEffects(value))
+			{
+				// The statement stays, so everything it reads is needed
+				pinned[slot] = true;
+				markLive(value);
+			}
+			else
+			{
+				storedValues[slot].push_back(value);
+			}
+		}
+		else if (PrintStatement* print = dynamic_cast<PrintStatement*>(statement))
+		{
+			markLive(print->expression);
+		}
+		else if (PrintLineStatement* println = dynamic_cast<PrintLineStatement*>(statement))
+		{
+			markLive(println->expression);
+		}
+		else if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+		{
+			markLive(ifStmt->condition);
+			collectStores(ifStmt->thenStatements);
+			collectStores(ifStmt->elseStatements);
+		}
+		else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+		{
+			markLive(whileStmt->condition);
+			collectStores(whileStmt->bodyStatements);
+		}
+	}
+}
+
+void DeadCodeEliminator::markLive(const Expression* expression)
+{
+	if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+	{
+		if (varRef->slot >= 0 && !live[varRef->slot])
+		{
+			live[varRef->slot] = true;
+			worklist.push_back(varRef->slot);
+		}
+	}
+	else if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+	{
+		markLive(binExpr->left);
+		markLive(binExpr->right);
+	}
+	else if (const BooleanExpression* boolExpr = dynamic_cast<const BooleanExpression*>(expression))
+	{
+		markLive(boolExpr->left);
+		markLive(boolExpr->right);
+	}
+}
+
+void DeadCodeEliminator::removeDeadStores(vector<Statement*>& statements)
+{
+	size_t kept = 0;
+	for (auto* statement : statements)
+	{
+		if (isDeadStore(statement))
+		{
+			delete statement;
+			removedStatementCount++;
+			changed = true;
+			continue;
+		}
+
+		if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+		{
+			removeDeadStores(ifStmt->thenStatements);
+			removeDeadStores(ifStmt->elseStatements);
+		}
+		else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+		{
+			removeDeadStores(whileStmt->bodyStatements);
+		}
+		statements[kept++] = statement;
+	}
+	statements.resize(kept);
+}
+
+bool DeadCodeEliminator::isDeadStore(const Statement* statement) const
+{
+	int slot = storedSlot(statement);
+	if (slot < 0 || live[slot] || hasSideEffects(storedValue(statement)))
+	{
+		return false;
+	}
+
+	// A later store with side effects still needs the declaration
+	return !pinned[slot] || dynamic_cast<const VarDeclarationStatement*>(statement) == nullptr;
+}
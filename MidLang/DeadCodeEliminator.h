@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AST.h"
+
+/**
+ * DeadCodeEliminator (Optimization pass)
+ *
+ * Purpose: Removes code that can never run, and stores whose value is
+ * never used.
+ *
+ * How it works:
+ * 1. An if whose condition is a constant (after ConstantFolder) is replaced
+ *    by the statements of the taken branch; a while whose condition is
+ *    false on entry is removed, as is an if with two empty branches
+ * 2. An assignment directly followed by another assignment to the same
+ *    variable is dropped; a declaration directly followed by an
+ *    assignment takes over its value
+ * 3. Variables are marked live starting from what is printed, branched
+ *    on or has side effects, following the values stored into each live
+ *    variable; declarations and assignments of variables that are not
+ *    live are removed
+ * 4. Steps 1-3 repeat until nothing changes
+ *
+ * inputInt() and a division by anything but a non-zero constant (which may
+ * trap) are side effects: a statement that contains one always stays, even
+ * if the value it stores is never read. The pass needs the slots
+ * assigned by Resolver.
+ */
+class DeadCodeEliminator
+{
+	std::vector<bool> live;			// by slot
+	std::vector<bool> pinned;		// slots with a store that must stay
+	std::vector<std::vector<const Expression*>> storedValues;	// by slot
+	std::vector<int> worklist;
+	std::vector<const std::string*> declaredNames;	// by the blocks being pruned, innermost last
+	PooledSet<std::string> spliceNames;
+	bool changed;
+
+	void prune(vector<Statement*>& statements, bool canSplice);
+	bool canSpliceInto(const vector<Statement*>& branch, size_t firstName);	// with the names from firstName on
+	void mergeStores(vector<Statement*>& statements);
+	void collectStores(const vector<Statement*>& statements);
+	void markLive(const Expression* expression);
+	void removeDeadStores(vector<Statement*>& statements);
+	bool isDeadStore(const Statement* statement) const;
+
+public:
+	// Statistics since the last reset()
+	size_t removedBranchCount;		// if/while branches that could never run
+	size_t removedStatementCount;	// dead declarations and assignments
+
+	DeadCodeEliminator();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Removes dead code from a whole resolved program.
+	 */
+	void run(ProgramNode* program);
+
+	/**
+	 * Prunes one top-level statement of a streamed program and returns the
+	 * statement to generate, or nullptr if it was removed (and deleted).
+	 * Stores are not removed, since later statements are not known yet.
+	 */
+	Statement* runTopLevel(Statement* statement);
+
+	/**
+	 * True if evaluating the expression reads input or may divide by zero.
+	 */
+	static bool hasSideEffects(const Expression* expression);
+};
@@ -0,0 +1,299 @@
+#include "Driver.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AllocProfiler.h"
+
+using namespace std;
+
+int runDriver(int argc, char* argv[], BackendKind backend)
+{
+	bool assembly = backend == BackendKind::Assembly;
+	const char* name = assembly ? "transpiler_asm" : "transpiler";
+	string sourceFile;
+	string outputFile;
+	bool streaming = false;
+	bool pipelined = false;
+	bool printIr = false;
+	double allocationBudget = 0;
+	FusionSettings fusion;
+	EvaluationSettings evaluation;
+	UnrollSettings unrolling;
+	ReductionSettings reduction;
+	SelectSettings selection;
+	OptimizationLevel level = OptimizationLevel::Full;
+	vector<string> disabledPasses;
+	vector<string> printAfter;
+	bool timePasses = false;
+	bool printStatistics = false;
+
+	vector<string> arguments;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--stream")
+		{
+			streaming = true;
+		}
+		else if (arg == "--pipeline")
+		{
+			streaming = true;
+			pipelined = true;
+		}
+		else if (arg == "--print-ir")
+		{
+			printIr = true;
+		}
+		else if (arg.compare(0, 15, "--alloc-budget=") == 0)
+		{
+			allocationBudget = atof(arg.c_str() + 15);
+		}
+		else if (arg.compare(0, 16, "--fusion-budget=") == 0)
+		{
+			fusion.maxVariables = static_cast<size_t>(atoi(arg.c_str() + 16));
+		}
+		else if (arg.compare(0, 14, "--eval-budget=") == 0)
+		{
+			evaluation.stepBudget = static_cast<size_t>(atoi(arg.c_str() + 14));
+		}
+		else if (arg.compare(0, 16, "--unroll-budget=") == 0)
+		{
+			unrolling.fullBudget = static_cast<size_t>(atoi(arg.c_str() + 16));
+		}
+		else if (arg.compare(0, 16, "--unroll-factor=") == 0)
+		{
+			unrolling.factor = atoi(arg.c_str() + 16);
+		}
+		else if (arg.compare(0, 25, "--reduction-accumulators=") == 0)
+		{
+			reduction.accumulators = atoi(arg.c_str() + 25);
+		}
+		else if (arg.compare(0, 16, "--select-budget=") == 0)
+		{
+			selection.budget = static_cast<size_t>(atoi(arg.c_str() + 16));
+		}
+		else if (PassManager::parseLevel(arg, level))
+		{
+			// -O0, -O1, -O2 or -Os, already stored in level
+		}
+		else if (arg.compare(0, 15, "--disable-pass=") == 0)
+		{
+			disabledPasses.push_back(arg.substr(15));
+		}
+		else if (arg.compare(0, 14, "--print-after=") == 0)
+		{
+			printAfter.push_back(arg.substr(14));
+		}
+		else if (arg == "--time-passes")
+		{
+			timePasses = true;
+		}
+		else if (arg == "--stats")
+		{
+			printStatistics = true;
+		}
+		else
+		{
+			arguments.push_back(arg);
+		}
+	}
+
+	if (arguments.empty())
+	{
+		cout << "Usage: " << name << " [-O0 | -O1 | -O2 | -Os] [--stream | --pipeline] [--print-ir] <input.mid> [output.cpp]"
+			<< endl;
+		cout << "Example: " << name << " program.mid program.cpp" << endl;
+		if (assembly)
+		{
+			cout << endl;
+			cout << "This transpiler generates C++ code using goto statements" << endl;
+			cout << "and labels, treating C++ as an assembly language replacement." << endl;
+		}
+		cout << endl;
+		cout << "Use '-' to read from stdin or write to stdout." << endl;
+		cout << "--stream translates one statement at a time with bounded memory." << endl;
+		cout << "--pipeline does the same with each stage on its own thread." << endl;
+		cout << "--print-ir prints the intermediate code the C++ is generated from." << endl;
+		cout << "--alloc-budget=N fails if the compiler makes more than N allocations" << endl;
+		cout << "per token (needs a build with -DMIDLANG_ALLOC_PROFILE=ON)." << endl;
+		cout << "--fusion-budget=N fuses loops into loops of up to N variables (0: never)." << endl;
+		cout << "--eval-budget=N runs up to N IR instructions while compiling (0: never)." << endl;
+		cout << "--unroll-budget=N unrolls loops completely up to N instructions (0: never)." << endl;
+		cout << "--unroll-factor=K repeats the body K times in longer loops (1: never)." << endl;
+		cout << "--reduction-accumulators=K splits sums and the like into K accumulators (1: never)." << endl;
+		cout << "--select-budget=N turns ifs doing up to N operations into selects (0: never)." << endl;
+		cout << "-O0 turns optimization off, -O1 skips the loop passes, -O2 (the default)" << endl;
+		cout << "runs every pass and -Os every pass except the ones that copy code, run it or" << endl;
+		cout << "replace one operation by several." << endl;
+		cout << "--disable-pass=NAME leaves one pass out, such as loop-unroller." << endl;
+		cout << "--print-after=NAME prints the intermediate code after an IR pass." << endl;
+		cout << "--time-passes prints the runs, time and changes of each pass." << endl;
+		cout << "--stats prints what each pass changed." << endl;
+		return 1;
+	}
+
+	if (allocationBudget > 0 && !AllocProfiler::enabled())
+	{
+		cerr << "Error: --alloc-budget needs a build with -DMIDLANG_ALLOC_PROFILE=ON" << endl;
+		return 1;
+	}
+	if (allocationBudget > 0 && streaming && !pipelined)
+	{
+		cerr << "Error: --alloc-budget is not available with --stream (tokens are not counted)" << endl;
+		return 1;
+	}
+
+	sourceFile = arguments[0];
+	
+	if (arguments.size() >= 2)
+	{
+		outputFile = arguments[1];
+	}
+	else if (sourceFile == "-")
+	{
+		outputFile = "-";
+	}
+	else
+	{
+		// Default output: same name with .cpp extension
+		outputFile = sourceFile;
+		size_t lastDot = outputFile.find_last_of('.');
+		if (lastDot != string::npos)
+		{
+			outputFile = outputFile.substr(0, lastDot) + ".cpp";
+		}
+		else
+		{
+			outputFile += ".cpp";
+		}
+	}
+
+	// Progress messages must not mix with generated code on stdout
+	ostream& log = (outputFile == "-") ? cerr : cout;
+
+	ifstream file;
+	istream* input = &cin;
+	if (sourceFile != "-")
+	{
+		file.open(sourceFile);
+		if (!file.is_open())
+		{
+			cerr << "Error: File not found: " << sourceFile << endl;
+			return 1;
+		}
+		input = &file;
+	}
+
+	try
+	{
+		Compiler compiler(backend);
+		log << "=== Transpiling" << (assembly ? " (Assembly-style)" : "") << ": " << sourceFile << " ===" << endl;
+		if (printIr)
+		{
+			compiler.irListing = &log;
+		}
+		compiler.fusion = fusion;
+		compiler.evaluation = evaluation;
+		compiler.unrolling = unrolling;
+		compiler.reduction = reduction;
+		compiler.selection = selection;
+		compiler.passes.level = level;
+		compiler.passes.disabledPasses = disabledPasses;
+		compiler.passes.printAfter = printAfter;
+		compiler.passes.listing = &log;
+
+		// Streaming modes write while they read, so open the output first
+		ofstream outFile;
+		if (streaming && outputFile != "-")
+		{
+			outFile.open(outputFile);
+			if (!outFile.is_open())
+			{
+				cerr << "Error: Cannot create output file: " << outputFile << endl;
+				return 1;
+			}
+		}
+		ostream& output = outputFile == "-" ? cout : outFile;
+		AllocProfiler::reset();
+
+		if (pipelined)
+		{
+			log << "Pipelining: Lexer, parser and generator on separate threads..." << endl;
+			compiler.compilePipelined(*input, output, &log);
+			log << "Streamed " << compiler.statementCount << " statement(s) from "
+				<< compiler.tokenCount << " tokens" << endl;
+		}
+		else if (streaming)
+		{
+			log << "Streaming: Lexing, parsing and generating one statement at a time..." << endl;
+			compiler.compileStreaming(*input, output);
+			log << "Streamed " << compiler.statementCount << " statement(s)" << endl;
+		}
+		else
+		{
+			// Read source code
+			stringstream buffer;
+			buffer << input->rdbuf();
+			string sourceCode = buffer.str();
+			file.close();
+
+			log << "Compiling: Lexical analysis, parsing and code generation"
+				<< (assembly ? " (Assembly-style)" : "") << "..." << endl;
+			stringstream generated;
+			compiler.compile(sourceCode, generated);
+			log << "Generated " << compiler.tokenCount << " tokens" << endl;
+			log << "Parsed " << compiler.statementCount << " statement(s)" << endl;
+			log << "Resolved " << compiler.slotCount << " variable slot(s)" << endl;
+
+			if (outputFile != "-")
+			{
+				outFile.open(outputFile);
+				if (!outFile.is_open())
+				{
+					cerr << "Error: Cannot create output file: " << outputFile << endl;
+					return 1;
+				}
+			}
+			output << generated.rdbuf();
+		}
+
+		output.flush();
+		if (printStatistics)
+		{
+			compiler.passes.printStatistics(log);
+		}
+		if (timePasses)
+		{
+			compiler.passes.report(log);
+		}
+
+		if (AllocProfiler::enabled())
+		{
+			AllocProfiler::report(log, compiler.tokenCount);
+		}
+		if (allocationBudget > 0)
+		{
+			double perToken = AllocProfiler::allocationsPerToken(compiler.tokenCount);
+			if (perToken > allocationBudget)
+			{
+				cerr << "Error: " << perToken << " allocations per token exceeds the budget of "
+					<< allocationBudget << endl;
+				return 1;
+			}
+		}
+
+		log << "Generated " << (assembly ? "assembly-style " : "") << "C++ code: " << outputFile << endl;
+		log << "=== Transpilation completed successfully ===" << endl;
+	}
+	catch (const exception& ex)
+	{
+		cerr << "Error: " << ex.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Compiler.h"
+
+/**
+ * Driver (Command-line front end)
+ *
+ * Purpose: The command line shared by the transpiler and transpiler_asm
+ * executables, which only differ in the code generator they ask for.
+ *
+ * The compilation it runs:
+ * 1. Reads MidLang source code
+ * 2. Tokenizes it (Lexer)
+ * 3. Parses it into an AST (Parser)
+ * 4. Checks that variables are declared before use (Resolver)
+ * 5. Folds and propagates constants (ConstantFolder)
+ * 6. Removes dead code (DeadCodeEliminator)
+ * 7. Merges adjacent loops that count through the same values (LoopFuser)
+ * 8. Lowers the AST to three-address code (IrBuilder)
+ * 9. Runs the start of the program that reads no input while compiling (PartialEvaluator)
+ * 10. Groups constants and removes identities such as x + 0 and x - x (AlgebraicSimplifier)
+ * 11. Computes repeated expressions once (ValueNumbering)
+ * 12. Hoists loop-invariant expressions out of loops (LoopInvariantMotion)
+ * 13. Computes the results of counting loops directly (LoopCollapser)
+ * 14. Decides comparisons and narrows variables from value ranges (RangeOptimizer)
+ * 15. Unrolls loops with a known number of iterations (LoopUnroller)
+ * 16. Gives sums, products, minimums and maximums in loops several accumulators (ReductionSplitter)
+ * 17. Replaces multiplications and divisions by constants (StrengthReducer)
+ * 18. Assembly style only: threads jumps, rotates loops, merges blocks and
+ *     orders them for fall-through (BlockOptimizer)
+ * 19. Shares variable slots between variables that are not live together (SlotAllocator)
+ * 20. Turns small ifs that choose what to store into branchless selects (IfConverter)
+ * 21. Generates structured C++ code (CodeGenerator) or assembly-style C++
+ *     code with gotos and labels (AssemblyCodeGenerator)
+ *
+ * Which optimization passes run depends on -O0, -O1, -O2 (the default) or
+ * -Os, and --disable-pass.
+ */
+
+/**
+ * Runs the command line given to main() and returns its exit code.
+ */
+int runDriver(int argc, char* argv[], BackendKind backend);
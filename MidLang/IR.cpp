@@ -0,0 +1,471 @@
+#include "IR.h"
+#include "ControlFlowGraph.h"
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+	void printOperand(ostream& out, const IrOperand& operand, const IrProgram& program)
+	{
+		switch (operand.kind)
+		{
+		case IrOperand::Constant:
+			out << operand.value;
+			break;
+		case IrOperand::Variable:
+			if (operand.value >= 0 && static_cast<size_t>(operand.value) < program.variableNames.size())
+			{
+				out << program.variableNames[operand.value];
+			}
+			else
+			{
+				out << "?";
+			}
+			out << "#" << operand.value;
+			break;
+		case IrOperand::Temporary:
+			out << "t" << operand.value;
+			break;
+		case IrOperand::None:
+			out << "_";
+			break;
+		}
+	}
+
+	string blockName(const IrProgram& program, int index)
+	{
+		if (index >= 0 && static_cast<size_t>(index) < program.blocks.size())
+		{
+			return program.blocks[index].label;
+		}
+		return "<" + to_string(index) + ">";
+	}
+}
+
+bool IrInstruction::isTerminator() const
+{
+	return opcode == IrOpcode::Jump || opcode == IrOpcode::Branch || opcode == IrOpcode::Return;
+}
+
+bool IrInstruction::definesValue() const
+{
+	return opcode == IrOpcode::Copy || opcode == IrOpcode::Input || IrProgram::isArithmetic(opcode)
+		|| opcode == IrOpcode::Compare || opcode == IrOpcode::CopyIf;
+}
+
+bool IrInstruction::hasSideEffects() const
+{
+	return opcode == IrOpcode::Input || opcode == IrOpcode::Print || opcode == IrOpcode::PrintLine
+		|| opcode == IrOpcode::PrintText;
+}
+
+IrProgram::IrProgram()
+	: temporaryCount(0), fragment(false)
+{
+}
+
+void IrProgram::clearBlocks()
+{
+	for (IrBlock& block : blocks)
+	{
+		block.instructions.clear();
+		spareBlocks.push_back(move(block));
+	}
+	temporaryCount = 0;
+	blocks.clear();
+	texts.clear();
+}
+
+void IrProgram::clear()
+{
+	clearBlocks();
+	variableNames.clear();
+	variableBits.clear();
+	fragment = false;
+}
+
+int IrProgram::addBlock(const string& label, const string& suffix)
+{
+	// label may be that of a block, which adding one can move
+	newLabel.assign(label).append(suffix);
+	if (spareBlocks.empty())
+	{
+		blocks.emplace_back(string());
+	}
+	else
+	{
+		blocks.push_back(move(spareBlocks.back()));
+		spareBlocks.pop_back();
+	}
+	blocks.back().label.swap(newLabel);
+	return static_cast<int>(blocks.size()) - 1;
+}
+
+void IrProgram::reorderBlocks(const vector<int>& order)
+{
+	newIndex.assign(blocks.size(), -1);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		newIndex[order[i]] = static_cast<int>(i);
+	}
+
+	reordered.clear();
+	for (int block : order)
+	{
+		reordered.push_back(move(blocks[block]));
+		IrBlock& moved = reordered.back();
+		if (moved.isTerminated())
+		{
+			IrInstruction& last = moved.instructions.back();
+			if (last.opcode == IrOpcode::Jump || last.opcode == IrOpcode::Branch)
+			{
+				last.target = newIndex[last.target];
+			}
+			if (last.opcode == IrOpcode::Branch)
+			{
+				last.falseTarget = newIndex[last.falseTarget];
+			}
+		}
+	}
+	for (size_t block = 0; block < blocks.size(); block++)
+	{
+		if (newIndex[block] < 0)
+		{
+			blocks[block].instructions.clear();
+			spareBlocks.push_back(move(blocks[block]));
+		}
+	}
+	blocks.swap(reordered);
+	reordered.clear();
+}
+
+const char* IrProgram::opcodeSymbol(IrOpcode opcode)
+{
+	switch (opcode)
+	{
+	case IrOpcode::Add: return "+";
+	case IrOpcode::Subtract: return "-";
+	case IrOpcode::Multiply: return "*";
+	case IrOpcode::Divide: return "/";
+	case IrOpcode::ShiftLeft: return "<<";
+	case IrOpcode::ShiftRight: return ">>";
+	case IrOpcode::ShiftRightLogical: return ">>>";
+	case IrOpcode::MultiplyHigh: return "*hi";
+	default: return "?";
+	}
+}
+
+const char* IrProgram::compareSymbol(IrCompare compare)
+{
+	switch (compare)
+	{
+	case IrCompare::Equal: return "==";
+	case IrCompare::NotEqual: return "!=";
+	case IrCompare::Less: return "<";
+	case IrCompare::Greater: return ">";
+	case IrCompare::LessEqual: return "<=";
+	default: return ">=";
+	}
+}
+
+bool IrProgram::isArithmetic(IrOpcode opcode)
+{
+	switch (opcode)
+	{
+	case IrOpcode::Add:
+	case IrOpcode::Subtract:
+	case IrOpcode::Multiply:
+	case IrOpcode::Divide:
+	case IrOpcode::ShiftLeft:
+	case IrOpcode::ShiftRight:
+	case IrOpcode::ShiftRightLogical:
+	case IrOpcode::MultiplyHigh:
+		return true;
+	default:
+		return false;
+	}
+}
+
+IrCompare IrProgram::negate(IrCompare compare)
+{
+	switch (compare)
+	{
+	case IrCompare::Equal: return IrCompare::NotEqual;
+	case IrCompare::NotEqual: return IrCompare::Equal;
+	case IrCompare::Less: return IrCompare::GreaterEqual;
+	case IrCompare::Greater: return IrCompare::LessEqual;
+	case IrCompare::LessEqual: return IrCompare::Greater;
+	default: return IrCompare::Less;
+	}
+}
+
+void IrProgram::print(ostream& out) const
+{
+	for (size_t slot = 0; slot < variableBits.size(); slot++)
+	{
+		if (variableBits[slot] < 32)
+		{
+			out << "int" << static_cast<int>(variableBits[slot]) << "_t ";
+			printOperand(out, IrOperand::variable(static_cast<int>(slot)), *this);
+			out << endl;
+		}
+	}
+	for (const IrBlock& block : blocks)
+	{
+		out << block.label << ":" << endl;
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			out << "    ";
+			switch (instruction.opcode)
+			{
+			case IrOpcode::Copy:
+				printOperand(out, instruction.dest, *this);
+				out << " = ";
+				printOperand(out, instruction.left, *this);
+				break;
+			case IrOpcode::Add:
+			case IrOpcode::Subtract:
+			case IrOpcode::Multiply:
+			case IrOpcode::Divide:
+			case IrOpcode::ShiftLeft:
+			case IrOpcode::ShiftRight:
+			case IrOpcode::ShiftRightLogical:
+			case IrOpcode::MultiplyHigh:
+				printOperand(out, instruction.dest, *this);
+				out << " = ";
+				printOperand(out, instruction.left, *this);
+				out << " " << opcodeSymbol(instruction.opcode) << (instruction.wraps ? "% " : " ");
+				printOperand(out, instruction.right, *this);
+				break;
+			case IrOpcode::Compare:
+				printOperand(out, instruction.dest, *this);
+				out << " = ";
+				printOperand(out, instruction.left, *this);
+				out << " " << compareSymbol(instruction.compare) << " ";
+				printOperand(out, instruction.right, *this);
+				break;
+			case IrOpcode::CopyIf:
+				printOperand(out, instruction.dest, *this);
+				out << " = ";
+				printOperand(out, instruction.left, *this);
+				out << " if ";
+				printOperand(out, instruction.right, *this);
+				break;
+			case IrOpcode::Input:
+				printOperand(out, instruction.dest, *this);
+				out << " = input";
+				break;
+			case IrOpcode::Print:
+			case IrOpcode::PrintLine:
+				out << (instruction.opcode == IrOpcode::Print ? "print " : "println ");
+				printOperand(out, instruction.left, *this);
+				break;
+			case IrOpcode::PrintText:
+				out << "print \"";
+				for (char c : texts[instruction.left.value])
+				{
+					if (c == '\n')
+					{
+						out << "\\n";
+					}
+					else
+					{
+						out << c;
+					}
+				}
+				out << '"';
+				break;
+			case IrOpcode::Jump:
+				out << "goto " << blockName(*this, instruction.target);
+				break;
+			case IrOpcode::Branch:
+				out << "if ";
+				printOperand(out, instruction.left, *this);
+				out << " " << compareSymbol(instruction.compare) << " ";
+				printOperand(out, instruction.right, *this);
+				out << " goto " << blockName(*this, instruction.target)
+					<< " else goto " << blockName(*this, instruction.falseTarget);
+				break;
+			case IrOpcode::Return:
+				out << "return";
+				break;
+			}
+			out << endl;
+		}
+	}
+}
+
+void IrProgram::verify() const
+{
+	auto fail = [this](size_t block, size_t index, const string& message)
+	{
+		stringstream ss;
+		ss << "Invalid IR in block " << block;
+		if (block < blocks.size())
+		{
+			ss << " (" << blocks[block].label << ")";
+		}
+		ss << ", instruction " << index << ": " << message;
+		throw logic_error(ss.str());
+	};
+
+	auto checkOperand = [&](size_t block, size_t index, const IrOperand& operand, bool required, const char* role)
+	{
+		if (operand.kind == IrOperand::None)
+		{
+			if (required)
+			{
+				fail(block, index, string("missing ") + role);
+			}
+			return;
+		}
+		if (!required)
+		{
+			fail(block, index, string("unexpected ") + role);
+		}
+		if (operand.kind == IrOperand::Variable
+			&& (operand.value < 0 || static_cast<size_t>(operand.value) >= variableNames.size()))
+		{
+			fail(block, index, string("unknown variable slot in ") + role);
+		}
+		if (operand.kind == IrOperand::Temporary && (operand.value < 0 || operand.value >= temporaryCount))
+		{
+			fail(block, index, string("unknown temporary in ") + role);
+		}
+	};
+
+	if (blocks.empty())
+	{
+		throw logic_error("Invalid IR: program has no blocks");
+	}
+	if (variableBits.size() > variableNames.size())
+	{
+		throw logic_error("Invalid IR: more variable widths than variables");
+	}
+	for (unsigned char bits : variableBits)
+	{
+		if (bits != 8 && bits != 16 && bits != 32)
+		{
+			throw logic_error("Invalid IR: variable width of " + to_string(bits) + " bits");
+		}
+	}
+
+	// Where each temporary is defined: block and instruction index
+	vector<pair<int, int>> definitions(temporaryCount, make_pair(-1, -1));
+
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		const vector<IrInstruction>& instructions = blocks[b].instructions;
+		bool open = fragment && b + 1 == blocks.size();
+		if (!open && !blocks[b].isTerminated())
+		{
+			fail(b, instructions.size(), "block does not end in a terminator");
+		}
+
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const IrInstruction& instruction = instructions[i];
+			bool last = i + 1 == instructions.size();
+			if (instruction.isTerminator() && !last)
+			{
+				fail(b, i, "terminator in the middle of a block");
+			}
+			if (open && instruction.isTerminator())
+			{
+				fail(b, i, "the open block of a fragment has a terminator");
+			}
+
+			bool hasDest = instruction.definesValue();
+			bool hasLeft = instruction.opcode != IrOpcode::Input && instruction.opcode != IrOpcode::Jump
+				&& instruction.opcode != IrOpcode::Return;
+			bool hasRight = isArithmetic(instruction.opcode) || instruction.opcode == IrOpcode::Branch
+				|| instruction.opcode == IrOpcode::Compare || instruction.opcode == IrOpcode::CopyIf;
+
+			checkOperand(b, i, instruction.dest, hasDest, "destination");
+			checkOperand(b, i, instruction.left, hasLeft, "left operand");
+			checkOperand(b, i, instruction.right, hasRight, "right operand");
+			if (hasDest && instruction.dest.kind == IrOperand::Constant)
+			{
+				fail(b, i, "destination is a constant");
+			}
+			if (instruction.opcode == IrOpcode::CopyIf && instruction.dest.kind != IrOperand::Variable)
+			{
+				fail(b, i, "conditional copy to a temporary");
+			}
+			bool isShift = instruction.opcode == IrOpcode::ShiftLeft || instruction.opcode == IrOpcode::ShiftRight
+				|| instruction.opcode == IrOpcode::ShiftRightLogical;
+			if (isShift && (instruction.right.kind != IrOperand::Constant
+				|| instruction.right.value < 0 || instruction.right.value > 31))
+			{
+				fail(b, i, "shift amount is not a constant from 0 to 31");
+			}
+			if (instruction.wraps && instruction.opcode != IrOpcode::Add && instruction.opcode != IrOpcode::Subtract
+				&& instruction.opcode != IrOpcode::Multiply)
+			{
+				fail(b, i, "only +, - and * can wrap around");
+			}
+			if (instruction.opcode == IrOpcode::PrintText && (instruction.left.kind != IrOperand::Constant
+				|| instruction.left.value < 0 || static_cast<size_t>(instruction.left.value) >= texts.size()))
+			{
+				fail(b, i, "printed text is not a constant index into texts");
+			}
+
+			if (instruction.opcode == IrOpcode::Jump || instruction.opcode == IrOpcode::Branch)
+			{
+				if (instruction.target < 0 || static_cast<size_t>(instruction.target) >= blocks.size())
+				{
+					fail(b, i, "jump to a missing block");
+				}
+			}
+			if (instruction.opcode == IrOpcode::Branch
+				&& (instruction.falseTarget < 0 || static_cast<size_t>(instruction.falseTarget) >= blocks.size()))
+			{
+				fail(b, i, "branch to a missing block");
+			}
+
+			if (hasDest && instruction.dest.kind == IrOperand::Temporary)
+			{
+				if (definitions[instruction.dest.value].first >= 0)
+				{
+					fail(b, i, "temporary t" + to_string(instruction.dest.value) + " is assigned twice");
+				}
+				definitions[instruction.dest.value] = make_pair(static_cast<int>(b), static_cast<int>(i));
+			}
+		}
+	}
+
+	// Every use of a temporary must be dominated by its definition
+	ControlFlowGraph graph;
+	graph.build(*this);
+
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		if (!graph.isReachable(static_cast<int>(b)))
+		{
+			continue;
+		}
+
+		const vector<IrInstruction>& instructions = blocks[b].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			for (const IrOperand* operand : { &instructions[i].left, &instructions[i].right })
+			{
+				if (operand->kind != IrOperand::Temporary)
+				{
+					continue;
+				}
+
+				pair<int, int> definition = definitions[operand->value];
+				bool defined = definition.first == static_cast<int>(b)
+					? definition.second < static_cast<int>(i)
+					: definition.first >= 0 && graph.dominates(definition.first, static_cast<int>(b));
+				if (!defined)
+				{
+					fail(b, i, "temporary t" + to_string(operand->value) + " is used before it is assigned");
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Three-address code (IR)
+ *
+ * Purpose: A linear, backend-independent form of a program. IrBuilder
+ * lowers the AST into it, the optimization passes rewrite it, and both
+ * code generators emit C++ from it.
+ *
+ * How it works:
+ * 1. Each instruction has at most one operator: dest = left op right
+ * 2. Operands are constants, variable slots (numbered by Resolver) or
+ *    temporaries; each temporary is assigned exactly once
+ * 3. Instructions are grouped into basic blocks; only the last instruction
+ *    of a block (Jump, Branch or Return) transfers control
+ *
+ * Example: while (x < 5) { x = x + 1; } becomes
+ *     L_LOOP_1:
+ *         if x < 5 goto L_BODY_2 else goto L_LOOP_END_3
+ *     L_BODY_2:
+ *         x = x + 1
+ *         goto L_LOOP_1
+ *     L_LOOP_END_3:
+ */
+
+enum class IrOpcode
+{
+	Copy,		// dest = left
+	Add,		// dest = left + right
+	Subtract,	// dest = left - right
+	Multiply,	// dest = left * right
+	Divide,		// dest = left / right
+	ShiftLeft,	// dest = left << right
+	ShiftRight,	// dest = left >> right, copying the sign bit
+	ShiftRightLogical,	// dest = left >> right, shifting in zeros
+	MultiplyHigh,	// dest = upper 32 bits of the 64-bit product left * right
+	Compare,	// dest = 1 if left compare right, else 0
+	CopyIf,		// dest = left if right is not 0, else dest is kept; dest is a variable
+	Input,		// dest = integer read from the console
+	Print,		// print left
+	PrintLine,	// print left, then a newline
+	PrintText,	// print IrProgram::texts[left], a constant
+	Jump,		// goto target
+	Branch,		// if left compare right goto target else goto falseTarget
+	Return		// end of program
+};
+
+enum class IrCompare
+{
+	Equal,
+	NotEqual,
+	Less,
+	Greater,
+	LessEqual,
+	GreaterEqual
+};
+
+/**
+ * An instruction operand: a constant, a variable slot or a temporary.
+ */
+struct IrOperand
+{
+	enum Kind
+	{
+		None,
+		Constant,
+		Variable,
+		Temporary
+	};
+
+	Kind kind;
+	int value;	// the constant, the slot or the temporary number
+
+	IrOperand() : kind(None), value(0) {}
+	IrOperand(Kind k, int v) : kind(k), value(v) {}
+
+	static IrOperand constant(int value) { return IrOperand(Constant, value); }
+	static IrOperand variable(int slot) { return IrOperand(Variable, slot); }
+	static IrOperand temporary(int number) { return IrOperand(Temporary, number); }
+
+	bool operator==(const IrOperand& other) const { return kind == other.kind && value == other.value; }
+	bool operator!=(const IrOperand& other) const { return !(*this == other); }
+};
+
+struct IrInstruction
+{
+	IrOpcode opcode;
+	IrOperand dest;
+	IrOperand left;
+	IrOperand right;
+	IrCompare compare;		// Branch and Compare
+	int target;				// Jump and Branch: block index
+	int falseTarget;		// Branch only
+	bool wraps;				// Add, Subtract and Multiply: modulo 2^32 instead of overflowing
+
+	IrInstruction(IrOpcode op)
+		: opcode(op), compare(IrCompare::Equal), target(-1), falseTarget(-1), wraps(false)
+	{
+	}
+
+	bool isTerminator() const;
+	bool definesValue() const;	// Copy, arithmetic, Compare, CopyIf and Input
+	bool hasSideEffects() const;	// Input, Print, PrintLine and PrintText
+};
+
+struct IrBlock
+{
+	std::string label;
+	std::vector<IrInstruction> instructions;	// the last one is the terminator
+
+	explicit IrBlock(std::string label) : label(std::move(label)) {}
+
+	bool isTerminated() const { return !instructions.empty() && instructions.back().isTerminator(); }
+	const IrInstruction& terminator() const { return instructions.back(); }
+};
+
+/**
+ * A whole program, or one top-level statement of a streamed program.
+ *
+ * blocks[0] is the entry. A complete program ends in a Return; in a
+ * fragment (see IrBuilder::lowerFragment) the last block is left open,
+ * without a terminator, and control continues with the next fragment.
+ */
+class IrProgram
+{
+	std::vector<IrBlock> spareBlocks;	// removed, with the storage of their label and instructions
+	std::string newLabel;
+	std::vector<IrBlock> reordered;		// work space of reorderBlocks()
+	std::vector<int> newIndex;
+
+public:
+	std::vector<std::string> variableNames;	// by slot
+	std::vector<unsigned char> variableBits;	// by slot: 8, 16 or 32; 32 past the end
+	std::vector<std::string> texts;			// printed by PrintText
+	int temporaryCount;
+	std::vector<IrBlock> blocks;
+	bool fragment;
+
+	IrProgram();
+
+	/**
+	 * Removes all blocks, temporaries and texts. Variable names are kept,
+	 * since a streamed program continues to use them.
+	 */
+	void clearBlocks();
+
+	/**
+	 * Removes everything.
+	 */
+	void clear();
+
+	/**
+	 * Appends an empty block labelled label followed by suffix, and
+	 * returns its index. The storage of removed blocks is reused.
+	 */
+	int addBlock(const std::string& label, const std::string& suffix = std::string());
+
+	/**
+	 * Keeps only the blocks listed in order, in that order, and updates
+	 * the jump targets. order must start with the entry, and must end
+	 * with the open block of a fragment; no kept block may jump to a
+	 * block that is dropped.
+	 */
+	void reorderBlocks(const std::vector<int>& order);
+
+	int newTemporary() { return temporaryCount++; }
+
+	/**
+	 * Bits of the C++ integer type that holds a slot; RangeOptimizer sets
+	 * fewer than 32 when every value stored in it fits.
+	 */
+	int bits(int slot) const
+	{
+		return static_cast<size_t>(slot) < variableBits.size() ? variableBits[slot] : 32;
+	}
+
+	/**
+	 * Writes a readable listing of the program.
+	 */
+	void print(std::ostream& out) const;
+
+	/**
+	 * Checks the structural invariants above and throws logic_error
+	 * describing the first violation.
+	 */
+	void verify() const;
+
+	static const char* opcodeSymbol(IrOpcode opcode);	// "+", "-", "*", "/", "<<", ...
+	static const char* compareSymbol(IrCompare compare);	// "==", "<", ...
+	static bool isArithmetic(IrOpcode opcode);	// dest = left op right
+
+	/**
+	 * The comparison that is true exactly when compare is false.
+	 */
+	static IrCompare negate(IrCompare compare);
+};
+
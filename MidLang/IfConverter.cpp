@@ -0,0 +1,268 @@
+#include "IfConverter.h"
+#include "AllocProfiler.h"
+
+using namespace std;
+
+namespace
+{
+	IrInstruction operation(IrOpcode opcode, const IrOperand& dest, const IrOperand& left, const IrOperand& right)
+	{
+		IrInstruction instruction(opcode);
+		instruction.dest = dest;
+		instruction.left = left;
+		instruction.right = right;
+		return instruction;
+	}
+
+	IrInstruction jump(int target)
+	{
+		IrInstruction instruction(IrOpcode::Jump);
+		instruction.target = target;
+		return instruction;
+	}
+}
+
+IfConverter::IfConverter()
+	: selectCount(0), conditionalCount(0)
+{
+}
+
+void IfConverter::reset()
+{
+	selectCount = 0;
+	conditionalCount = 0;
+}
+
+void IfConverter::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (settings.budget == 0)
+	{
+		return;
+	}
+
+	size_t count = program.blocks.size();
+	predecessorCount.assign(count, 0);
+	for (const IrBlock& block : program.blocks)
+	{
+		if (!block.isTerminated())
+		{
+			continue;
+		}
+		const IrInstruction& last = block.terminator();
+		if (last.opcode == IrOpcode::Jump || last.opcode == IrOpcode::Branch)
+		{
+			predecessorCount[last.target]++;
+		}
+		if (last.opcode == IrOpcode::Branch)
+		{
+			predecessorCount[last.falseTarget]++;
+		}
+	}
+
+	removed.assign(count, 0);
+	bool changed = false;
+	for (size_t b = 0; b < count; b++)
+	{
+		if (!removed[b] && convert(program, static_cast<int>(b)))
+		{
+			changed = true;
+		}
+	}
+	if (!changed)
+	{
+		return;
+	}
+
+	order.clear();
+	for (size_t b = 0; b < count; b++)
+	{
+		if (!removed[b])
+		{
+			order.push_back(static_cast<int>(b));
+		}
+	}
+	program.reorderBlocks(order);
+}
+
+bool IfConverter::convert(IrProgram& program, int block)
+{
+	const IrBlock& test = program.blocks[block];
+	if (!test.isTerminated() || test.terminator().opcode != IrOpcode::Branch)
+	{
+		return false;
+	}
+	IrInstruction branch = test.terminator();
+	if (branch.target == branch.falseTarget)
+	{
+		return false;
+	}
+
+	// A way that only jumps to the other way's block goes straight there
+	Way whenTrue = follow(program, block, branch.target);
+	Way whenFalse = follow(program, block, branch.falseTarget);
+	if (whenTrue.store < 0 && whenTrue.block >= 0 && whenTrue.join == branch.falseTarget)
+	{
+		whenTrue = Way{ -1, branch.target, -1, 0 };
+	}
+	if (whenFalse.store < 0 && whenFalse.block >= 0 && whenFalse.join == branch.target)
+	{
+		whenFalse = Way{ -1, branch.falseTarget, -1, 0 };
+	}
+
+	int join = whenTrue.join;
+	if (join != whenFalse.join || join == block || (whenTrue.store < 0 && whenFalse.store < 0)
+		|| whenTrue.cost + whenFalse.cost > settings.budget)
+	{
+		return false;
+	}
+
+	const Way& stored = whenTrue.store >= 0 ? whenTrue : whenFalse;
+	IrOperand variable = program.blocks[stored.block].instructions[stored.store].dest;
+	bool both = whenTrue.store >= 0 && whenFalse.store >= 0;
+	if (both && (program.blocks[whenFalse.block].instructions[whenFalse.store].dest != variable
+		|| program.bits(variable.value) < 32))
+	{
+		return false;
+	}
+
+	// t = left compare right, the work of both ways, then the stores
+	IrOperand condition = IrOperand::temporary(program.newTemporary());
+	vector<IrInstruction>& instructions = program.blocks[block].instructions;
+	instructions.pop_back();
+	IrInstruction compare = operation(IrOpcode::Compare, condition, branch.left, branch.right);
+	compare.compare = whenTrue.store >= 0 ? branch.compare : IrProgram::negate(branch.compare);
+	instructions.push_back(compare);
+	IrOperand trueValue;
+	IrOperand falseValue;
+	if (whenTrue.store >= 0)
+	{
+		trueValue = speculate(program, block, whenTrue.block, whenTrue.store);
+	}
+	if (whenFalse.store >= 0)
+	{
+		falseValue = speculate(program, block, whenFalse.block, whenFalse.store);
+	}
+	if (both)
+	{
+		instructions.push_back(operation(IrOpcode::Copy, variable, falseValue, IrOperand()));
+		instructions.push_back(operation(IrOpcode::CopyIf, variable, trueValue, condition));
+		selectCount++;
+	}
+	else
+	{
+		instructions.push_back(operation(IrOpcode::CopyIf, variable, whenTrue.store >= 0 ? trueValue : falseValue,
+			condition));
+		conditionalCount++;
+	}
+	instructions.push_back(jump(join));
+
+	// The arms lose their only predecessor; a jump-only block may have others
+	predecessorCount[join]++;
+	for (const Way* way : { &whenTrue, &whenFalse })
+	{
+		if (way->block < 0)
+		{
+			predecessorCount[join]--;
+		}
+		else if (--predecessorCount[way->block] == 0)
+		{
+			removed[way->block] = 1;
+			predecessorCount[join]--;
+		}
+	}
+	return true;
+}
+
+IfConverter::Way IfConverter::follow(const IrProgram& program, int block, int target) const
+{
+	Way way = { -1, target, -1, 0 };
+	const IrBlock& arm = program.blocks[target];
+	if (target == 0 || target == block || !arm.isTerminated() || arm.terminator().opcode != IrOpcode::Jump)
+	{
+		return way;
+	}
+
+	const vector<IrInstruction>& instructions = arm.instructions;
+	size_t last = instructions.size() - 1;
+	if (last == 0)
+	{
+		return Way{ target, instructions[last].target, -1, 0 };
+	}
+	if (predecessorCount[target] != 1)
+	{
+		return way;
+	}
+
+	// Temporaries, then the store; a store of the variable to itself is
+	// no store at all
+	size_t total = 0;
+	for (size_t i = 0; i < last; i++)
+	{
+		const IrInstruction& instruction = instructions[i];
+		int work = cost(instruction);
+		IrOperand::Kind kind = i + 1 == last ? IrOperand::Variable : IrOperand::Temporary;
+		if (work < 0 || instruction.dest.kind != kind)
+		{
+			return way;
+		}
+		total += work;
+	}
+	const IrInstruction& store = instructions[last - 1];
+	bool itself = store.opcode == IrOpcode::Copy && store.left == store.dest;
+	return Way{ target, instructions[last].target, itself ? -1 : static_cast<int>(last) - 1, total };
+}
+
+IrOperand IfConverter::speculate(IrProgram& program, int test, int arm, int store)
+{
+	const vector<IrInstruction>& instructions = program.blocks[arm].instructions;
+	vector<IrInstruction>& work = program.blocks[test].instructions;
+	for (int i = 0; i <= store; i++)
+	{
+		IrInstruction instruction = instructions[i];
+		if (i == store)
+		{
+			if (instruction.opcode == IrOpcode::Copy)
+			{
+				return instruction.left;
+			}
+			instruction.dest = IrOperand::temporary(program.newTemporary());
+		}
+		if (instruction.opcode == IrOpcode::ShiftLeft)
+		{
+			instruction.opcode = IrOpcode::Multiply;
+			instruction.right = IrOperand::constant(static_cast<int>(1u << instruction.right.value));
+		}
+		if (instruction.opcode == IrOpcode::Add || instruction.opcode == IrOpcode::Subtract
+			|| instruction.opcode == IrOpcode::Multiply)
+		{
+			instruction.wraps = true;
+		}
+		work.push_back(instruction);
+	}
+	return work.back().dest;
+}
+
+int IfConverter::cost(const IrInstruction& instruction)
+{
+	switch (instruction.opcode)
+	{
+	case IrOpcode::Copy:
+	case IrOpcode::Add:
+	case IrOpcode::Subtract:
+	case IrOpcode::ShiftLeft:
+	case IrOpcode::ShiftRight:
+	case IrOpcode::ShiftRightLogical:
+		return 1;
+	case IrOpcode::Multiply:
+	case IrOpcode::MultiplyHigh:
+		return 3;
+	case IrOpcode::Divide:
+		return instruction.right.kind == IrOperand::Constant && instruction.right.value != 0
+			&& instruction.right.value != -1 ? 10 : -1;
+	default:
+		return -1;
+	}
+}
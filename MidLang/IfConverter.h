@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "IR.h"
+
+/**
+ * How much work IfConverter may do on the way that was not taken.
+ */
+struct SelectSettings
+{
+	size_t budget;	// most work of both ways of one if, in the units of the cost model; 0 for none
+
+	SelectSettings() : budget(6) {}
+};
+
+/**
+ * IfConverter (Optimization pass on the IR)
+ *
+ * Purpose: Replaces small ifs that only choose what to store in a variable
+ * by a store of a choice between the values,
+ *     if (a < b) { m = a; } else { m = b; }
+ * becoming m = (a < b) ? a : b, and
+ *     if (x > m) { m = x; }
+ * becoming m = (x > m) ? x : m, which C++ compilers turn into a
+ * conditional move instead of a jump. On data where the branch is hard to
+ * predict, such as random input, a mispredicted jump costs more than the
+ * work of both ways.
+ *
+ * How it works:
+ * 1. A way of a branch is an arm if it is a block entered only from the
+ *    branch that computes temporaries, stores one variable last and jumps
+ *    on; the other way must be an arm storing the same variable, a block
+ *    that only jumps, or the block where both meet
+ * 2. The branch becomes t = left compare right, followed by the work of
+ *    both arms, the store of the false way's value and a CopyIf of the true
+ *    way's value on t (with a single arm, only its value on t or on its
+ *    negation), and a jump to where the ways meet
+ * 3. The arms, and the blocks that only jumped, are dropped
+ *
+ * Cost model: the work of both ways is done every time, so the arms may
+ * together cost at most settings.budget: 1 per copy, addition,
+ * subtraction or shift, 3 per multiplication and 10 per division. Arms
+ * that read input or print are not converted, nor ones that divide by
+ * anything but a constant other than 0 and -1, which could trap. The
+ * work of an arm is done even when its value is not needed, so its
+ * additions, subtractions and multiplications wrap instead of
+ * overflowing, and a left shift becomes a wrapping multiplication. An if
+ * that stores on both ways into a variable narrowed by RangeOptimizer is
+ * kept, since the value of the way not taken might not fit.
+ *
+ * The pass runs last, since Compare and CopyIf are only known to the code
+ * generators; it works on fragments as on whole programs.
+ */
+class IfConverter
+{
+	// Where one way of a branch goes
+	struct Way
+	{
+		int block;		// the arm or jump-only block, or -1 if the way goes straight to join
+		int join;
+		int store;		// index of the store in the arm, or -1 if nothing is stored
+		size_t cost;
+	};
+
+	std::vector<int> predecessorCount;	// by block
+	std::vector<char> removed;			// by block: an arm moved into its branch, or a jump-only block
+	std::vector<int> order;
+
+	bool convert(IrProgram& program, int block);
+	Way follow(const IrProgram& program, int block, int target) const;
+	IrOperand speculate(IrProgram& program, int test, int arm, int store);
+	static int cost(const IrInstruction& instruction);	// -1 if it may not be done speculatively
+
+public:
+	SelectSettings settings;
+
+	// Statistics since the last reset()
+	size_t selectCount;			// ifs storing on both ways, now storing a choice
+	size_t conditionalCount;	// ifs storing on one way, now a conditional copy
+
+	IfConverter();
+
+	/**
+	 * Clears the statistics, keeping the settings and internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Converts the ifs of a whole program or one fragment in place.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,245 @@
+#include "IrBuilder.h"
+#include "AllocProfiler.h"
+#include <stdexcept>
+
+using namespace std;
+
+IrBuilder::IrBuilder()
+	: program(nullptr), current(-1), labelCounter(0)
+{
+}
+
+void IrBuilder::reset()
+{
+	program = nullptr;
+	current = -1;
+	labelCounter = 0;
+}
+
+void IrBuilder::lower(ProgramNode* ast, IrProgram& out)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Lower);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	program = &out;
+	labelCounter = 0;
+	out.clear();
+	out.variableNames = *ast->slotNames;
+
+	current = out.addBlock("L_START");
+	for (auto* statement : ast->statements)
+	{
+		startStatement();
+		lowerStatement(statement);
+	}
+
+	jumpTo(out.addBlock("L_END"));
+	append(IrInstruction(IrOpcode::Return));
+	program = nullptr;
+}
+
+void IrBuilder::lowerFragment(Statement* statement, IrProgram& out)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Lower);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	program = &out;
+	out.clearBlocks();
+	out.fragment = true;
+
+	current = newBlock("L_STMT");
+	lowerStatement(statement);
+	program = nullptr;
+}
+
+IrCompare IrBuilder::compareFor(const string& op)
+{
+	if (op == "==") return IrCompare::Equal;
+	if (op == "!=") return IrCompare::NotEqual;
+	if (op == "<") return IrCompare::Less;
+	if (op == ">") return IrCompare::Greater;
+	if (op == "<=") return IrCompare::LessEqual;
+	if (op == ">=") return IrCompare::GreaterEqual;
+	throw logic_error("Unknown comparison operator: " + op);
+}
+
+IrOpcode IrBuilder::opcodeFor(const string& op)
+{
+	if (op == "+") return IrOpcode::Add;
+	if (op == "-") return IrOpcode::Subtract;
+	if (op == "*") return IrOpcode::Multiply;
+	if (op == "/") return IrOpcode::Divide;
+	throw logic_error("Unknown arithmetic operator: " + op);
+}
+
+int IrBuilder::newBlock(const string& prefix)
+{
+	return program->addBlock(prefix, "_" + to_string(labelCounter++));
+}
+
+void IrBuilder::append(const IrInstruction& instruction)
+{
+	program->blocks[current].instructions.push_back(instruction);
+}
+
+IrInstruction& IrBuilder::terminatorOf(int block)
+{
+	return program->blocks[block].instructions.back();
+}
+
+void IrBuilder::jumpTo(int block)
+{
+	IrInstruction jump(IrOpcode::Jump);
+	jump.target = block;
+	append(jump);
+	current = block;
+}
+
+void IrBuilder::startStatement()
+{
+	jumpTo(newBlock("L_STMT"));
+}
+
+void IrBuilder::recordName(int slot, const string& name)
+{
+	if (slot < 0)
+	{
+		throw logic_error("Variable '" + name + "' has not been resolved");
+	}
+	if (static_cast<size_t>(slot) >= program->variableNames.size())
+	{
+		program->variableNames.resize(slot + 1);
+	}
+	program->variableNames[slot] = name;
+}
+
+void IrBuilder::lowerBlock(const vector<Statement*>& statements)
+{
+	for (auto* statement : statements)
+	{
+		lowerStatement(statement);
+	}
+}
+
+void IrBuilder::lowerStatement(Statement* statement)
+{
+	if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+	{
+		recordName(varDecl->slot, varDecl->variableName);
+		lowerStore(varDecl->slot, varDecl->expression);
+	}
+	else if (AssignmentStatement* assign = dynamic_cast<AssignmentStatement*>(statement))
+	{
+		recordName(assign->slot, assign->variableName);
+		lowerStore(assign->slot, assign->expression);
+	}
+	else if (PrintStatement* print = dynamic_cast<PrintStatement*>(statement))
+	{
+		IrInstruction instruction(IrOpcode::Print);
+		instruction.left = lowerExpression(print->expression);
+		append(instruction);
+	}
+	else if (PrintLineStatement* println = dynamic_cast<PrintLineStatement*>(statement))
+	{
+		IrInstruction instruction(IrOpcode::PrintLine);
+		instruction.left = lowerExpression(println->expression);
+		append(instruction);
+	}
+	else if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+	{
+		// Blocks are created in the order they are laid out, and the
+		// branch targets filled in once they exist
+		int conditionBlock = current;
+		lowerBranch(ifStmt->condition, -1, -1);
+
+		terminatorOf(conditionBlock).target = current = newBlock("L_THEN");
+		lowerBlock(ifStmt->thenStatements);
+		int thenEnd = current;
+
+		terminatorOf(conditionBlock).falseTarget = current = newBlock("L_ELSE");
+		lowerBlock(ifStmt->elseStatements);
+		int elseEnd = current;
+
+		int endBlock = newBlock("L_IF_END");
+		current = thenEnd;
+		jumpTo(endBlock);
+		current = elseEnd;
+		jumpTo(endBlock);
+	}
+	else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+	{
+		int loopBlock = newBlock("L_LOOP");
+		jumpTo(loopBlock);
+		lowerBranch(whileStmt->condition, -1, -1);
+
+		terminatorOf(loopBlock).target = current = newBlock("L_BODY");
+		lowerBlock(whileStmt->bodyStatements);
+		IrInstruction jump(IrOpcode::Jump);
+		jump.target = loopBlock;
+		append(jump);
+
+		terminatorOf(loopBlock).falseTarget = current = newBlock("L_LOOP_END");
+	}
+}
+
+void IrBuilder::lowerStore(int slot, Expression* expression)
+{
+	lowerValue(expression, IrOperand::variable(slot));
+}
+
+IrOperand IrBuilder::lowerExpression(Expression* expression)
+{
+	if (IntegerLiteral* lit = dynamic_cast<IntegerLiteral*>(expression))
+	{
+		return IrOperand::constant(lit->value);
+	}
+	if (VariableReference* varRef = dynamic_cast<VariableReference*>(expression))
+	{
+		recordName(varRef->slot, varRef->name);
+		return IrOperand::variable(varRef->slot);
+	}
+
+	IrOperand temporary = IrOperand::temporary(program->newTemporary());
+	lowerValue(expression, temporary);
+	return temporary;
+}
+
+void IrBuilder::lowerValue(Expression* expression, IrOperand dest)
+{
+	if (BinaryExpression* binExpr = dynamic_cast<BinaryExpression*>(expression))
+	{
+		IrInstruction instruction(opcodeFor(binExpr->op));
+		instruction.left = lowerExpression(binExpr->left);
+		instruction.right = lowerExpression(binExpr->right);
+		instruction.dest = dest;
+		append(instruction);
+	}
+	else if (dynamic_cast<InputIntExpression*>(expression) != nullptr)
+	{
+		IrInstruction instruction(IrOpcode::Input);
+		instruction.dest = dest;
+		append(instruction);
+	}
+	else if (dynamic_cast<BooleanExpression*>(expression) != nullptr)
+	{
+		throw logic_error("A comparison can only be used as a condition");
+	}
+	else
+	{
+		IrInstruction instruction(IrOpcode::Copy);
+		instruction.left = lowerExpression(expression);
+		instruction.dest = dest;
+		append(instruction);
+	}
+}
+
+void IrBuilder::lowerBranch(BooleanExpression* condition, int trueBlock, int falseBlock)
+{
+	IrInstruction branch(IrOpcode::Branch);
+	branch.left = lowerExpression(condition->left);
+	branch.right = lowerExpression(condition->right);
+	branch.compare = compareFor(condition->op);
+	branch.target = trueBlock;
+	branch.falseTarget = falseBlock;
+	append(branch);
+}
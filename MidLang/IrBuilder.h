@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include "AST.h"
+#include "IR.h"
+
+/**
+ * IrBuilder (Lowering)
+ *
+ * Purpose: Translates the resolved AST into three-address code.
+ *
+ * How it works:
+ * 1. Each top-level statement starts a new block (L_STMT_n), between
+ *    the L_START entry and the L_END block that returns
+ * 2. Nested expressions are split into instructions on temporaries, so
+ *    every instruction has at most one operator
+ * 3. An if becomes a Branch to a then block and an else block that both
+ *    jump to an end block; a while becomes a header block with a Branch
+ *    to the body (which jumps back to the header) or past the loop
+ *
+ * Blocks are created in layout order (then before else, body before the
+ * code after the loop) and labels are numbered in creation order, so the
+ * same program always gives the same labels.
+ */
+class IrBuilder
+{
+	IrProgram* program;
+	int current;		// block that instructions are appended to
+	int labelCounter;
+
+	int newBlock(const std::string& prefix);
+	void append(const IrInstruction& instruction);
+	void jumpTo(int block);
+	IrInstruction& terminatorOf(int block);
+	void startStatement();
+	void recordName(int slot, const std::string& name);
+
+	void lowerStatement(Statement* statement);
+	void lowerBlock(const vector<Statement*>& statements);
+	void lowerStore(int slot, Expression* expression);
+	IrOperand lowerExpression(Expression* expression);
+	void lowerValue(Expression* expression, IrOperand dest);
+	void lowerBranch(BooleanExpression* condition, int trueBlock, int falseBlock);
+
+public:
+	IrBuilder();
+
+	/**
+	 * Starts over with label numbers from zero, for a new streamed program.
+	 */
+	void reset();
+
+	/**
+	 * Lowers a complete program: L_START, one or more blocks per statement
+	 * and L_END, which returns. Replaces the contents of out.
+	 */
+	void lower(ProgramNode* program, IrProgram& out);
+
+	/**
+	 * Lowers one top-level statement of a streamed program into out, which
+	 * becomes a fragment: blocks[0] is the statement's L_STMT block and the
+	 * last block is left open for the next statement. Variable names carry
+	 * over from the previous fragment in out; temporaries are numbered from
+	 * zero again, since none of them lives past its statement.
+	 */
+	void lowerFragment(Statement* statement, IrProgram& out);
+
+	static IrCompare compareFor(const std::string& op);
+	static IrOpcode opcodeFor(const std::string& op);
+};
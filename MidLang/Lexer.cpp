@@ -0,0 +1,291 @@
+#include "Lexer.h"
+#include "AllocProfiler.h"
+#include <cctype>
+
+using namespace std;
+
+Lexer::Lexer()
+	: source(""), length(0), input(nullptr), position(0), line(1), column(1), finished(false)
+{
+}
+
+Lexer::Lexer(const string& source)
+	: Lexer(source.data(), source.length())
+{
+}
+
+Lexer::Lexer(const char* source, size_t length)
+	: source(source), length(length), input(nullptr), position(0), line(1), column(1), finished(false)
+{
+}
+
+Lexer::Lexer(istream& input)
+	: source(""), length(0), input(input.rdbuf()), position(0), line(1), column(1), finished(false)
+{
+}
+
+void Lexer::reset(const char* source, size_t length)
+{
+	this->source = source;
+	this->length = length;
+	input = nullptr;
+	position = 0;
+	line = 1;
+	column = 1;
+	finished = false;
+}
+
+vector<Token> Lexer::tokenize()
+{
+	vector<Token> tokens;
+	tokenize(tokens);
+	return tokens;
+}
+
+void Lexer::tokenize(vector<Token>& tokens)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Lex);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+	tokens.clear();
+
+	while (true)
+	{
+		tokens.push_back(next());
+
+		if (tokens.back().type == TokenType::EOF_TOKEN)
+		{
+			break;
+		}
+	}
+}
+
+Token Lexer::next()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Lex);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::TokenStrings);
+
+	if (!finished)
+	{
+		skipWhitespace();
+		if (!isAtEnd())
+		{
+			Token token = nextToken();
+
+			// Stop if we hit an error token
+			if (token.type == TokenType::UNKNOWN)
+			{
+				finished = true;
+			}
+			return token;
+		}
+		finished = true;
+	}
+
+	return Token(TokenType::EOF_TOKEN, "", line, column);
+}
+
+Token Lexer::nextToken()
+{
+	char current = advance();
+
+	// Two-character operators (check these first)
+	switch (current)
+	{
+		case '=':
+			if (peek() == '=')
+			{
+				advance(); // consume the second '='
+				return Token(TokenType::EQUAL_EQUAL, "==", line, column - 2);
+			}
+			return createToken(TokenType::ASSIGN, current);
+		case '!':
+			if (peek() == '=')
+			{
+				advance(); // consume the '='
+				return Token(TokenType::NOT_EQUAL, "!=", line, column - 2);
+			}
+			return Token(TokenType::UNKNOWN, string(1, current), line, column - 1);
+		case '<':
+			if (peek() == '=')
+			{
+				advance(); // consume the '='
+				return Token(TokenType::LESS_EQUAL, "<=", line, column - 2);
+			}
+			return createToken(TokenType::LESS, current);
+		case '>':
+			if (peek() == '=')
+			{
+				advance(); // consume the '='
+				return Token(TokenType::GREATER_EQUAL, ">=", line, column - 2);
+			}
+			return createToken(TokenType::GREATER, current);
+		case '+': return createToken(TokenType::PLUS, current);
+		case '-': return createToken(TokenType::MINUS, current);
+		case '*': return createToken(TokenType::MULTIPLY, current);
+		case '/': return createToken(TokenType::DIVIDE, current);
+		case ';': return createToken(TokenType::SEMICOLON, current);
+		case '(': return createToken(TokenType::LEFT_PAREN, current);
+		case ')': return createToken(TokenType::RIGHT_PAREN, current);
+		case '{': return createToken(TokenType::LEFT_BRACE, current);
+		case '}': return createToken(TokenType::RIGHT_BRACE, current);
+	}
+
+	// Numbers (integers)
+	if (isdigit(current))
+	{
+		return readNumber(current);
+	}
+
+	// Identifiers and keywords
+	if (isalpha(current) || current == '_')
+	{
+		return readIdentifier(current);
+	}
+
+	// Unknown character
+	return Token(TokenType::UNKNOWN, string(1, current), line, column);
+}
+
+Token Lexer::readNumber(char first)
+{
+	int startColumn = column - 1;
+
+	// Read digits (we've already consumed the first digit)
+	string number(1, first);
+
+	// Read remaining digits
+	while (!isAtEnd() && isdigit(peek()))
+	{
+		number += advance();
+	}
+
+	return Token(TokenType::INTEGER, move(number), line, startColumn);
+}
+
+Token Lexer::readIdentifier(char first)
+{
+	int startColumn = column - 1;
+
+	// Read first character (already consumed)
+	string value(1, first);
+
+	// Read remaining letters, digits, and underscores
+	while (!isAtEnd() && (isalnum(peek()) || peek() == '_'))
+	{
+		value += advance();
+	}
+
+	// Check if it's a keyword
+	TokenType type;
+	if (value == "var")
+	{
+		type = TokenType::VAR;
+	}
+	else if (value == "print")
+	{
+		type = TokenType::PRINT;
+	}
+	else if (value == "println")
+	{
+		type = TokenType::PRINTLN;
+	}
+	else if (value == "inputInt")
+	{
+		type = TokenType::INPUT_INT;
+	}
+	else if (value == "if")
+	{
+		type = TokenType::IF;
+	}
+	else if (value == "else")
+	{
+		type = TokenType::ELSE;
+	}
+	else if (value == "while")
+	{
+		type = TokenType::WHILE;
+	}
+	else
+	{
+		type = TokenType::IDENTIFIER;
+	}
+
+	return Token(type, move(value), line, startColumn);
+}
+
+void Lexer::skipWhitespace()
+{
+	while (!isAtEnd())
+	{
+		char c = peek();
+		if (c == ' ' || c == '\t')
+		{
+			advance();
+		}
+		else if (c == '\r')
+		{
+			// Handle Windows line endings (\r\n)
+			advance();
+			if (!isAtEnd() && peek() == '\n')
+			{
+				advance(); // Skip the \n after \r
+			}
+			line++;
+			column = 1;
+		}
+		else if (c == '\n')
+		{
+			// Handle Unix line endings (\n)
+			advance();
+			line++;
+			column = 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+char Lexer::peek()
+{
+	if (isAtEnd())
+	{
+		return '\0';
+	}
+	if (input != nullptr)
+	{
+		return char_traits<char>::to_char_type(input->sgetc());
+	}
+	return source[position];
+}
+
+char Lexer::advance()
+{
+	if (isAtEnd())
+	{
+		return '\0';
+	}
+	column++;
+	position++;
+	if (input != nullptr)
+	{
+		return char_traits<char>::to_char_type(input->sbumpc());
+	}
+	return source[position - 1];
+}
+
+bool Lexer::isAtEnd() const
+{
+	if (input != nullptr)
+	{
+		return input->sgetc() == char_traits<char>::eof();
+	}
+	return position >= length;
+}
+
+Token Lexer::createToken(TokenType type, char c) const
+{
+	string value(1, c);
+	return Token(type, value, line, column - 1);
+}
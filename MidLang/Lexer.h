@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <istream>
+#include "Token.h"
+
+/**
+ * Lexer (Lexical Analyzer / Tokenizer)
+ * 
+ * Purpose: Converts source code into a stream of tokens.
+ * 
+ * How it works:
+ * 1. Reads the source code character by character
+ * 2. Groups characters into tokens (keywords, identifiers, operators, etc.)
+ * 3. Returns a list of tokens for the parser to use
+ */
+class Lexer : public TokenSource
+{
+	const char* source;		// not owned; must outlive the lexer
+	size_t length;
+	std::streambuf* input;	// non-null when reading from a stream
+	size_t position;
+	int line;
+	int column;
+	bool finished;
+
+	// Helper methods
+	char peek();
+	char advance();
+	bool isAtEnd() const;
+	Token createToken(TokenType type, char c) const;
+	void skipWhitespace();
+
+	// Token reading methods
+	Token nextToken();
+	Token readNumber(char first);
+	Token readIdentifier(char first);
+
+public:
+	Lexer();
+
+	/**
+	 * Reads the given source without copying it, so the string or buffer
+	 * must outlive the lexer. Temporaries are rejected for that reason.
+	 */
+	Lexer(const std::string& source);
+	Lexer(std::string&& source) = delete;
+	Lexer(const char* source, size_t length);
+
+	/**
+	 * Reads the source incrementally from a stream instead of holding
+	 * the whole program in memory.
+	 */
+	Lexer(std::istream& input);
+
+	/**
+	 * Starts over on new source text without copying it, so one lexer
+	 * can be reused for many compilations.
+	 */
+	void reset(const char* source, size_t length);
+
+	/**
+	 * Tokenizes the source code and returns a list of tokens.
+	 */
+	std::vector<Token> tokenize();
+
+	/**
+	 * Same, but fills the given vector (keeping its capacity).
+	 */
+	void tokenize(std::vector<Token>& tokens);
+
+	/**
+	 * Returns the next token. After the end of input (or an UNKNOWN
+	 * token, as in tokenize()) every call returns EOF_TOKEN.
+	 */
+	Token next() override;
+};
@@ -0,0 +1,544 @@
+#include "LoopCollapser.h"
+#include "AllocProfiler.h"
+#include <climits>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+	// a compare b is b mirrored a
+	IrCompare mirror(IrCompare compare)
+	{
+		switch (compare)
+		{
+		case IrCompare::Less: return IrCompare::Greater;
+		case IrCompare::Greater: return IrCompare::Less;
+		case IrCompare::LessEqual: return IrCompare::GreaterEqual;
+		case IrCompare::GreaterEqual: return IrCompare::LessEqual;
+		default: return compare;
+		}
+	}
+
+	IrInstruction branch(const IrOperand& left, IrCompare compare, const IrOperand& right, int target, int falseTarget)
+	{
+		IrInstruction instruction(IrOpcode::Branch);
+		instruction.left = left;
+		instruction.compare = compare;
+		instruction.right = right;
+		instruction.target = target;
+		instruction.falseTarget = falseTarget;
+		return instruction;
+	}
+}
+
+LoopCollapser::LoopCollapser()
+	: valueCount(0), labelCounter(0), collapsedCount(0)
+{
+}
+
+void LoopCollapser::reset()
+{
+	labelCounter = 0;
+	collapsedCount = 0;
+}
+
+void LoopCollapser::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (program.blocks.size() < 2)
+	{
+		return;
+	}
+
+	int count = static_cast<int>(program.blocks.size());
+	graph.build(program);
+	loopOf.assign(count, -1);
+	valueOfTemporary.assign(program.temporaryCount, -1);
+	valueOfSlot.assign(program.variableNames.size(), -1);
+	insertedAfter.assign(count, -1);
+	insertedEnd.assign(count, -1);
+
+	// Only innermost loops qualify, so the order does not matter. New
+	// blocks are appended, so the graph still describes the old ones
+	bool changed = false;
+	for (int header : graph.order)
+	{
+		changed |= collapse(program, header);
+	}
+	if (!changed)
+	{
+		return;
+	}
+
+	// Put the new blocks after the preheader that jumps to them, which
+	// also keeps the open block of a fragment last
+	order.clear();
+	for (int block = 0; block < count; block++)
+	{
+		order.push_back(block);
+		for (int inserted = insertedAfter[block]; inserted >= 0 && inserted < insertedEnd[block]; inserted++)
+		{
+			order.push_back(inserted);
+		}
+	}
+	program.reorderBlocks(order);
+}
+
+bool LoopCollapser::collapse(IrProgram& program, int header)
+{
+	if (!graph.collectLoop(header, members, loopOf) || members.size() != 2)
+	{
+		return false;
+	}
+	int body = members[0] == header ? members[1] : members[0];
+	int preheader = graph.findPreheader(program, header, loopOf);
+	if (preheader < 0)
+	{
+		return false;
+	}
+
+	// The header only tests the condition, and the body jumps back to it
+	const vector<IrInstruction>& test = program.blocks[header].instructions;
+	const vector<IrInstruction>& instructions = program.blocks[body].instructions;
+	if (test.size() != 1 || test[0].opcode != IrOpcode::Branch || (test[0].target == body) == (test[0].falseTarget == body)
+		|| instructions.back().opcode != IrOpcode::Jump)
+	{
+		return false;
+	}
+
+	valueCount = 0;
+	stored.clear();
+	bool known = true;
+	for (size_t i = 0; known && i + 1 < instructions.size(); i++)
+	{
+		known = evaluate(instructions[i]);
+	}
+	bool collapsed = known && replace(program, header, preheader);
+	clearValues(program, body);
+	return collapsed;
+}
+
+bool LoopCollapser::replace(IrProgram& program, int header, int preheader)
+{
+	// Every stored variable must be one of the three kinds
+	for (int slot : stored)
+	{
+		const Affine& value = values[valueOfSlot[slot]];
+		if (!value.known)
+		{
+			return false;
+		}
+		if (stepOf(slot) != 0)
+		{
+			continue;
+		}
+		for (const Term& term : value.terms)
+		{
+			bool self = term.symbol == IrOperand::variable(slot);
+			if (self ? term.coefficient != 1 : term.symbol.kind == IrOperand::Variable
+				&& valueOfSlot[term.symbol.value] >= 0 && stepOf(term.symbol.value) == 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	// The condition to go on: counter compare bound, with the counter
+	// moving toward the bound
+	const IrInstruction& test = program.blocks[header].instructions[0];
+	IrCompare compare = loopOf[test.target] == header ? test.compare : IrProgram::negate(test.compare);
+	IrOperand counter = test.left;
+	IrOperand bound = test.right;
+	if (counter.kind != IrOperand::Variable || valueOfSlot[counter.value] < 0 || stepOf(counter.value) == 0)
+	{
+		swap(counter, bound);
+		compare = mirror(compare);
+	}
+	if (counter.kind != IrOperand::Variable || valueOfSlot[counter.value] < 0 || stepOf(counter.value) == 0
+		|| (bound.kind == IrOperand::Variable && valueOfSlot[bound.value] >= 0))
+	{
+		return false;
+	}
+
+	int step = stepOf(counter.value);
+	bool up = step > 0;
+	bool strict = compare == IrCompare::Less || compare == IrCompare::Greater;
+	if (step == INT_MIN || (up ? compare != IrCompare::Less && compare != IrCompare::LessEqual
+		: compare != IrCompare::Greater && compare != IrCompare::GreaterEqual))
+	{
+		return false;
+	}
+	int distanceStep = up ? step : -step;
+
+	// The last value of the counter must not overflow: bound - 1 + step
+	// at most INT_MAX when counting up with <, and so on
+	long long limit = up ? static_cast<long long>(INT_MAX) - step + (strict ? 1 : 0)
+		: static_cast<long long>(INT_MIN) - step - (strict ? 1 : 0);
+	bool checkLimit = up ? limit < INT_MAX : limit > INT_MIN;
+	if (checkLimit && bound.kind == IrOperand::Constant)
+	{
+		if (up ? bound.value > limit : bound.value < limit)
+		{
+			return false;	// runs until the counter overflows
+		}
+		checkLimit = false;
+	}
+
+	// Guards, each of which goes on to the next or leaves the loop to run
+	string suffix = "_" + to_string(++labelCounter);
+	int first = static_cast<int>(program.blocks.size());
+	int trip = program.addBlock("L_TRIP", suffix);
+	int range = checkLimit ? program.addBlock("L_RANGE", suffix) : -1;
+	int distance = program.addBlock("L_DISTANCE", suffix);
+	int closed = program.addBlock("L_CLOSED", suffix);
+
+	program.blocks[trip].instructions.push_back(branch(counter, compare, bound, checkLimit ? range : distance, header));
+	if (checkLimit)
+	{
+		program.blocks[range].instructions.push_back(branch(bound, up ? IrCompare::LessEqual : IrCompare::GreaterEqual,
+			IrOperand::constant(static_cast<int>(limit)), distance, header));
+	}
+
+	// The distance to the bound, if it fits in an int
+	code.clear();
+	IrOperand span = up ? emitOperation(IrOpcode::Subtract, bound, counter, true, program)
+		: emitOperation(IrOpcode::Subtract, counter, bound, true, program);
+	code.push_back(branch(span, strict ? IrCompare::Greater : IrCompare::GreaterEqual, IrOperand::constant(0),
+		closed, header));
+	program.blocks[distance].instructions.swap(code);
+
+	// n = (distance - 1) / step + 1 with <, distance / step + 1 with <=;
+	// the distance itself for < and a step of 1
+	code.clear();
+	IrOperand trips = span;
+	if (distanceStep != 1)
+	{
+		if (strict)
+		{
+			trips = emitOperation(IrOpcode::Subtract, trips, IrOperand::constant(1), false, program);
+		}
+		trips = emitOperation(IrOpcode::Divide, trips, IrOperand::constant(distanceStep), false, program);
+	}
+	if (distanceStep != 1 || !strict)
+	{
+		trips = emitOperation(IrOpcode::Add, trips, IrOperand::constant(1), true, program);
+	}
+
+	IrOperand last;		// n - 1
+	IrOperand half;		// n * (n - 1) / 2
+	results.clear();
+	for (int slot : stored)
+	{
+		const Affine& value = values[valueOfSlot[slot]];
+		int own = stepOf(slot);
+		if (own != 0)
+		{
+			// i + step * n
+			IrOperand moved = emitOperation(IrOpcode::Multiply, trips, IrOperand::constant(own), true, program);
+			results.push_back(emitOperation(IrOpcode::Add, IrOperand::variable(slot), moved, true, program));
+			continue;
+		}
+
+		// The value, or the increment, of the first iteration, and how
+		// much it grows in each one after it
+		sum.known = true;
+		sum.constant = value.constant;
+		sum.terms.clear();
+		unsigned growth = 0;
+		bool accumulates = false;
+		for (const Term& term : value.terms)
+		{
+			if (term.symbol == IrOperand::variable(slot))
+			{
+				accumulates = true;
+				continue;
+			}
+			sum.terms.push_back(term);
+			if (term.symbol.kind == IrOperand::Variable && valueOfSlot[term.symbol.value] >= 0)
+			{
+				growth += term.coefficient * static_cast<unsigned>(stepOf(term.symbol.value));
+			}
+		}
+		IrOperand start = emit(sum, program);
+
+		IrOperand result;
+		if (accumulates)
+		{
+			// s + first * n + growth * n * (n - 1) / 2
+			IrOperand added = emitOperation(IrOpcode::Multiply, trips, start, true, program);
+			result = emitOperation(IrOpcode::Add, IrOperand::variable(slot), added, true, program);
+			if (growth != 0)
+			{
+				if (half.kind == IrOperand::None)
+				{
+					// n or n - 1 is even; halve that one before multiplying
+					if (last.kind == IrOperand::None)
+					{
+						last = emitOperation(IrOpcode::Subtract, trips, IrOperand::constant(1), true, program);
+					}
+					IrOperand halved = emitOperation(IrOpcode::ShiftRightLogical, trips, IrOperand::constant(1), false, program);
+					IrOperand twice = emitOperation(IrOpcode::Add, halved, halved, true, program);
+					IrOperand odd = emitOperation(IrOpcode::Subtract, trips, twice, true, program);
+					IrOperand other = emitOperation(IrOpcode::Add, last, odd, true, program);
+					half = emitOperation(IrOpcode::Multiply, halved, other, true, program);
+				}
+				IrOperand grown = emitOperation(IrOpcode::Multiply, half, IrOperand::constant(static_cast<int>(growth)), true, program);
+				result = emitOperation(IrOpcode::Add, result, grown, true, program);
+			}
+		}
+		else
+		{
+			// The value of the last iteration: first + growth * (n - 1)
+			result = start;
+			if (growth != 0)
+			{
+				if (last.kind == IrOperand::None)
+				{
+					last = emitOperation(IrOpcode::Subtract, trips, IrOperand::constant(1), true, program);
+				}
+				IrOperand grown = emitOperation(IrOpcode::Multiply, last, IrOperand::constant(static_cast<int>(growth)), true, program);
+				result = emitOperation(IrOpcode::Add, result, grown, true, program);
+			}
+		}
+		results.push_back(result);
+	}
+
+	// All formulas read the values from before the loop, so store last
+	for (size_t i = 0; i < stored.size(); i++)
+	{
+		IrInstruction copy(IrOpcode::Copy);
+		copy.dest = IrOperand::variable(stored[i]);
+		copy.left = results[i];
+		code.push_back(copy);
+	}
+	IrInstruction jump(IrOpcode::Jump);
+	jump.target = header;
+	code.push_back(jump);
+	program.blocks[closed].instructions.swap(code);
+
+	program.blocks[preheader].instructions.back().target = trip;
+	insertedAfter[preheader] = first;
+	insertedEnd[preheader] = static_cast<int>(program.blocks.size());
+	collapsedCount++;
+	return true;
+}
+
+int LoopCollapser::newValue()
+{
+	if (valueCount == values.size())
+	{
+		values.emplace_back();
+	}
+	Affine& value = values[valueCount];
+	value.known = true;
+	value.constant = 0;
+	value.terms.clear();
+	return static_cast<int>(valueCount++);
+}
+
+bool LoopCollapser::evaluate(const IrInstruction& instruction)
+{
+	if (instruction.hasSideEffects() || !instruction.definesValue())
+	{
+		return false;
+	}
+
+	int index = newValue();
+	Affine& result = values[index];
+	switch (instruction.opcode)
+	{
+	case IrOpcode::Copy:
+		load(instruction.left, result);
+		break;
+	case IrOpcode::Add:
+	case IrOpcode::Subtract:
+		load(instruction.left, result);
+		load(instruction.right, sum);
+		addScaled(result, sum, instruction.opcode == IrOpcode::Add ? 1u : ~0u);
+		break;
+	case IrOpcode::Multiply:
+		load(instruction.left, result);
+		load(instruction.right, sum);
+		if (!sum.terms.empty())
+		{
+			swap(result, sum);
+		}
+		if (!sum.terms.empty())
+		{
+			result.known = false;	// not a sum any more
+			break;
+		}
+		{
+			unsigned factor = sum.constant;
+			result.known = result.known && sum.known;
+			result.constant *= factor;
+			size_t kept = 0;
+			for (const Term& term : result.terms)
+			{
+				if (term.coefficient * factor != 0)
+				{
+					result.terms[kept] = term;
+					result.terms[kept++].coefficient *= factor;
+				}
+			}
+			result.terms.resize(kept);
+		}
+		break;
+	default:
+		result.known = false;
+		break;
+	}
+
+	if (instruction.dest.kind == IrOperand::Temporary)
+	{
+		valueOfTemporary[instruction.dest.value] = index;
+	}
+	else
+	{
+		if (valueOfSlot[instruction.dest.value] < 0)
+		{
+			stored.push_back(instruction.dest.value);
+		}
+		valueOfSlot[instruction.dest.value] = index;
+	}
+	return true;
+}
+
+void LoopCollapser::load(const IrOperand& operand, Affine& out) const
+{
+	int index = -1;
+	if (operand.kind == IrOperand::Temporary && static_cast<size_t>(operand.value) < valueOfTemporary.size())
+	{
+		index = valueOfTemporary[operand.value];
+	}
+	else if (operand.kind == IrOperand::Variable)
+	{
+		index = valueOfSlot[operand.value];
+	}
+
+	if (index >= 0)
+	{
+		out.known = values[index].known;
+		out.constant = values[index].constant;
+		out.terms = values[index].terms;
+		return;
+	}
+
+	out.known = true;
+	out.terms.clear();
+	if (operand.kind == IrOperand::Constant)
+	{
+		out.constant = static_cast<unsigned>(operand.value);
+		return;
+	}
+
+	// Unchanged so far: its value from the start of the iteration
+	out.constant = 0;
+	Term term;
+	term.symbol = operand;
+	term.coefficient = 1;
+	out.terms.push_back(term);
+}
+
+int LoopCollapser::stepOf(int slot) const
+{
+	const Affine& value = values[valueOfSlot[slot]];
+	if (value.known && value.terms.size() == 1 && value.terms[0].symbol == IrOperand::variable(slot)
+		&& value.terms[0].coefficient == 1)
+	{
+		return static_cast<int>(value.constant);
+	}
+	return 0;
+}
+
+void LoopCollapser::addScaled(Affine& out, const Affine& value, unsigned factor) const
+{
+	out.known = out.known && value.known;
+	out.constant += value.constant * factor;
+	for (const Term& term : value.terms)
+	{
+		bool found = false;
+		for (size_t i = 0; i < out.terms.size() && !found; i++)
+		{
+			if (out.terms[i].symbol == term.symbol)
+			{
+				found = true;
+				out.terms[i].coefficient += term.coefficient * factor;
+				if (out.terms[i].coefficient == 0)
+				{
+					out.terms.erase(out.terms.begin() + i);
+				}
+			}
+		}
+		if (!found)
+		{
+			out.terms.push_back(term);
+			out.terms.back().coefficient *= factor;
+		}
+	}
+}
+
+IrOperand LoopCollapser::emit(const Affine& value, IrProgram& program)
+{
+	IrOperand result;
+	for (const Term& term : value.terms)
+	{
+		int coefficient = static_cast<int>(term.coefficient);
+		bool negative = coefficient < 0 && coefficient != INT_MIN && result.kind != IrOperand::None;
+		IrOperand part = emitOperation(IrOpcode::Multiply, term.symbol,
+			IrOperand::constant(negative ? -coefficient : coefficient), true, program);
+		result = result.kind == IrOperand::None ? part
+			: emitOperation(negative ? IrOpcode::Subtract : IrOpcode::Add, result, part, true, program);
+	}
+	if (result.kind == IrOperand::None)
+	{
+		return IrOperand::constant(static_cast<int>(value.constant));
+	}
+	return emitOperation(IrOpcode::Add, result, IrOperand::constant(static_cast<int>(value.constant)), true, program);
+}
+
+IrOperand LoopCollapser::emitOperation(IrOpcode opcode, const IrOperand& left, const IrOperand& right, bool wraps,
+	IrProgram& program)
+{
+	// x + 0, x - 0 and x * 1 need no instruction, x * 0 is 0
+	bool additive = opcode == IrOpcode::Add || opcode == IrOpcode::Subtract;
+	if ((additive && right == IrOperand::constant(0)) || (opcode == IrOpcode::Multiply && right == IrOperand::constant(1)))
+	{
+		return left;
+	}
+	if (opcode == IrOpcode::Multiply && left == IrOperand::constant(1))
+	{
+		return right;
+	}
+	if (opcode == IrOpcode::Multiply && (left == IrOperand::constant(0) || right == IrOperand::constant(0)))
+	{
+		return IrOperand::constant(0);
+	}
+
+	IrInstruction instruction(opcode);
+	instruction.dest = IrOperand::temporary(program.newTemporary());
+	instruction.left = left;
+	instruction.right = right;
+	instruction.wraps = wraps;
+	code.push_back(instruction);
+	return instruction.dest;
+}
+
+void LoopCollapser::clearValues(const IrProgram& program, int body)
+{
+	for (const IrInstruction& instruction : program.blocks[body].instructions)
+	{
+		if (instruction.dest.kind == IrOperand::Temporary)
+		{
+			valueOfTemporary[instruction.dest.value] = -1;
+		}
+		else if (instruction.dest.kind == IrOperand::Variable)
+		{
+			valueOfSlot[instruction.dest.value] = -1;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * LoopCollapser (Optimization pass on the IR)
+ *
+ * Purpose: Computes the result of a counting loop such as
+ *     while (i < n) { s = s + i; i = i + 1; }
+ * directly from a formula, instead of running it n times.
+ *
+ * How it works:
+ * 1. Takes loops of one block that print and read nothing, and evaluates
+ *    that block once with the variable values at the start of an
+ *    iteration as unknowns. Each stored variable must end up as a sum of
+ *    unknowns times constants
+ * 2. A variable increased by a constant is an induction variable: after
+ *    k iterations it is i + c * k. A variable increased by such a sum
+ *    grows by a fixed amount more each time: after k iterations it is
+ *    s + e * k + d * k * (k - 1) / 2. Any other variable may depend only
+ *    on induction variables, and gets its value from the last iteration
+ * 3. The loop condition must compare an induction variable with a value
+ *    the loop does not change, in the direction it moves. The number of
+ *    iterations n is then the distance divided by the step, rounded up
+ * 4. Before the loop, guarded by the loop condition, code is inserted
+ *    that computes n and stores the final value of every variable, so
+ *    the loop itself finds its condition false and ends at once
+ *
+ * The formulas wrap around like the loop's own arithmetic does, so they
+ * give its results even where an intermediate product overflows. The
+ * loop is still run, unchanged, when the counter would overflow before
+ * the condition becomes false, or when the distance to the bound does
+ * not fit in an int.
+ */
+class LoopCollapser
+{
+	struct Term
+	{
+		IrOperand symbol;		// a variable at the start of the iteration, or an outside temporary
+		unsigned coefficient;
+	};
+
+	// A sum of terms and a constant, modulo 2^32
+	struct Affine
+	{
+		bool known;
+		unsigned constant;
+		std::vector<Term> terms;
+	};
+
+	ControlFlowGraph graph;
+	std::vector<int> loopOf;
+	std::vector<int> members;
+	std::vector<Affine> values;			// of the loop being collapsed
+	size_t valueCount;
+	std::vector<int> valueOfTemporary;	// index into values, -1 if not computed in the loop
+	std::vector<int> valueOfSlot;		// index into values, -1 if not stored in the loop
+	std::vector<int> stored;			// slots, in the order of their first store
+	std::vector<int> insertedAfter;		// by block: first block inserted after it, or -1
+	std::vector<int> insertedEnd;
+	std::vector<int> order;
+	std::vector<IrInstruction> code;
+	std::vector<IrOperand> results;
+	Affine sum;
+	int labelCounter;
+
+	bool collapse(IrProgram& program, int header);
+	bool replace(IrProgram& program, int header, int preheader);	// after the body is evaluated
+	int newValue();
+	bool evaluate(const IrInstruction& instruction);
+	void load(const IrOperand& operand, Affine& out) const;
+	int stepOf(int slot) const;		// constant increment of an induction variable
+	void addScaled(Affine& out, const Affine& value, unsigned factor) const;
+	IrOperand emit(const Affine& value, IrProgram& program);
+	IrOperand emitOperation(IrOpcode opcode, const IrOperand& left, const IrOperand& right, bool wraps,
+		IrProgram& program);
+	void clearValues(const IrProgram& program, int body);
+
+public:
+	// Statistics since the last reset()
+	size_t collapsedCount;
+
+	LoopCollapser();
+
+	/**
+	 * Clears the statistics and the label numbering, keeping internal
+	 * buffers.
+	 */
+	void reset();
+
+	/**
+	 * Collapses the counting loops of a whole program or one fragment.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,508 @@
+#include "LoopFuser.h"
+#include "AllocProfiler.h"
+#include "DeadCodeEliminator.h"
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	const unsigned char firstRead = 1;		// access bits; stored is read << 1
+	const unsigned char firstStored = 2;
+	const unsigned char secondRead = 4;
+	const unsigned char secondStored = 8;
+
+	int storedSlot(const Statement* statement)
+	{
+		if (const VarDeclarationStatement* varDecl = dynamic_cast<const VarDeclarationStatement*>(statement))
+		{
+			return varDecl->slot;
+		}
+		if (const AssignmentStatement* assignment = dynamic_cast<const AssignmentStatement*>(statement))
+		{
+			return assignment->slot;
+		}
+		return -1;
+	}
+
+	const Expression* storedValue(const Statement* statement)
+	{
+		if (const VarDeclarationStatement* varDecl = dynamic_cast<const VarDeclarationStatement*>(statement))
+		{
+			return varDecl->expression;
+		}
+		if (const AssignmentStatement* assignment = dynamic_cast<const AssignmentStatement*>(statement))
+		{
+			return assignment->expression;
+		}
+		return nullptr;
+	}
+
+	// A declaration or assignment that reads no input
+	bool isStore(const Statement* statement)
+	{
+		return storedSlot(statement) >= 0 && !DeadCodeEliminator::hasSideEffects(storedValue(statement));
+	}
+
+	bool storesTo(const Statement* statement, int slot)
+	{
+		if (storedSlot(statement) == slot)
+		{
+			return true;
+		}
+		if (const IfStatement* ifStmt = dynamic_cast<const IfStatement*>(statement))
+		{
+			for (const Statement* inner : ifStmt->thenStatements)
+			{
+				if (storesTo(inner, slot))
+				{
+					return true;
+				}
+			}
+			for (const Statement* inner : ifStmt->elseStatements)
+			{
+				if (storesTo(inner, slot))
+				{
+					return true;
+				}
+			}
+		}
+		else if (const WhileStatement* whileStmt = dynamic_cast<const WhileStatement*>(statement))
+		{
+			for (const Statement* inner : whileStmt->bodyStatements)
+			{
+				if (storesTo(inner, slot))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// True if statement stores a variable that expression reads
+	bool changes(const Statement* statement, const Expression* expression)
+	{
+		if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+		{
+			return storesTo(statement, varRef->slot);
+		}
+		if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+		{
+			return changes(statement, binExpr->left) || changes(statement, binExpr->right);
+		}
+		return false;
+	}
+
+	bool readsSlot(const Expression* expression, int slot)
+	{
+		if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+		{
+			return varRef->slot == slot;
+		}
+		if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+		{
+			return readsSlot(binExpr->left, slot) || readsSlot(binExpr->right, slot);
+		}
+		return false;
+	}
+
+	void collectSlots(const Expression* expression, vector<int>& slots)
+	{
+		if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+		{
+			slots.push_back(varRef->slot);
+		}
+		else if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+		{
+			collectSlots(binExpr->left, slots);
+			collectSlots(binExpr->right, slots);
+		}
+	}
+
+	// The same literals, variables and operators
+	bool same(const Expression* a, const Expression* b)
+	{
+		if (const IntegerLiteral* literal = dynamic_cast<const IntegerLiteral*>(a))
+		{
+			const IntegerLiteral* other = dynamic_cast<const IntegerLiteral*>(b);
+			return other != nullptr && other->value == literal->value;
+		}
+		if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(a))
+		{
+			const VariableReference* other = dynamic_cast<const VariableReference*>(b);
+			return other != nullptr && other->slot == varRef->slot;
+		}
+		if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(a))
+		{
+			const BinaryExpression* other = dynamic_cast<const BinaryExpression*>(b);
+			return other != nullptr && other->op == binExpr->op && same(binExpr->left, other->left)
+				&& same(binExpr->right, other->right);
+		}
+		return false;
+	}
+
+	// Literals and variables added, subtracted and multiplied by literals
+	bool isAffine(const Expression* expression)
+	{
+		if (dynamic_cast<const IntegerLiteral*>(expression) != nullptr
+			|| dynamic_cast<const VariableReference*>(expression) != nullptr)
+		{
+			return true;
+		}
+		const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression);
+		if (binExpr == nullptr || !isAffine(binExpr->left) || !isAffine(binExpr->right))
+		{
+			return false;
+		}
+		return binExpr->op == "+" || binExpr->op == "-"
+			|| (binExpr->op == "*" && (dynamic_cast<const IntegerLiteral*>(binExpr->left) != nullptr
+				|| dynamic_cast<const IntegerLiteral*>(binExpr->right) != nullptr));
+	}
+}
+
+LoopFuser::LoopFuser()
+	: fusedCount(0)
+{
+}
+
+void LoopFuser::reset()
+{
+	fusedCount = 0;
+}
+
+void LoopFuser::run(ProgramNode* program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	fuseBlock(program->statements);
+}
+
+void LoopFuser::runTopLevel(Statement* statement)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+	{
+		fuseBlock(ifStmt->thenStatements);
+		fuseBlock(ifStmt->elseStatements);
+	}
+	else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+	{
+		fuseBlock(whileStmt->bodyStatements);
+	}
+}
+
+void LoopFuser::fuseBlock(vector<Statement*>& statements)
+{
+	if (settings.maxVariables == 0)
+	{
+		return;
+	}
+
+	// Inner loops first
+	for (auto* statement : statements)
+	{
+		runTopLevel(statement);
+	}
+
+	for (size_t i = 0; i < statements.size(); i++)
+	{
+		if (dynamic_cast<WhileStatement*>(statements[i]) == nullptr)
+		{
+			continue;
+		}
+
+		// Into this loop, each following one it can be fused with
+		for (;;)
+		{
+			size_t next = i + 1;
+			while (next < statements.size() && isStore(statements[next]))
+			{
+				next++;
+			}
+			if (next == statements.size() || dynamic_cast<WhileStatement*>(statements[next]) == nullptr
+				|| !fuse(statements, i, next))
+			{
+				break;
+			}
+		}
+	}
+}
+
+bool LoopFuser::fuse(vector<Statement*>& statements, size_t& first, size_t second)
+{
+	WhileStatement* loop = static_cast<WhileStatement*>(statements[first]);
+	WhileStatement* next = static_cast<WhileStatement*>(statements[second]);
+	Counter counter;
+	Counter nextCounter;
+	if (!isCounter(loop, counter) || !isCounter(next, nextCounter) || *counter.compare != *nextCounter.compare
+		|| counter.step != nextCounter.step || !same(counter.bound, nextCounter.bound))
+	{
+		return false;
+	}
+
+	// Both counters start at the same value
+	const Expression* start = startOf(statements, first, counter.slot);
+	const Expression* nextStart = nullptr;
+	size_t reset = second;
+	for (size_t k = first + 1; k < second; k++)
+	{
+		if (storedSlot(statements[k]) == nextCounter.slot)
+		{
+			nextStart = storedValue(statements[k]);
+			reset = k;
+		}
+	}
+	if (start == nullptr || nextStart == nullptr || !same(start, nextStart))
+	{
+		return false;
+	}
+	bool shared = counter.slot == nextCounter.slot;
+
+	Summary summary = { false, false, true };
+	Summary nextSummary = { false, false, true };
+	summarize(loop->condition, firstRead, summary);
+	summarize(loop->bodyStatements, firstRead, summary);
+	summarize(next->condition, secondRead, nextSummary);
+	summarize(next->bodyStatements, secondRead, nextSummary);
+
+	bool fusible = touched.size() <= settings.maxVariables && summary.affine == nextSummary.affine
+		&& !(summary.inputOutput && nextSummary.inputOutput)
+		&& !(summary.nested && nextSummary.inputOutput) && !(nextSummary.nested && summary.inputOutput);
+	for (int slot : touched)
+	{
+		unsigned char bits = access[slot];
+		if ((shared && slot == counter.slot) || !fusible)
+		{
+			continue;
+		}
+		fusible = !((bits & firstStored) && (bits & (secondRead | secondStored)))
+			&& !((bits & secondStored) && (bits & firstRead));
+	}
+
+	// The bound and the start keep their values; the stores between the
+	// loops can run before the first
+	fixed.clear();
+	collectSlots(counter.bound, fixed);
+	collectSlots(start, fixed);
+	for (int slot : fixed)
+	{
+		fusible &= static_cast<size_t>(slot) >= access.size() || (access[slot] & (firstStored | secondStored)) == 0;
+	}
+	for (size_t k = first + 1; fusible && k < second; k++)
+	{
+		if (shared && k == reset)
+		{
+			continue;
+		}
+		int slot = storedSlot(statements[k]);
+		fusible = (static_cast<size_t>(slot) >= access.size() || (access[slot] & (firstRead | firstStored)) == 0)
+			&& !changes(loop, storedValue(statements[k]));
+		for (int fixedSlot : fixed)
+		{
+			fusible &= fixedSlot != slot;
+		}
+	}
+	clearAccess();
+	if (!fusible)
+	{
+		return false;
+	}
+
+	// One body after the other; a shared counter is increased once, last
+	vector<Statement*>& body = loop->bodyStatements;
+	vector<Statement*>& nextBody = next->bodyStatements;
+	if (shared)
+	{
+		Statement* increment = body.back();
+		body.pop_back();
+		delete nextBody.back();
+		nextBody.pop_back();
+		body.insert(body.end(), nextBody.begin(), nextBody.end());
+		body.push_back(increment);
+	}
+	else
+	{
+		body.insert(body.end(), nextBody.begin(), nextBody.end());
+	}
+	nextBody.clear();
+	delete next;
+
+	between.clear();
+	for (size_t k = first + 1; k < second; k++)
+	{
+		if (shared && k == reset)
+		{
+			delete statements[k];
+		}
+		else
+		{
+			between.push_back(statements[k]);
+		}
+	}
+	statements.erase(statements.begin() + first + 1, statements.begin() + second + 1);
+	statements.insert(statements.begin() + first, between.begin(), between.end());
+	first += between.size();
+	fusedCount++;
+	return true;
+}
+
+bool LoopFuser::isCounter(const WhileStatement* loop, Counter& counter) const
+{
+	const VariableReference* variable = dynamic_cast<const VariableReference*>(loop->condition->left);
+	const vector<Statement*>& body = loop->bodyStatements;
+	if (variable == nullptr || body.empty())
+	{
+		return false;
+	}
+	const string& compare = loop->condition->op;
+	bool up = compare == "<" || compare == "<=";
+	if ((!up && compare != ">" && compare != ">=") || DeadCodeEliminator::hasSideEffects(loop->condition->right)
+		|| readsSlot(loop->condition->right, variable->slot))
+	{
+		return false;
+	}
+
+	// i = i + c or i = i - c last, toward the bound
+	const AssignmentStatement* increment = dynamic_cast<const AssignmentStatement*>(body.back());
+	const BinaryExpression* sum = increment != nullptr && increment->slot == variable->slot
+		? dynamic_cast<const BinaryExpression*>(increment->expression) : nullptr;
+	const VariableReference* counted = sum != nullptr ? dynamic_cast<const VariableReference*>(sum->left) : nullptr;
+	const IntegerLiteral* step = sum != nullptr ? dynamic_cast<const IntegerLiteral*>(sum->right) : nullptr;
+	if (counted == nullptr || step == nullptr || counted->slot != variable->slot || (sum->op != "+" && sum->op != "-"))
+	{
+		return false;
+	}
+	long long delta = sum->op == "+" ? step->value : -static_cast<long long>(step->value);
+	if (delta == 0 || (delta > 0) != up || delta < INT_MIN || delta > INT_MAX)
+	{
+		return false;
+	}
+	for (size_t k = 0; k + 1 < body.size(); k++)
+	{
+		if (storesTo(body[k], variable->slot))
+		{
+			return false;
+		}
+	}
+
+	counter.slot = variable->slot;
+	counter.compare = &compare;
+	counter.bound = loop->condition->right;
+	counter.step = static_cast<int>(delta);
+	return true;
+}
+
+const Expression* LoopFuser::startOf(const vector<Statement*>& statements, size_t loop, int slot) const
+{
+	for (size_t k = loop; k-- > 0;)
+	{
+		if (storedSlot(statements[k]) == slot)
+		{
+			if (!isStore(statements[k]))
+			{
+				return nullptr;
+			}
+
+			// What it reads does not change before the loop
+			const Expression* start = storedValue(statements[k]);
+			for (size_t after = k + 1; after < loop; after++)
+			{
+				if (changes(statements[after], start))
+				{
+					return nullptr;
+				}
+			}
+			return start;
+		}
+		if (storesTo(statements[k], slot))
+		{
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+void LoopFuser::summarize(const vector<Statement*>& statements, unsigned char readBit, Summary& summary)
+{
+	unsigned char storedBit = static_cast<unsigned char>(readBit << 1);
+	for (const Statement* statement : statements)
+	{
+		int slot = storedSlot(statement);
+		if (slot >= 0)
+		{
+			mark(slot, storedBit);
+			summarize(storedValue(statement), readBit, summary);
+			summary.affine &= isAffine(storedValue(statement));
+		}
+		else if (const PrintStatement* print = dynamic_cast<const PrintStatement*>(statement))
+		{
+			summarize(print->expression, readBit, summary);
+			summary.inputOutput = true;
+			summary.affine = false;
+		}
+		else if (const PrintLineStatement* println = dynamic_cast<const PrintLineStatement*>(statement))
+		{
+			summarize(println->expression, readBit, summary);
+			summary.inputOutput = true;
+			summary.affine = false;
+		}
+		else if (const IfStatement* ifStmt = dynamic_cast<const IfStatement*>(statement))
+		{
+			summarize(ifStmt->condition, readBit, summary);
+			summarize(ifStmt->thenStatements, readBit, summary);
+			summarize(ifStmt->elseStatements, readBit, summary);
+			summary.affine = false;
+		}
+		else if (const WhileStatement* whileStmt = dynamic_cast<const WhileStatement*>(statement))
+		{
+			summarize(whileStmt->condition, readBit, summary);
+			summarize(whileStmt->bodyStatements, readBit, summary);
+			summary.nested = true;
+			summary.affine = false;
+		}
+	}
+}
+
+void LoopFuser::summarize(const Expression* expression, unsigned char readBit, Summary& summary)
+{
+	if (const VariableReference* varRef = dynamic_cast<const VariableReference*>(expression))
+	{
+		mark(varRef->slot, readBit);
+	}
+	else if (dynamic_cast<const InputIntExpression*>(expression) != nullptr)
+	{
+		summary.inputOutput = true;
+	}
+	else if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expression))
+	{
+		summarize(binExpr->left, readBit, summary);
+		summarize(binExpr->right, readBit, summary);
+	}
+	else if (const BooleanExpression* boolExpr = dynamic_cast<const BooleanExpression*>(expression))
+	{
+		summarize(boolExpr->left, readBit, summary);
+		summarize(boolExpr->right, readBit, summary);
+	}
+}
+
+void LoopFuser::mark(int slot, unsigned char bit)
+{
+	if (access.size() <= static_cast<size_t>(slot))
+	{
+		access.resize(slot + 1, 0);
+	}
+	if (access[slot] == 0)
+	{
+		touched.push_back(slot);
+	}
+	access[slot] |= bit;
+}
+
+void LoopFuser::clearAccess()
+{
+	for (int slot : touched)
+	{
+		access[slot] = 0;
+	}
+	touched.clear();
+}
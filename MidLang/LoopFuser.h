@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AST.h"
+
+/**
+ * How large a loop LoopFuser may make.
+ */
+struct FusionSettings
+{
+	size_t maxVariables;	// most variables a fused loop may use, about what registers hold; 0 for no fusion
+
+	FusionSettings() : maxVariables(12) {}
+};
+
+/**
+ * LoopFuser (Optimization pass)
+ *
+ * Purpose: Merges two while loops that count through the same values, so
+ * that the test and jump of each iteration are paid once:
+ *     var i = 0; while (i < n) { a = a + i * i; i = i + 1; }
+ *     var j = 0; while (j < n) { println(j * 3); j = j + 1; }
+ * becomes
+ *     var i = 0; var j = 0;
+ *     while (i < n) { a = a + i * i; i = i + 1; println(j * 3); j = j + 1; }
+ *
+ * How it works:
+ * 1. A loop counts if its condition compares a variable with a bound
+ *    (i < n, i <= n, i > n or i >= n), and its body ends with i = i + c
+ *    or i = i - c, moving toward the bound, and stores i nowhere else
+ * 2. Two counting loops in one statement list, with only stores between
+ *    them, run equally often if their counters start at the same value
+ *    (an expression of literals and variables that do not change in
+ *    between), step by the same constant and are compared the same way
+ *    with the same bound, which neither loop changes. The start of the
+ *    first is the last store to its counter before it; the second's is
+ *    the last store between the loops
+ * 3. The loops must be independent: neither stores a variable that the
+ *    other reads or stores (except a counter they share), and at most one
+ *    of them prints or reads input, so the output keeps its order. The
+ *    stores between them must not depend on the first loop either; they
+ *    move before it
+ * 4. The second body is appended to the first. With a shared counter, its
+ *    reset between the loops is dropped and one increment ends the body.
+ *    The fused loop may then fuse with the loop after it
+ *
+ * Cost model: loops are not fused when the fused loop would use more than
+ * settings.maxVariables variables, which would no longer fit in
+ * registers, nor when only one of them just adds up multiples of its
+ * variables, since LoopCollapser can replace that one by a formula on its
+ * own. A loop with a nested loop, which might not end, is not fused with
+ * one that prints or reads input.
+ *
+ * The pass needs the slots assigned by Resolver. When streaming, only
+ * loops nested in one top-level statement are fused.
+ */
+class LoopFuser
+{
+	// What a loop reads and does
+	struct Summary
+	{
+		bool inputOutput;	// prints or reads input
+		bool nested;		// contains a while loop
+		bool affine;		// only stores sums of variables times constants
+	};
+
+	// i < bound ... i = i + step
+	struct Counter
+	{
+		int slot;
+		const std::string* compare;
+		const Expression* bound;
+		int step;
+	};
+
+	std::vector<unsigned char> access;	// by slot: read and stored bits of both loops
+	std::vector<int> touched;			// slots with access bits set
+	std::vector<int> fixed;				// slots of the bound and the start value
+	std::vector<Statement*> between;
+
+	void fuseBlock(vector<Statement*>& statements);
+	bool fuse(vector<Statement*>& statements, size_t& first, size_t second);
+	bool isCounter(const WhileStatement* loop, Counter& counter) const;
+	const Expression* startOf(const vector<Statement*>& statements, size_t loop, int slot) const;
+	void summarize(const vector<Statement*>& statements, unsigned char readBit, Summary& summary);
+	void summarize(const Expression* expression, unsigned char readBit, Summary& summary);
+	void mark(int slot, unsigned char bit);
+	void clearAccess();
+
+public:
+	FusionSettings settings;
+
+	// Statistics since the last reset()
+	size_t fusedCount;		// loops merged into the loop before them
+
+	LoopFuser();
+
+	/**
+	 * Clears the statistics, keeping the settings and internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Fuses the loops of a whole resolved program in place.
+	 */
+	void run(ProgramNode* program);
+
+	/**
+	 * Fuses the loops nested in one top-level statement of a streamed
+	 * program.
+	 */
+	void runTopLevel(Statement* statement);
+};
@@ -0,0 +1,154 @@
+#include "LoopInvariantMotion.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+
+using namespace std;
+
+LoopInvariantMotion::LoopInvariantMotion()
+	: loopNumber(0), hoistedCount(0)
+{
+}
+
+void LoopInvariantMotion::reset()
+{
+	hoistedCount = 0;
+}
+
+void LoopInvariantMotion::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	// A loop needs at least a header and a block after it
+	if (program.blocks.size() < 2)
+	{
+		return;
+	}
+
+	graph.build(program);
+	loopOf.assign(program.blocks.size(), -1);
+	if (storedIn.size() < program.variableNames.size())
+	{
+		storedIn.resize(program.variableNames.size(), -1);
+	}
+	definedIn.assign(program.temporaryCount, -1);
+	hoisted.assign(program.temporaryCount, 0);
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		for (const IrInstruction& instruction : program.blocks[b].instructions)
+		{
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+			{
+				definedIn[instruction.dest.value] = static_cast<int>(b);
+			}
+		}
+	}
+
+	// An inner header comes after its outer one in reverse postorder
+	for (size_t i = graph.order.size(); i-- > 0;)
+	{
+		processLoop(program, graph.order[i]);
+	}
+}
+
+void LoopInvariantMotion::processLoop(IrProgram& program, int header)
+{
+	if (!graph.collectLoop(header, members, loopOf))
+	{
+		return;
+	}
+	int preheader = graph.findPreheader(program, header, loopOf);
+	if (preheader < 0)
+	{
+		return;
+	}
+
+	loopNumber++;
+	for (int block : members)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Variable)
+			{
+				storedIn[instruction.dest.value] = loopNumber;
+			}
+		}
+	}
+
+	// In reverse postorder, a temporary is seen hoisted before its uses
+	sort(members.begin(), members.end(),
+		[this](int a, int b) { return graph.orderNumber[a] < graph.orderNumber[b]; });
+
+	vector<IrInstruction>& before = program.blocks[preheader].instructions;
+	for (int block : members)
+	{
+		vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		kept.clear();
+		for (const IrInstruction& instruction : instructions)
+		{
+			if (!canHoist(instruction, header))
+			{
+				kept.push_back(instruction);
+				continue;
+			}
+
+			// The preheader also runs when the loop does not, where the
+			// result may overflow; it wraps around instead
+			IrInstruction moved = instruction;
+			moved.wraps = moved.opcode == IrOpcode::Add || moved.opcode == IrOpcode::Subtract
+				|| moved.opcode == IrOpcode::Multiply;
+			if (instruction.dest.kind == IrOperand::Variable)
+			{
+				// The store stays in the loop, from a temporary
+				moved.dest = IrOperand::temporary(program.newTemporary());
+				definedIn.push_back(preheader);
+				hoisted.push_back(0);
+
+				IrInstruction copy(IrOpcode::Copy);
+				copy.dest = instruction.dest;
+				copy.left = moved.dest;
+				kept.push_back(copy);
+			}
+			else
+			{
+				definedIn[moved.dest.value] = preheader;
+			}
+			before.insert(before.end() - 1, moved);
+			if (!hoisted[moved.dest.value])
+			{
+				hoisted[moved.dest.value] = 1;	// counted once, however many loops it leaves
+				hoistedCount++;
+			}
+		}
+		instructions.swap(kept);
+	}
+}
+
+bool LoopInvariantMotion::isInvariant(const IrOperand& operand, int header) const
+{
+	switch (operand.kind)
+	{
+	case IrOperand::Constant:
+		return true;
+	case IrOperand::Variable:
+		return storedIn[operand.value] != loopNumber;
+	case IrOperand::Temporary:
+		return definedIn[operand.value] >= 0 && loopOf[definedIn[operand.value]] != header;
+	default:
+		return false;
+	}
+}
+
+bool LoopInvariantMotion::canHoist(const IrInstruction& instruction, int header) const
+{
+	if (!IrProgram::isArithmetic(instruction.opcode))
+	{
+		return false;
+	}
+	if (instruction.opcode == IrOpcode::Divide
+		&& (instruction.right.kind != IrOperand::Constant || instruction.right.value == 0 || instruction.right.value == -1))
+	{
+		return false;	// x / 0 and INT_MIN / -1 trap
+	}
+	return isInvariant(instruction.left, header) && isInvariant(instruction.right, header);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * LoopInvariantMotion (Optimization pass on the IR)
+ *
+ * Purpose: Computes expressions whose value cannot change while a loop
+ * runs once before the loop, instead of on every iteration.
+ *
+ * How it works:
+ * 1. Finds each loop from the edges back to its header, and collects the
+ *    variables stored anywhere in it
+ * 2. An arithmetic instruction in the loop is invariant if each operand is
+ *    a constant, a variable the loop does not store, or a temporary
+ *    computed outside the loop or already hoisted
+ * 3. Invariant instructions move to the end of the preheader, the block
+ *    that jumps to the header from outside the loop; one that stores a
+ *    variable leaves a copy from a new temporary behind
+ * 4. Inner loops go first, so an expression can move out of several
+ *    loops at once
+ *
+ * inputInt() is never moved. A division is only moved if its divisor is a
+ * constant other than 0 and -1, since it would otherwise run even when
+ * the loop does not and could trap. For the same reason, a moved +, - or
+ * * wraps around rather than overflowing; RangeOptimizer turns that off
+ * again where the result is known to fit.
+ */
+class LoopInvariantMotion
+{
+	ControlFlowGraph graph;
+	std::vector<int> loopOf;			// by block: header of the loop being processed
+	std::vector<int> storedIn;			// by slot: number of the last loop found to store it
+	int loopNumber;						// of the loop being processed, counting across runs
+	std::vector<int> definedIn;			// by temporary: block
+	std::vector<char> hoisted;			// by temporary
+	std::vector<int> members;
+	std::vector<IrInstruction> kept;
+
+	void processLoop(IrProgram& program, int header);
+	bool isInvariant(const IrOperand& operand, int header) const;	// in the loop being processed
+	bool canHoist(const IrInstruction& instruction, int header) const;
+
+public:
+	// Statistics since the last reset()
+	size_t hoistedCount;
+
+	LoopInvariantMotion();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Hoists the loop invariants of a whole program or one fragment.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,454 @@
+#include "LoopUnroller.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	bool holds(long long left, IrCompare compare, long long right)
+	{
+		switch (compare)
+		{
+		case IrCompare::Equal: return left == right;
+		case IrCompare::NotEqual: return left != right;
+		case IrCompare::Less: return left < right;
+		case IrCompare::Greater: return left > right;
+		case IrCompare::LessEqual: return left <= right;
+		default: return left >= right;
+		}
+	}
+
+	// a compare b is b mirrored a
+	IrCompare mirror(IrCompare compare)
+	{
+		switch (compare)
+		{
+		case IrCompare::Less: return IrCompare::Greater;
+		case IrCompare::Greater: return IrCompare::Less;
+		case IrCompare::LessEqual: return IrCompare::GreaterEqual;
+		case IrCompare::GreaterEqual: return IrCompare::LessEqual;
+		default: return compare;
+		}
+	}
+}
+
+LoopUnroller::LoopUnroller()
+	: copyNumber(0), labelCounter(0), fullCount(0), partialCount(0), copiedInstructionCount(0),
+	  removedInstructionCount(0)
+{
+}
+
+void LoopUnroller::reset()
+{
+	labelCounter = 0;
+	fullCount = 0;
+	partialCount = 0;
+	copiedInstructionCount = 0;
+	removedInstructionCount = 0;
+}
+
+void LoopUnroller::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (program.blocks.size() < 2 || (settings.fullBudget == 0 && settings.factor < 2))
+	{
+		return;
+	}
+
+	int count = static_cast<int>(program.blocks.size());
+	graph.build(program);
+	loopOf.assign(count, -1);
+	position.assign(count, -1);
+	dropped.assign(count, 0);
+	insertedAfter.assign(count, -1);
+	insertedEnd.assign(count, -1);
+	temporaryOf.assign(program.temporaryCount, -1);
+	temporaryCopy.assign(program.temporaryCount, -1);
+
+	// Only innermost loops qualify, so the order does not matter. New
+	// blocks are appended, so the graph still describes the old ones
+	bool changed = false;
+	for (int header : graph.order)
+	{
+		changed |= unroll(program, header);
+	}
+	if (!changed)
+	{
+		return;
+	}
+
+	// Put the new blocks after the block they follow, which also keeps
+	// the open block of a fragment last
+	order.clear();
+	for (int block = 0; block < count; block++)
+	{
+		if (!dropped[block])
+		{
+			order.push_back(block);
+		}
+		for (int inserted = insertedAfter[block]; inserted >= 0 && inserted < insertedEnd[block]; inserted++)
+		{
+			order.push_back(inserted);
+		}
+	}
+	program.reorderBlocks(order);
+}
+
+bool LoopUnroller::unroll(IrProgram& program, int header)
+{
+	if (!graph.collectLoop(header, members, loopOf))
+	{
+		return false;
+	}
+	int preheader = graph.findPreheader(program, header, loopOf);
+	if (preheader < 0)
+	{
+		return false;
+	}
+
+	// The header only tests the condition
+	const vector<IrInstruction>& test = program.blocks[header].instructions;
+	if (test.size() != 1 || test[0].opcode != IrOpcode::Branch
+		|| (loopOf[test[0].target] == header) == (loopOf[test[0].falseTarget] == header))
+	{
+		return false;
+	}
+	bool continueIfTrue = loopOf[test[0].target] == header;
+	int entry = continueIfTrue ? test[0].target : test[0].falseTarget;
+	int exit = continueIfTrue ? test[0].falseTarget : test[0].target;
+
+	// Without inner loops, every body block runs at most once per iteration
+	body.clear();
+	size_t size = 0;
+	for (int block : members)
+	{
+		if (block == header)
+		{
+			continue;
+		}
+		for (int successor : graph.successors[block])
+		{
+			if (successor != header && (loopOf[successor] != header || graph.isBackEdge(block, successor)))
+			{
+				return false;
+			}
+		}
+		body.push_back(block);
+		size += program.blocks[block].instructions.size();
+	}
+	sort(body.begin(), body.end());
+	for (size_t i = 0; i < body.size(); i++)
+	{
+		position[body[i]] = static_cast<int>(i);
+	}
+
+	// counter compare bound, with the bound a constant
+	IrCompare compare = continueIfTrue ? test[0].compare : IrProgram::negate(test[0].compare);
+	IrOperand counter = test[0].left;
+	IrOperand bound = test[0].right;
+	if (counter.kind == IrOperand::Constant)
+	{
+		swap(counter, bound);
+		compare = mirror(compare);
+	}
+	if (counter.kind != IrOperand::Variable || bound.kind != IrOperand::Constant)
+	{
+		return false;
+	}
+
+	// One store to the counter, i = i + c, on every path around the loop
+	int step = 0;
+	int stores = 0;
+	int storeBlock = -1;
+	for (int block : body)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (!instruction.definesValue() || instruction.dest != counter)
+			{
+				continue;
+			}
+			stores++;
+			storeBlock = block;
+			const IrInstruction& update = definition(program, instruction);
+			bool constantRight = update.right.kind == IrOperand::Constant;
+			if (update.wraps)
+			{
+				stores++;
+			}
+			else if (update.opcode == IrOpcode::Add && update.left == counter && constantRight)
+			{
+				step = update.right.value;
+			}
+			else if (update.opcode == IrOpcode::Add && update.right == counter
+				&& update.left.kind == IrOperand::Constant)
+			{
+				step = update.left.value;
+			}
+			else if (update.opcode == IrOpcode::Subtract && update.left == counter && constantRight
+				&& update.right.value != INT_MIN)
+			{
+				step = -update.right.value;
+			}
+			else
+			{
+				stores++;
+			}
+		}
+	}
+	if (stores != 1)
+	{
+		return false;
+	}
+	for (int latch : graph.predecessors[header])
+	{
+		if (loopOf[latch] == header && !graph.dominates(storeBlock, latch))
+		{
+			return false;
+		}
+	}
+
+	int start;
+	if (!findStart(program, preheader, counter.value, start))
+	{
+		return false;
+	}
+	long long trips = tripCount(start, step, compare, bound.value);
+	if (trips < 0)
+	{
+		return false;
+	}
+
+	int factor = settings.factor;
+	bool full = settings.fullBudget > 0 && static_cast<unsigned long long>(trips) * size <= settings.fullBudget;
+	bool partial = !full && factor >= 2 && trips >= factor
+		&& size * static_cast<size_t>(factor) <= settings.partialBudget;
+	if (!full && !partial)
+	{
+		return false;
+	}
+
+	int first = static_cast<int>(program.blocks.size());
+	if (full)
+	{
+		// The original body is the first copy; the header is no longer needed
+		// The copies are made before the original stops jumping back
+		int copies = static_cast<int>(trips);
+		for (int copy = 1; copy < copies; copy++)
+		{
+			int next = copy + 1 < copies ? copyIndex(first + static_cast<int>(body.size()) * copy, entry) : exit;
+			copyBody(program, header, next, "_" + to_string(copy + 1));
+		}
+		for (int block : body)
+		{
+			retarget(program.blocks[block].instructions.back(), header, copies > 1 ? copyIndex(first, entry) : exit, -1);
+		}
+
+		program.blocks[preheader].instructions.back().target = copies > 0 ? entry : exit;
+		dropped[header] = 1;
+		removedInstructionCount++;
+		if (copies == 0)
+		{
+			for (int block : body)
+			{
+				dropped[block] = 1;
+			}
+			removedInstructionCount += size;
+		}
+		copiedInstructionCount += size * (copies > 1 ? copies - 1 : 0);
+		int anchor = body.back();
+		insertedAfter[anchor] = first;
+		insertedEnd[anchor] = static_cast<int>(program.blocks.size());
+		fullCount++;
+		return true;
+	}
+
+	// A loop of factor copies until the counter reaches its value after
+	// the largest multiple of factor iterations, then the original loop
+	long long done = trips / factor * factor;
+	int guard = program.addBlock("L_UNROLL", "_" + to_string(++labelCounter));
+	first = guard + 1;
+	IrInstruction branch(IrOpcode::Branch);
+	branch.left = counter;
+	branch.compare = IrCompare::NotEqual;
+	branch.right = IrOperand::constant(static_cast<int>(start + done * step));
+	branch.target = copyIndex(first, entry);
+	branch.falseTarget = header;
+	program.blocks[guard].instructions.push_back(branch);
+	for (int copy = 0; copy < factor; copy++)
+	{
+		int next = copy + 1 < factor ? copyIndex(first + static_cast<int>(body.size()) * (copy + 1), entry) : guard;
+		copyBody(program, header, next, "_U" + to_string(labelCounter) + "_" + to_string(copy + 1));
+	}
+
+	program.blocks[preheader].instructions.back().target = guard;
+	copiedInstructionCount += size * factor + 1;
+	insertedAfter[preheader] = guard;
+	insertedEnd[preheader] = static_cast<int>(program.blocks.size());
+	partialCount++;
+	return true;
+}
+
+const IrInstruction& LoopUnroller::definition(const IrProgram& program, const IrInstruction& instruction) const
+{
+	// Value numbering may leave i = t with t = i + c computed earlier in the body
+	if (instruction.opcode != IrOpcode::Copy || instruction.left.kind != IrOperand::Temporary)
+	{
+		return instruction;
+	}
+	for (int block : body)
+	{
+		for (const IrInstruction& candidate : program.blocks[block].instructions)
+		{
+			if (candidate.definesValue() && candidate.dest == instruction.left)
+			{
+				return candidate;
+			}
+		}
+	}
+	return instruction;
+}
+
+bool LoopUnroller::findStart(const IrProgram& program, int block, int slot, int& start) const
+{
+	// The last store before the loop, on the only path to it
+	while (true)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		for (size_t i = instructions.size(); i-- > 0;)
+		{
+			const IrInstruction& instruction = instructions[i];
+			if (instruction.definesValue() && instruction.dest == IrOperand::variable(slot))
+			{
+				if (instruction.opcode != IrOpcode::Copy || instruction.left.kind != IrOperand::Constant)
+				{
+					return false;
+				}
+				start = instruction.left.value;
+				return true;
+			}
+		}
+		if (graph.predecessors[block].size() != 1)
+		{
+			return false;
+		}
+		block = graph.predecessors[block][0];
+	}
+}
+
+long long LoopUnroller::tripCount(long long start, long long step, IrCompare compare, long long bound)
+{
+	if (!holds(start, compare, bound))
+	{
+		return 0;
+	}
+
+	long long trips;
+	switch (compare)
+	{
+	case IrCompare::Less:
+	case IrCompare::LessEqual:
+		if (step <= 0)
+		{
+			return -1;		// never ends, or only by overflowing
+		}
+		trips = (bound - start) / step + (compare == IrCompare::LessEqual || (bound - start) % step != 0 ? 1 : 0);
+		break;
+	case IrCompare::Greater:
+	case IrCompare::GreaterEqual:
+		if (step >= 0)
+		{
+			return -1;
+		}
+		trips = (start - bound) / -step + (compare == IrCompare::GreaterEqual || (start - bound) % -step != 0 ? 1 : 0);
+		break;
+	case IrCompare::Equal:
+		if (step == 0)
+		{
+			return -1;
+		}
+		trips = 1;
+		break;
+	default:
+		// Must land on the bound exactly
+		if (step == 0 || (bound - start) % step != 0 || (bound - start) / step < 0)
+		{
+			return -1;
+		}
+		trips = (bound - start) / step;
+		break;
+	}
+
+	// The counter is increased after the last test too
+	long long last = start + trips * step;
+	if (last < INT_MIN || last > INT_MAX)
+	{
+		return -1;
+	}
+	return trips;
+}
+
+int LoopUnroller::copyBody(IrProgram& program, int header, int next, const string& suffix)
+{
+	int first = static_cast<int>(program.blocks.size());
+	for (int block : body)
+	{
+		program.addBlock(program.blocks[block].label, suffix);
+	}
+
+	// Temporaries defined in the body are numbered anew in each copy
+	copyNumber++;
+	for (int block : body)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+			{
+				temporaryOf[instruction.dest.value] = program.newTemporary();
+				temporaryCopy[instruction.dest.value] = copyNumber;
+			}
+		}
+	}
+
+	for (int block : body)
+	{
+		vector<IrInstruction>& instructions = program.blocks[copyIndex(first, block)].instructions;
+		instructions = program.blocks[block].instructions;
+		for (IrInstruction& instruction : instructions)
+		{
+			for (IrOperand* operand : { &instruction.dest, &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary && static_cast<size_t>(operand->value) < temporaryCopy.size()
+					&& temporaryCopy[operand->value] == copyNumber)
+				{
+					operand->value = temporaryOf[operand->value];
+				}
+			}
+		}
+		retarget(instructions.back(), header, next, first);
+	}
+	return first;
+}
+
+void LoopUnroller::retarget(IrInstruction& instruction, int header, int next, int first) const
+{
+	for (int* target : { &instruction.target, &instruction.falseTarget })
+	{
+		if (*target < 0)
+		{
+			continue;
+		}
+		if (*target == header)
+		{
+			*target = next;
+		}
+		else if (first >= 0)
+		{
+			*target = copyIndex(first, *target);
+		}
+	}
+}
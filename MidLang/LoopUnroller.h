@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * How much code LoopUnroller may add.
+ */
+struct UnrollSettings
+{
+	size_t fullBudget;		// most body instructions, over all iterations, of a fully unrolled loop; 0 for none
+	int factor;				// body copies per test of a partially unrolled loop; 1 for none
+	size_t partialBudget;	// most body instructions, over all copies, of a partially unrolled loop
+
+	UnrollSettings() : fullBudget(64), factor(4), partialBudget(64) {}
+};
+
+/**
+ * LoopUnroller (Optimization pass on the IR)
+ *
+ * Purpose: Saves the test and jump of each iteration of a loop whose
+ * number of iterations is known when compiling, such as
+ *     var x = 0; while (x < 5) { println(x); x = x + 1; }
+ *
+ * How it works:
+ * 1. Takes innermost loops whose header only tests a variable against a
+ *    constant, where that variable is changed once per iteration by
+ *    i = i + c and is set to a constant before the loop. The number of
+ *    iterations n follows from those three constants
+ * 2. Full unrolling: if n copies of the body fit in fullBudget, the body
+ *    is repeated n times with the test left out. Each copy gets its own
+ *    blocks and temporaries
+ * 3. Partial unrolling: otherwise, if factor copies fit in partialBudget,
+ *    a new loop runs factor copies of the body per test, while the
+ *    counter has not reached its value after the largest multiple of
+ *    factor iterations. The original loop follows and runs the rest
+ *
+ * Loops that would overflow their counter or never end are left alone.
+ */
+class LoopUnroller
+{
+	ControlFlowGraph graph;
+	std::vector<int> loopOf;
+	std::vector<int> members;
+	std::vector<int> body;				// members other than the header, in block order
+	std::vector<int> position;			// by block: index in body
+	std::vector<char> dropped;			// by block
+	std::vector<int> insertedAfter;		// by block: first block inserted after it, or -1
+	std::vector<int> insertedEnd;
+	std::vector<int> order;
+	std::vector<int> temporaryOf;		// by temporary: its number in the copy being made
+	std::vector<int> temporaryCopy;		// by temporary: copy temporaryOf belongs to
+	int copyNumber;						// counting across runs
+	int labelCounter;
+
+	bool unroll(IrProgram& program, int header);
+	const IrInstruction& definition(const IrProgram& program, const IrInstruction& instruction) const;
+	bool findStart(const IrProgram& program, int block, int slot, int& start) const;
+	static long long tripCount(long long start, long long step, IrCompare compare, long long bound);
+	int copyBody(IrProgram& program, int header, int next, const std::string& suffix);	// returns the first new block
+	void retarget(IrInstruction& instruction, int header, int next, int first) const;
+	int copyIndex(int first, int block) const { return first + position[block]; }
+
+public:
+	UnrollSettings settings;
+
+	// Statistics since the last reset()
+	size_t fullCount;				// loops unrolled completely
+	size_t partialCount;			// loops unrolled by settings.factor
+	size_t copiedInstructionCount;	// instructions in the added copies
+	size_t removedInstructionCount;	// instructions of removed tests and bodies
+
+	LoopUnroller();
+
+	/**
+	 * Clears the statistics and the label numbering, keeping the settings
+	 * and internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Unrolls the loops of a whole program or one fragment.
+	 */
+	void run(IrProgram& program);
+};
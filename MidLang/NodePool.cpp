@@ -0,0 +1,91 @@
+#include "NodePool.h"
+#include <new>
+
+namespace
+{
+	const size_t granularity = 16;
+	const size_t sizeClassCount = 8;		// pools nodes of up to 128 bytes
+	const size_t maxPooledBlocks = 4096;	// per size class and thread
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	/**
+	 * Free lists of one thread. Blocks left over when the thread ends
+	 * are returned to the heap, as are blocks released after that (by
+	 * objects that outlive the thread's free lists).
+	 */
+	struct FreeLists
+	{
+		FreeBlock* heads[sizeClassCount] = {};
+		size_t counts[sizeClassCount] = {};
+
+		~FreeLists()
+		{
+			for (FreeBlock* head : heads)
+			{
+				while (head != nullptr)
+				{
+					FreeBlock* next = head->next;
+					::operator delete(head);
+					head = next;
+				}
+			}
+			for (size_t index = 0; index < sizeClassCount; index++)
+			{
+				heads[index] = nullptr;
+				counts[index] = maxPooledBlocks;
+			}
+		}
+	};
+
+	thread_local FreeLists freeLists;
+
+	size_t sizeClass(size_t size)
+	{
+		return (size + granularity - 1) / granularity - 1;
+	}
+}
+
+void* NodePool::allocate(size_t size)
+{
+	size_t index = sizeClass(size);
+	if (index >= sizeClassCount)
+	{
+		return ::operator new(size);
+	}
+
+	FreeBlock* block = freeLists.heads[index];
+	if (block == nullptr)
+	{
+		return ::operator new((index + 1) * granularity);
+	}
+
+	freeLists.heads[index] = block->next;
+	freeLists.counts[index]--;
+	return block;
+}
+
+void NodePool::release(void* block, size_t size)
+{
+	if (block == nullptr)
+	{
+		return;
+	}
+
+	// Nodes may be freed on another thread than the one that made them
+	// (see Pipeline), so cap each list rather than let it grow unbounded
+	size_t index = sizeClass(size);
+	if (index >= sizeClassCount || freeLists.counts[index] >= maxPooledBlocks)
+	{
+		::operator delete(block);
+		return;
+	}
+
+	FreeBlock* freed = static_cast<FreeBlock*>(block);
+	freed->next = freeLists.heads[index];
+	freeLists.heads[index] = freed;
+	freeLists.counts[index]++;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+/**
+ * Recycles small blocks of memory (per thread, per size): the AST nodes,
+ * and the nodes of the maps and sets that the compiler keeps between
+ * programs. A long-running process that compiles many programs stops
+ * allocating once it has warmed up.
+ */
+class NodePool
+{
+public:
+	static void* allocate(size_t size);
+	static void release(void* block, size_t size);
+};
+
+/**
+ * Allocator that takes memory from NodePool, so a map or set that is
+ * cleared or erased from keeps its nodes for the next program.
+ */
+template <typename T>
+class NodePoolAllocator
+{
+public:
+	using value_type = T;
+
+	NodePoolAllocator() = default;
+
+	template <typename U>
+	NodePoolAllocator(const NodePoolAllocator<U>&)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(NodePool::allocate(count * sizeof(T)));
+	}
+
+	void deallocate(T* block, size_t count)
+	{
+		NodePool::release(block, count * sizeof(T));
+	}
+
+	template <typename U>
+	bool operator==(const NodePoolAllocator<U>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const NodePoolAllocator<U>&) const { return false; }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+using PooledMap = std::unordered_map<Key, Value, Hash, std::equal_to<Key>,
+	NodePoolAllocator<std::pair<const Key, Value>>>;
+
+template <typename Key, typename Hash = std::hash<Key>>
+using PooledSet = std::unordered_set<Key, Hash, std::equal_to<Key>, NodePoolAllocator<Key>>;
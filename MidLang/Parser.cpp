@@ -1,27 +1,74 @@
 #include "Parser.h"
+#include "AllocProfiler.h"
 #include <stdexcept>
 #include <sstream>
 using namespace std;
 
+Parser::Parser()
+	: tokens(&window), current(0), source(nullptr)
+{
+	window.emplace_back(TokenType::EOF_TOKEN, "", 1, 1);
+}
+
 Parser::Parser(const vector<Token>& tokens)
-	: tokens(tokens), current(0)
+	: tokens(&tokens), current(0), source(nullptr)
+{
+}
+
+Parser::Parser(TokenSource& source)
+	: tokens(&window), current(0), source(&source)
 {
 }
 
+Parser::~Parser()
+{
+	deleteStatements();
+}
+
+void Parser::reset(const vector<Token>& tokens)
+{
+	this->tokens = &tokens;
+	current = 0;
+	source = nullptr;
+	deleteStatements();
+}
+
 ProgramNode* Parser::parse()
 {
-	vector<Statement*> statements;
+	MIDLANG_ALLOC_PHASE(AllocPhase::Parse);
+	size_t mark = statementStack.size();
 
 	while (!isAtEnd())
 	{
-		statements.push_back(parseStatement());
+		MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+		statementStack.push_back(parseStatement());
 	}
 
-	return new ProgramNode(statements);
+	return new ProgramNode(takeStatements(mark));
+}
+
+Statement* Parser::parseNext()
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Parse);
+
+	// Drop the tokens of the previous statement, keeping the last one for previous()
+	if (source != nullptr && current > 1)
+	{
+		window.erase(window.begin(), window.begin() + (current - 1));
+		current = 1;
+	}
+
+	if (isAtEnd())
+	{
+		return nullptr;
+	}
+	return parseStatement();
 }
 
 Statement* Parser::parseStatement()
 {
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::AstNodes);
+
 	if (match(TokenType::VAR))
 	{
 		return parseVarDeclaration();
@@ -47,95 +94,113 @@ Statement* Parser::parseStatement()
 
 VarDeclarationStatement* Parser::parseVarDeclaration()
 {
-	Token identifier = consume(TokenType::IDENTIFIER, "Expected variable name after 'var'");
+	const Token& nameToken = consume(TokenType::IDENTIFIER, "Expected variable name after 'var'");
+	string name = nameToken.value;
+	int line = nameToken.line;
+	int column = nameToken.column;
 	consume(TokenType::ASSIGN, "Expected '=' after variable name");
-	auto expression = parseExpression();
+	unique_ptr<Expression> expression(parseExpression());
 	consume(TokenType::SEMICOLON, "Expected ';' after expression");
 
-	return new VarDeclarationStatement(identifier.value, expression);
+	auto declaration = new VarDeclarationStatement(move(name), expression.release());
+	declaration->line = line;
+	declaration->column = column;
+	return declaration;
 }
 
 AssignmentStatement* Parser::parseAssignmentStatement()
 {
-	Token identifier = consume(TokenType::IDENTIFIER, "Expected variable name");
+	const Token& nameToken = consume(TokenType::IDENTIFIER, "Expected variable name");
+	string name = nameToken.value;
+	int line = nameToken.line;
+	int column = nameToken.column;
 	consume(TokenType::ASSIGN, "Expected '=' after variable name");
-	auto expression = parseExpression();
+	unique_ptr<Expression> expression(parseExpression());
 	consume(TokenType::SEMICOLON, "Expected ';' after expression");
 
-	return new AssignmentStatement(identifier.value, expression);
+	auto assignment = new AssignmentStatement(move(name), expression.release());
+	assignment->line = line;
+	assignment->column = column;
+	return assignment;
 }
 
 PrintStatement* Parser::parsePrintStatement()
 {
 	consume(TokenType::LEFT_PAREN, "Expected '(' after 'print'");
-	auto expression = parseExpression();
+	unique_ptr<Expression> expression(parseExpression());
 	consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
 	consume(TokenType::SEMICOLON, "Expected ';' after ')'");
 
-	return new PrintStatement(expression);
+	return new PrintStatement(expression.release());
 }
 
 PrintLineStatement* Parser::parsePrintLineStatement()
 {
 	consume(TokenType::LEFT_PAREN, "Expected '(' after 'println'");
-	auto expression = parseExpression();
+	unique_ptr<Expression> expression(parseExpression());
 	consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
 	consume(TokenType::SEMICOLON, "Expected ';' after ')'");
 
-	return new PrintLineStatement(expression);
+	return new PrintLineStatement(expression.release());
 }
 
 IfStatement* Parser::parseIfStatement()
 {
 	consume(TokenType::LEFT_PAREN, "Expected '(' after 'if'");
-	BooleanExpression* condition = parseBooleanExpression();
+	unique_ptr<BooleanExpression> condition(parseBooleanExpression());
 	consume(TokenType::RIGHT_PAREN, "Expected ')' after condition");
 	consume(TokenType::LEFT_BRACE, "Expected '{' after ')'");
 
 	// Parse then block
-	vector<Statement*> thenStatements;
+	size_t mark = statementStack.size();
 	while (!check(TokenType::RIGHT_BRACE) && !isAtEnd())
 	{
-		thenStatements.push_back(parseStatement());
+		MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+		statementStack.push_back(parseStatement());
 	}
 	consume(TokenType::RIGHT_BRACE, "Expected '}' after if block");
 
-	// Parse else block (optional)
-	vector<Statement*> elseStatements;
+	// Parse else block (optional). Both blocks stay on the stack until
+	// the statement is complete, so an error in the else block frees them
+	size_t elseMark = statementStack.size();
 	if (match(TokenType::ELSE))
 	{
 		consume(TokenType::LEFT_BRACE, "Expected '{' after 'else'");
 		while (!check(TokenType::RIGHT_BRACE) && !isAtEnd())
 		{
-			elseStatements.push_back(parseStatement());
+			MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+			statementStack.push_back(parseStatement());
 		}
 		consume(TokenType::RIGHT_BRACE, "Expected '}' after else block");
 	}
+	vector<Statement*> elseStatements = takeStatements(elseMark);
+	vector<Statement*> thenStatements = takeStatements(mark);
 
-	return new IfStatement(condition, thenStatements, elseStatements);
+	return new IfStatement(condition.release(), move(thenStatements), move(elseStatements));
 }
 
 WhileStatement* Parser::parseWhileStatement()
 {
 	consume(TokenType::LEFT_PAREN, "Expected '(' after 'while'");
-	BooleanExpression* condition = parseBooleanExpression();
+	unique_ptr<BooleanExpression> condition(parseBooleanExpression());
 	consume(TokenType::RIGHT_PAREN, "Expected ')' after condition");
 	consume(TokenType::LEFT_BRACE, "Expected '{' after ')'");
 
 	// Parse body block
-	vector<Statement*> bodyStatements;
+	size_t mark = statementStack.size();
 	while (!check(TokenType::RIGHT_BRACE) && !isAtEnd())
 	{
-		bodyStatements.push_back(parseStatement());
+		MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+		statementStack.push_back(parseStatement());
 	}
 	consume(TokenType::RIGHT_BRACE, "Expected '}' after while block");
 
-	return new WhileStatement(condition, bodyStatements);
+	return new WhileStatement(condition.release(), takeStatements(mark));
 }
 
 BooleanExpression* Parser::parseBooleanExpression()
 {
-	Expression* left = parseExpression();
+	unique_ptr<Expression> left(parseExpression());
 
 	// Check for comparison operator
 	if (!match(TokenType::EQUAL_EQUAL, TokenType::NOT_EQUAL, TokenType::LESS, TokenType::GREATER, TokenType::LESS_EQUAL, TokenType::GREATER_EQUAL))
@@ -148,35 +213,36 @@ BooleanExpression* Parser::parseBooleanExpression()
 	string op = previous().value;
 	Expression* right = parseExpression();
 
-	return new BooleanExpression(left, op, right);
+	return new BooleanExpression(left.release(), op, right);
 }
 
 Expression* Parser::parseExpression()
 {
-	Expression* expr = parseTerm();
+	// Owned here until complete, so a syntax error further on frees it
+	unique_ptr<Expression> expr(parseTerm());
 
 	while (match(TokenType::PLUS) || match(TokenType::MINUS))
 	{
 		string op = previous().value;
 		auto right = parseTerm();
-		expr = new BinaryExpression(expr, op, right);
+		expr.reset(new BinaryExpression(expr.release(), op, right));
 	}
 
-	return expr;
+	return expr.release();
 }
 
 Expression* Parser::parseTerm()
 {
-	auto expr = parseFactor();
+	unique_ptr<Expression> expr(parseFactor());
 
 	while (match(TokenType::MULTIPLY) || match(TokenType::DIVIDE))
 	{
 		string op = previous().value;
 		auto right = parseFactor();
-		expr = new BinaryExpression(expr, op, right);
+		expr.reset(new BinaryExpression(expr.release(), op, right));
 	}
 
-	return expr;
+	return expr.release();
 }
 
 Expression* Parser::parseFactor()
@@ -196,14 +262,18 @@ Expression* Parser::parseFactor()
 
 	if (match(TokenType::IDENTIFIER))
 	{
-		return new VariableReference(previous().value);
+		const Token& nameToken = previous();
+		auto reference = new VariableReference(nameToken.value);
+		reference->line = nameToken.line;
+		reference->column = nameToken.column;
+		return reference;
 	}
 
 	if (match(TokenType::LEFT_PAREN))
 	{
-		auto expr = parseExpression();
+		unique_ptr<Expression> expr(parseExpression());
 		consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
-		return expr;
+		return expr.release();
 	}
 
 	stringstream ss;
@@ -241,7 +311,7 @@ bool Parser::check(TokenType type)
 	return peek().type == type;
 }
 
-Token Parser::advance()
+const Token& Parser::advance()
 {
 	if (!isAtEnd())
 	{
@@ -255,26 +325,56 @@ bool Parser::isAtEnd()
 	return peek().type == TokenType::EOF_TOKEN;
 }
 
-Token Parser::peek()
+const Token& Parser::peek()
 {
-	return tokens[current];
+	// When streaming, pull tokens from the source as they are needed
+	while (source != nullptr && current >= window.size())
+	{
+		MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+		window.push_back(source->next());
+	}
+	return (*tokens)[current];
 }
 
-Token Parser::previous()
+const Token& Parser::previous()
 {
-	return tokens[current - 1];
+	return (*tokens)[current - 1];
 }
 
-Token Parser::consume(TokenType type, const string& message)
+const Token& Parser::consume(TokenType type, const char* message)
 {
 	if (check(type))
 	{
 		return advance();
 	}
 
-	Token token = peek();
+	const Token& token = peek();
 	stringstream ss;
 	ss << message << " at line " << token.line << ", column " << token.column
 		<< ". Found: " << static_cast<int>(token.type);
 	throw runtime_error(ss.str());
 }
+
+vector<Statement*> Parser::takeStatements(size_t mark)
+{
+	// Move the statements of the finished block off the shared stack,
+	// into the storage of a list deleted before
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+	vector<Statement*> statements;
+	if (mark < statementStack.size())
+	{
+		statements = StatementListPool::take();
+		statements.assign(statementStack.begin() + mark, statementStack.end());
+	}
+	statementStack.resize(mark);
+	return statements;
+}
+
+void Parser::deleteStatements()
+{
+	for (Statement* statement : statementStack)
+	{
+		delete statement;
+	}
+	statementStack.clear();
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "Token.h"
+#include "Lexer.h"
 #include "AST.h"
 
 using namespace std;
@@ -29,19 +30,24 @@ using namespace std;
  */
 class Parser
 {
-	vector<Token> tokens;
+	const vector<Token>* tokens;	// not owned, or &window when streaming
+	vector<Token> window;			// tokens of the current statement when streaming
 	size_t current;
+	TokenSource* source;	// pulled from when streaming, null otherwise
+	vector<Statement*> statementStack;	// blocks being parsed, owned until taken; keeps its capacity
 
 	// Helper methods
 	bool match(TokenType type);
 	bool match(TokenType type1, TokenType type2);
 	bool match(TokenType type1, TokenType type2, TokenType type3, TokenType type4, TokenType type5, TokenType type6);
 	bool check(TokenType type);
-	Token advance();
+	const Token& advance();
 	bool isAtEnd();
-	Token peek();
-	Token previous();
-	Token consume(TokenType type, const string& message);
+	const Token& peek();
+	const Token& previous();
+	const Token& consume(TokenType type, const char* message);
+	vector<Statement*> takeStatements(size_t mark);
+	void deleteStatements();
 
 	// Parsing methods
 	Statement* parseStatement();
@@ -57,10 +63,41 @@ class Parser
 	BooleanExpression* parseBooleanExpression();
 
 public:
+	Parser();
+
+	/**
+	 * Parses the given tokens, which must outlive the parser.
+	 */
 	Parser(const vector<Token>& tokens);
 
+	/**
+	 * Pulls tokens from a Lexer (or other source) on demand. Only the
+	 * tokens of the statement being parsed are kept in memory.
+	 */
+	Parser(TokenSource& source);
+
+	/**
+	 * Deletes the statements of blocks left unfinished by a syntax error.
+	 */
+	~Parser();
+
+	Parser(const Parser&) = delete;
+	Parser& operator=(const Parser&) = delete;
+
+	/**
+	 * Starts over on a new token list, keeping internal buffers and
+	 * deleting what an earlier syntax error left unfinished.
+	 */
+	void reset(const vector<Token>& tokens);
+
 	/**
 	 * Parses the token stream and returns a Program AST node.
 	 */
 	ProgramNode* parse();
+
+	/**
+	 * Parses the next top-level statement, or returns nullptr at end of input.
+	 * The caller owns the returned statement.
+	 */
+	Statement* parseNext();
 };
@@ -0,0 +1,369 @@
+#include "PartialEvaluator.h"
+#include "AllocProfiler.h"
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	bool holds(int left, IrCompare compare, int right)
+	{
+		switch (compare)
+		{
+		case IrCompare::Equal: return left == right;
+		case IrCompare::NotEqual: return left != right;
+		case IrCompare::Less: return left < right;
+		case IrCompare::Greater: return left > right;
+		case IrCompare::LessEqual: return left <= right;
+		default: return left >= right;
+		}
+	}
+
+	// The exact result as an int, or false if it does not fit
+	bool narrow(long long exact, int& result)
+	{
+		if (exact < INT_MIN || exact > INT_MAX)
+		{
+			return false;
+		}
+		result = static_cast<int>(exact);
+		return true;
+	}
+}
+
+PartialEvaluator::PartialEvaluator()
+	: evaluatedCount(0), printedCount(0), presetCount(0)
+{
+}
+
+void PartialEvaluator::reset()
+{
+	evaluatedCount = 0;
+	printedCount = 0;
+	presetCount = 0;
+}
+
+void PartialEvaluator::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (program.fragment || settings.stepBudget == 0 || !usesLocalTemporaries(program))
+	{
+		return;
+	}
+
+	slotValues.assign(program.variableNames.size(), 0);
+	slotKnown.assign(program.variableNames.size(), 0);
+	temporaryValues.assign(program.temporaryCount, 0);
+	output.clear();
+
+	int block = 0;
+	size_t index = 0;
+	size_t steps = 0;
+	bool finished = execute(program, block, index, steps);
+	bool known = false;
+	for (char slot : slotKnown)
+	{
+		known |= slot != 0;
+	}
+	if (!finished && output.empty() && !known)
+	{
+		return;		// nothing worth keeping, such as an input right away
+	}
+
+	// The new entry: output so far, then on to the rest of the program
+	int entry = program.addBlock("L_EVALUATED");
+	if (!output.empty())
+	{
+		IrInstruction print(IrOpcode::PrintText);
+		print.left = IrOperand::constant(static_cast<int>(program.texts.size()));
+		program.texts.push_back(output);
+		program.blocks[entry].instructions.push_back(print);
+	}
+	if (finished)
+	{
+		program.blocks[entry].instructions.push_back(IrInstruction(IrOpcode::Return));
+	}
+	else
+	{
+		IrInstruction jump(IrOpcode::Jump);
+		jump.target = index == 0 ? block : resume(program, block, index);
+		program.blocks[entry].instructions.push_back(jump);
+	}
+	removeUnreachable(program, entry);
+
+	// Set the variables that what remains reads, before the jump
+	slotRead.assign(program.variableNames.size(), 0);
+	for (size_t b = 1; b < program.blocks.size(); b++)
+	{
+		for (const IrInstruction& instruction : program.blocks[b].instructions)
+		{
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable)
+				{
+					slotRead[operand->value] = 1;
+				}
+			}
+		}
+	}
+	vector<IrInstruction>& prelude = program.blocks[0].instructions;
+	for (size_t slot = 0; slot < slotKnown.size(); slot++)
+	{
+		if (slotKnown[slot] && slotRead[slot])
+		{
+			IrInstruction copy(IrOpcode::Copy);
+			copy.dest = IrOperand::variable(static_cast<int>(slot));
+			copy.left = IrOperand::constant(slotValues[slot]);
+			prelude.insert(prelude.end() - 1, copy);
+			presetCount++;
+		}
+	}
+
+	evaluatedCount += steps;
+	printedCount += output.size();
+}
+
+bool PartialEvaluator::usesLocalTemporaries(const IrProgram& program)
+{
+	definedIn.assign(program.temporaryCount, -1);
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		for (const IrInstruction& instruction : program.blocks[b].instructions)
+		{
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary && definedIn[operand->value] != static_cast<int>(b))
+				{
+					return false;
+				}
+			}
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+			{
+				definedIn[instruction.dest.value] = static_cast<int>(b);
+			}
+		}
+	}
+	return true;
+}
+
+bool PartialEvaluator::execute(const IrProgram& program, int& block, size_t& index, size_t& steps)
+{
+	for (; steps < settings.stepBudget; steps++)
+	{
+		const IrInstruction& instruction = program.blocks[block].instructions[index];
+		int left = 0;
+		int right = 0;
+		switch (instruction.opcode)
+		{
+		case IrOpcode::Input:
+			return false;
+		case IrOpcode::Print:
+		case IrOpcode::PrintLine:
+		case IrOpcode::PrintText:
+		{
+			size_t length = output.size();
+			if (instruction.opcode == IrOpcode::PrintText)
+			{
+				output += program.texts[instruction.left.value];
+			}
+			else if (load(instruction.left, left))
+			{
+				output += to_string(left);
+				if (instruction.opcode == IrOpcode::PrintLine)
+				{
+					output += '\n';
+				}
+			}
+			else
+			{
+				return false;
+			}
+			if (output.size() > settings.outputBudget)
+			{
+				output.resize(length);
+				return false;
+			}
+			index++;
+			break;
+		}
+		case IrOpcode::Jump:
+			block = instruction.target;
+			index = 0;
+			break;
+		case IrOpcode::Branch:
+			if (!load(instruction.left, left) || !load(instruction.right, right))
+			{
+				return false;
+			}
+			block = holds(left, instruction.compare, right) ? instruction.target : instruction.falseTarget;
+			index = 0;
+			break;
+		case IrOpcode::Return:
+			steps++;
+			return true;
+		default:
+		{
+			int result;
+			if (!compute(instruction, result))
+			{
+				return false;
+			}
+			if (instruction.dest.kind == IrOperand::Variable)
+			{
+				slotValues[instruction.dest.value] = result;
+				slotKnown[instruction.dest.value] = 1;
+			}
+			else
+			{
+				temporaryValues[instruction.dest.value] = result;
+			}
+			index++;
+			break;
+		}
+		}
+	}
+	return false;
+}
+
+bool PartialEvaluator::load(const IrOperand& operand, int& value) const
+{
+	switch (operand.kind)
+	{
+	case IrOperand::Constant:
+		value = operand.value;
+		return true;
+	case IrOperand::Variable:
+		value = slotValues[operand.value];
+		return slotKnown[operand.value] != 0;
+	case IrOperand::Temporary:
+		value = temporaryValues[operand.value];
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool PartialEvaluator::compute(const IrInstruction& instruction, int& result) const
+{
+	int left;
+	int right = 0;
+	if (!load(instruction.left, left)
+		|| (IrProgram::isArithmetic(instruction.opcode) && !load(instruction.right, right)))
+	{
+		return false;
+	}
+
+	long long exact;
+	switch (instruction.opcode)
+	{
+	case IrOpcode::Copy:
+		result = left;
+		return true;
+	case IrOpcode::Add:
+		exact = static_cast<long long>(left) + right;
+		break;
+	case IrOpcode::Subtract:
+		exact = static_cast<long long>(left) - right;
+		break;
+	case IrOpcode::Multiply:
+		exact = static_cast<long long>(left) * right;
+		break;
+	case IrOpcode::Divide:
+		if (right == 0 || (left == INT_MIN && right == -1))
+		{
+			return false;
+		}
+		result = left / right;
+		return true;
+	case IrOpcode::ShiftLeft:
+		exact = static_cast<long long>(left) * (1LL << right);
+		break;
+	case IrOpcode::ShiftRight:
+		result = left >> right;
+		return true;
+	case IrOpcode::ShiftRightLogical:
+		result = static_cast<int>(static_cast<unsigned>(left) >> right);
+		return true;
+	case IrOpcode::MultiplyHigh:
+		result = static_cast<int>((static_cast<long long>(left) * right) >> 32);
+		return true;
+	default:
+		return false;	// Input
+	}
+
+	// Wrapping arithmetic keeps the low 32 bits; otherwise an overflow is
+	// left for the program to run into
+	if (instruction.wraps)
+	{
+		result = static_cast<int>(static_cast<unsigned>(exact));
+		return true;
+	}
+	return narrow(exact, result);
+}
+
+int PartialEvaluator::resume(IrProgram& program, int block, size_t index)
+{
+	int copy = program.addBlock("L_RESUME");
+	renamed.assign(program.temporaryCount, -1);
+	for (size_t i = index; i < program.blocks[block].instructions.size(); i++)
+	{
+		IrInstruction instruction = program.blocks[block].instructions[i];
+		for (IrOperand* operand : { &instruction.left, &instruction.right })
+		{
+			if (operand->kind != IrOperand::Temporary)
+			{
+				continue;
+			}
+			if (renamed[operand->value] >= 0)
+			{
+				operand->value = renamed[operand->value];
+			}
+			else
+			{
+				*operand = IrOperand::constant(temporaryValues[operand->value]);
+			}
+		}
+		if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+		{
+			int fresh = program.newTemporary();
+			renamed[instruction.dest.value] = fresh;
+			instruction.dest.value = fresh;
+		}
+		program.blocks[copy].instructions.push_back(instruction);
+	}
+	return copy;
+}
+
+void PartialEvaluator::removeUnreachable(IrProgram& program, int entry)
+{
+	reachable.assign(program.blocks.size(), 0);
+	order.assign(1, entry);
+	reachable[entry] = 1;
+	for (size_t next = 0; next < order.size(); next++)
+	{
+		const IrInstruction& last = program.blocks[order[next]].terminator();
+		for (int target : { last.target, last.falseTarget })
+		{
+			if (target >= 0 && !reachable[target])
+			{
+				reachable[target] = 1;
+				order.push_back(target);
+			}
+		}
+	}
+
+	// The new entry and the resumed block first, then the blocks that
+	// remain in their order
+	order.assign(1, entry);
+	int count = static_cast<int>(program.blocks.size());
+	for (int b = entry + 1; b < count + entry; b++)
+	{
+		if (reachable[b % count])
+		{
+			order.push_back(b % count);
+		}
+	}
+	program.reorderBlocks(order);
+}
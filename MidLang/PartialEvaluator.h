@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "IR.h"
+
+/**
+ * How much of a program PartialEvaluator may run while compiling.
+ */
+struct EvaluationSettings
+{
+	size_t stepBudget;		// most IR instructions to run; 0 for none
+	size_t outputBudget;	// most characters of output to write out as text
+
+	EvaluationSettings() : stepBudget(1000000), outputBudget(65536) {}
+};
+
+/**
+ * PartialEvaluator (Optimization pass on the IR)
+ *
+ * Purpose: Runs the part of a program that does not depend on its input
+ * while compiling, so that
+ *     var s = 0; var i = 0; while (i < 1000) { s = s + i * i; i = i + 1; }
+ *     println(s); var n = inputInt(); ...
+ * starts with s and i already set and 332833500 already printed.
+ *
+ * How it works:
+ * 1. Interprets the IR from the entry, with the value of every variable
+ *    and temporary, until it reaches an input, the end of the program or
+ *    the step budget. It also stops before anything whose result C++
+ *    leaves undefined (an int overflow or a division by zero), and before
+ *    output that would go past the output budget
+ * 2. A new entry block prints all output so far with one PrintText, sets
+ *    the variables the rest of the program reads to their values, and
+ *    jumps to where the interpreter stopped. A program that ends while
+ *    compiling becomes just that block and a Return
+ * 3. If it stopped inside a block, the rest of that block is copied into
+ *    a new block with fresh temporaries, and the values of the temporaries
+ *    computed before that point as constants
+ * 4. Blocks that can no longer be reached are removed
+ *
+ * Runs first on whole programs, where each temporary is only used in the
+ * block that defines it (IrBuilder lowers one statement at a time); a
+ * program where that does not hold, and a fragment, whose variables are
+ * unknown when it starts, are left unchanged. So is a program that reads
+ * input before it prints or stores anything.
+ */
+class PartialEvaluator
+{
+	std::vector<int> slotValues;		// by slot
+	std::vector<char> slotKnown;
+	std::vector<int> temporaryValues;	// by temporary
+	std::vector<int> definedIn;			// by temporary: block, -1 before its definition
+	std::vector<int> renamed;			// by temporary: its copy in the resumed block, -1 if none
+	std::vector<char> reachable;		// by block
+	std::vector<char> slotRead;			// by slot: read after the new entry
+	std::vector<int> order;
+	std::string output;
+
+	bool usesLocalTemporaries(const IrProgram& program);
+	bool execute(const IrProgram& program, int& block, size_t& index, size_t& steps);	// true at the end
+	bool load(const IrOperand& operand, int& value) const;
+	bool compute(const IrInstruction& instruction, int& result) const;
+	int resume(IrProgram& program, int block, size_t index);
+	void removeUnreachable(IrProgram& program, int entry);
+
+public:
+	EvaluationSettings settings;
+
+	// Statistics since the last reset()
+	size_t evaluatedCount;		// IR instructions run while compiling
+	size_t printedCount;		// characters of output written as text
+	size_t presetCount;			// variables set by the new entry block
+
+	PartialEvaluator();
+
+	/**
+	 * Clears the statistics, keeping the settings and internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Evaluates the start of a whole program in place; fragments are left
+	 * unchanged.
+	 */
+	void run(IrProgram& program);
+};
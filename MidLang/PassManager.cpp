@@ -0,0 +1,195 @@
+#include "PassManager.h"
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+PassManager::PassManager()
+	: level(OptimizationLevel::Full), listing(nullptr)
+{
+}
+
+int PassManager::add(const string& name, unsigned levels, function<void()> reset,
+	function<size_t()> changes, function<void(ostream&)> describe, function<void(IrProgram&)> run)
+{
+	Pass pass;
+	pass.name = name;
+	pass.levels = levels;
+	pass.reset = reset;
+	pass.changes = changes;
+	pass.describe = describe;
+	pass.run = run;
+	pass.enabled = (levels & levelBit(level)) != 0;
+	pass.print = false;
+	pass.runs = 0;
+	pass.time = chrono::steady_clock::duration::zero();
+	pass.allocations = 0;
+	passes.push_back(pass);
+	return static_cast<int>(passes.size()) - 1;
+}
+
+int PassManager::find(const string& name) const
+{
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		if (passes[i].name == name)
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+void PassManager::configure()
+{
+	for (Pass& pass : passes)
+	{
+		pass.enabled = (pass.levels & levelBit(level)) != 0;
+		pass.print = false;
+	}
+
+	for (const string& name : disabledPasses)
+	{
+		int pass = find(name);
+		if (pass < 0)
+		{
+			throw runtime_error("Unknown optimization pass: " + name);
+		}
+		passes[pass].enabled = false;
+	}
+
+	for (const string& name : printAfter)
+	{
+		int pass = find(name);
+		if (pass < 0)
+		{
+			throw runtime_error("Unknown optimization pass: " + name);
+		}
+		if (!passes[pass].run)
+		{
+			throw runtime_error("Cannot print the IR after " + name + ", which runs on the syntax tree");
+		}
+		passes[pass].print = true;
+	}
+}
+
+void PassManager::reset()
+{
+	for (Pass& pass : passes)
+	{
+		pass.reset();
+		pass.runs = 0;
+		pass.time = chrono::steady_clock::duration::zero();
+		pass.allocations = 0;
+	}
+}
+
+void PassManager::finish(Pass& pass, chrono::steady_clock::time_point start, size_t allocations)
+{
+	pass.time += chrono::steady_clock::now() - start;
+	pass.allocations += AllocProfiler::threadAllocations() - allocations;
+	pass.runs++;
+}
+
+void PassManager::runIr(IrProgram& program)
+{
+	for (Pass& pass : passes)
+	{
+		if (!pass.enabled || !pass.run)
+		{
+			continue;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t allocations = AllocProfiler::threadAllocations();
+		pass.run(program);
+		finish(pass, start, allocations);
+
+#ifndef NDEBUG
+		try
+		{
+			program.verify();
+		}
+		catch (const logic_error& ex)
+		{
+			throw logic_error(string(ex.what()) + " (after " + pass.name + ")");
+		}
+#endif
+		if (pass.print && listing)
+		{
+			*listing << "--- IR after " << pass.name << " ---" << endl;
+			program.print(*listing);
+		}
+	}
+}
+
+void PassManager::report(ostream& out) const
+{
+	bool counted = AllocProfiler::enabled();
+	out << left << setw(24) << "Pass" << right << setw(8) << "Runs" << setw(12) << "Time (ms)"
+		<< setw(10) << "Changes";
+	if (counted)
+	{
+		out << setw(10) << "Allocs";
+	}
+	out << endl;
+	chrono::steady_clock::duration total = chrono::steady_clock::duration::zero();
+	for (const Pass& pass : passes)
+	{
+		out << left << setw(24) << pass.name << right;
+		if (!pass.enabled)
+		{
+			out << setw(8) << "off" << endl;
+			continue;
+		}
+		double milliseconds = chrono::duration<double, milli>(pass.time).count();
+		out << setw(8) << pass.runs << setw(12) << fixed << setprecision(3) << milliseconds
+			<< setw(10) << pass.changes();
+		if (counted)
+		{
+			out << setw(10) << pass.allocations;
+		}
+		out << endl;
+		total += pass.time;
+	}
+	out << left << setw(32) << "Total" << right << setw(12) << fixed << setprecision(3)
+		<< chrono::duration<double, milli>(total).count() << endl;
+	out.unsetf(ios::fixed);
+}
+
+void PassManager::printStatistics(ostream& out) const
+{
+	for (const Pass& pass : passes)
+	{
+		if (pass.enabled)
+		{
+			pass.describe(out);
+			out << endl;
+		}
+	}
+}
+
+bool PassManager::parseLevel(const string& text, OptimizationLevel& level)
+{
+	if (text == "-O0")
+	{
+		level = OptimizationLevel::None;
+	}
+	else if (text == "-O1")
+	{
+		level = OptimizationLevel::Basic;
+	}
+	else if (text == "-O2")
+	{
+		level = OptimizationLevel::Full;
+	}
+	else if (text == "-Os")
+	{
+		level = OptimizationLevel::Size;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
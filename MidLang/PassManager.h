@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "AllocProfiler.h"
+#include "IR.h"
+
+/**
+ * Which optimization passes run, as chosen with -O0, -O1, -O2 and -Os.
+ */
+enum class OptimizationLevel
+{
+	None,		// -O0: no optimization
+	Basic,		// -O1: the passes that work on straight-line code and clean up jumps
+	Full,		// -O2: every pass (the default)
+	Size		// -Os: -O2 without the passes that make the code larger
+};
+
+/**
+ * PassManager (Optimization pipeline)
+ *
+ * Purpose: Decides which optimization passes run at the chosen level,
+ * runs them in order and keeps statistics per pass, so a pass can be
+ * switched off, or the IR looked at after it, without rebuilding.
+ *
+ * How it works:
+ * 1. Each pass is added once with its name, the levels it runs at, how to
+ *    reset it, how many changes it has made since then and how to describe
+ *    them. IR passes also say how to run them on an IrProgram; the AST
+ *    passes are run by the caller through run()
+ * 2. configure() enables the passes of the level, except the ones named
+ *    in disabledPasses, and rejects names that are not passes
+ * 3. runIr() runs every enabled IR pass in the order they were added.
+ *    After each one the program is verified in debug builds, and printed
+ *    to listing if the pass is named in printAfter
+ * 4. Every run is timed; report() writes a table of runs, time and
+ *    changes per pass, and of allocations in a build that counts them.
+ *    printStatistics() writes what each enabled pass changed
+ *
+ * Different passes may run on different threads at the same time (the
+ * pipelined mode runs the AST passes on the parser thread), but one pass
+ * may not.
+ */
+class PassManager
+{
+	struct Pass
+	{
+		std::string name;
+		unsigned levels;						// levelBit() of each level it runs at
+		std::function<void()> reset;
+		std::function<size_t()> changes;		// since the last reset
+		std::function<void(std::ostream&)> describe;	// the changes as a sentence
+		std::function<void(IrProgram&)> run;	// empty for AST passes
+		bool enabled;
+		bool print;
+		size_t runs;
+		std::chrono::steady_clock::duration time;
+		size_t allocations;
+	};
+
+	std::vector<Pass> passes;
+
+	int find(const std::string& name) const;
+	void finish(Pass& pass, std::chrono::steady_clock::time_point start, size_t allocations);
+
+public:
+	OptimizationLevel level;
+	std::vector<std::string> disabledPasses;
+	std::vector<std::string> printAfter;	// names of IR passes
+	std::ostream* listing;					// where printAfter goes; nothing is printed if null
+
+	static unsigned levelBit(OptimizationLevel level) { return 1u << static_cast<int>(level); }
+	static const unsigned optimizingLevels = 0xe;	// -O1, -O2 and -Os
+
+	PassManager();
+
+	/**
+	 * Adds a pass after the ones added before it, and returns its number.
+	 */
+	int add(const std::string& name, unsigned levels, std::function<void()> reset,
+		std::function<size_t()> changes, std::function<void(std::ostream&)> describe,
+		std::function<void(IrProgram&)> run = nullptr);
+
+	/**
+	 * Enables the passes for level, disabledPasses and printAfter. Throws
+	 * runtime_error naming an unknown pass.
+	 */
+	void configure();
+
+	/**
+	 * Leaves a pass out even if the level includes it.
+	 */
+	void disable(int pass) { passes[pass].enabled = false; }
+
+	bool isEnabled(int pass) const { return passes[pass].enabled; }
+
+	/**
+	 * Resets every pass and clears the statistics.
+	 */
+	void reset();
+
+	/**
+	 * Calls body, which runs pass, if the pass is enabled, and times it.
+	 */
+	template <typename Body>
+	void run(int pass, Body body)
+	{
+		if (passes[pass].enabled)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t allocations = AllocProfiler::threadAllocations();
+			body();
+			finish(passes[pass], start, allocations);
+		}
+	}
+
+	/**
+	 * Runs the enabled IR passes over a whole program or one fragment.
+	 */
+	void runIr(IrProgram& program);
+
+	/**
+	 * Writes the runs, time, changes and (if counted) allocations of each
+	 * pass since the last reset(), one line per pass.
+	 */
+	void report(std::ostream& out) const;
+
+	/**
+	 * Writes what each enabled pass changed since the last reset(), one
+	 * line per pass.
+	 */
+	void printStatistics(std::ostream& out) const;
+
+	/**
+	 * Reads "-O0", "-O1", "-O2" or "-Os". Returns false for anything else.
+	 */
+	static bool parseLevel(const std::string& text, OptimizationLevel& level);
+};
@@ -0,0 +1,248 @@
+#include "Pipeline.h"
+#include "AllocProfiler.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Lexer.h"
+#include "Parser.h"
+
+using namespace std;
+
+namespace
+{
+	const size_t tokenBatchSize = 256;
+	const size_t tokenRingCapacity = 64;
+	const size_t statementRingCapacity = 256;
+
+	/**
+	 * Item passed from the parser to the code generator. A null statement
+	 * ends the program; error is set if parsing failed.
+	 */
+	struct ParsedStatement
+	{
+		Statement* statement = nullptr;
+		string error;
+	};
+
+	/**
+	 * Sets a flag when a stage's thread exits, however it exits.
+	 */
+	struct DoneFlag
+	{
+		atomic<bool>& flag;
+
+		~DoneFlag()
+		{
+			flag.store(true, memory_order_release);
+		}
+	};
+
+	/**
+	 * Feeds the parser from the token ring, one batch at a time.
+	 */
+	class RingTokenSource : public TokenSource
+	{
+		SpscRing<vector<Token>>& ring;
+		const atomic<bool>& lexerDone;
+		vector<Token> batch;
+		size_t index;
+
+	public:
+		RingTokenSource(SpscRing<vector<Token>>& ring, const atomic<bool>& lexerDone)
+			: ring(ring), lexerDone(lexerDone), index(0)
+		{
+		}
+
+		Token next() override
+		{
+			while (index >= batch.size())
+			{
+				// Keep returning EOF once the lexer has produced it
+				if (!batch.empty() && batch.back().type == TokenType::EOF_TOKEN)
+				{
+					return batch.back();
+				}
+				if (!ring.pop(batch, lexerDone))
+				{
+					throw runtime_error("Lexer stopped before the end of input");
+				}
+				index = 0;
+			}
+			return batch[index++];
+		}
+	};
+}
+
+Pipeline::Pipeline(istream& in, function<void(Statement*)> generate, function<Statement*(Statement*)> prepare)
+	: input(in), generate(move(generate)), prepare(move(prepare)), tokenCount(0), statementCount(0)
+{
+}
+
+void Pipeline::run()
+{
+	SpscRing<vector<Token>> tokenRing(tokenRingCapacity);
+	SpscRing<ParsedStatement> statementRing(statementRingCapacity);
+
+	atomic<bool> lexerDone(false);
+	atomic<bool> parserDone(false);
+	atomic<bool> stopLexer(false);
+	atomic<bool> stopParser(false);
+	exception_ptr lexerError;
+
+	// Stage 1: Lexical analysis
+	thread lexerThread([&]()
+	{
+		DoneFlag done{ lexerDone };
+		MIDLANG_ALLOC_PHASE(AllocPhase::Lex);
+		MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+		try
+		{
+			Lexer lexer(input);
+			vector<Token> batch;
+			batch.reserve(tokenBatchSize);
+
+			while (true)
+			{
+				batch.push_back(lexer.next());
+				tokenCount++;
+
+				bool atEnd = batch.back().type == TokenType::EOF_TOKEN;
+				if (atEnd || batch.size() == tokenBatchSize)
+				{
+					if (!tokenRing.push(batch, stopLexer))
+					{
+						return;
+					}
+					batch.clear();
+					batch.reserve(tokenBatchSize);
+				}
+				if (atEnd)
+				{
+					return;
+				}
+			}
+		}
+		catch (...)
+		{
+			lexerError = current_exception();
+		}
+	});
+
+	// Stage 2: Parsing
+	thread parserThread([&]()
+	{
+		DoneFlag done{ parserDone };
+		RingTokenSource tokens(tokenRing, lexerDone);
+		Parser parser(tokens);
+		ParsedStatement item;
+
+		try
+		{
+			while ((item.statement = parser.parseNext()) != nullptr)
+			{
+				if (prepare)
+				{
+					try
+					{
+						item.statement = prepare(item.statement);
+					}
+					catch (...)
+					{
+						delete item.statement;
+						throw;
+					}
+					if (item.statement == nullptr)
+					{
+						continue;
+					}
+				}
+
+				if (!statementRing.push(item, stopParser))
+				{
+					delete item.statement;
+					return;
+				}
+			}
+		}
+		catch (const exception& ex)
+		{
+			item.statement = nullptr;
+			item.error = ex.what();
+		}
+
+		// The lexer is no longer needed, even if it has not reached the end
+		stopLexer.store(true, memory_order_release);
+		statementRing.push(item, stopParser);
+	});
+
+	// Stage 3: Code generation, in statement order
+	string error;
+	try
+	{
+		while (true)
+		{
+			ParsedStatement item;
+			if (!statementRing.pop(item, parserDone))
+			{
+				error = "Parser stopped before the end of input";
+				break;
+			}
+			if (item.statement == nullptr)
+			{
+				error = item.error;
+				break;
+			}
+
+			unique_ptr<Statement> owned(item.statement);
+			generate(item.statement);
+			statementCount++;
+		}
+	}
+	catch (...)
+	{
+		stopLexer = true;
+		stopParser = true;
+		lexerThread.join();
+		parserThread.join();
+
+		ParsedStatement leftover;
+		while (statementRing.tryPop(leftover))
+		{
+			delete leftover.statement;
+		}
+		throw;
+	}
+
+	lexerThread.join();
+	parserThread.join();
+
+	tokenQueueStats = tokenRing.stats;
+	statementQueueStats = statementRing.stats;
+
+	if (lexerError)
+	{
+		rethrow_exception(lexerError);
+	}
+	if (!error.empty())
+	{
+		throw runtime_error(error);
+	}
+}
+
+void Pipeline::reportStats(ostream& out) const
+{
+	out << "Token queue: " << tokenQueueStats.pushes << " batches, average occupancy "
+		<< tokenQueueStats.averageOccupancy() << "/" << tokenRingCapacity
+		<< " (max " << tokenQueueStats.maxOccupancy << "), lexer waited "
+		<< tokenQueueStats.fullWaits << " times (slept " << tokenQueueStats.fullSleeps << "), parser waited "
+		<< tokenQueueStats.emptyWaits << " times (slept " << tokenQueueStats.emptySleeps << ")" << endl;
+	out << "Statement queue: " << statementQueueStats.pushes << " statements, average occupancy "
+		<< statementQueueStats.averageOccupancy() << "/" << statementRingCapacity
+		<< " (max " << statementQueueStats.maxOccupancy << "), parser waited "
+		<< statementQueueStats.fullWaits << " times (slept " << statementQueueStats.fullSleeps << "), generator waited "
+		<< statementQueueStats.emptyWaits << " times (slept " << statementQueueStats.emptySleeps << ")" << endl;
+}
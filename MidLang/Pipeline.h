@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include "AST.h"
+#include "SpscRing.h"
+
+/**
+ * Pipeline (Multi-threaded streaming)
+ * 
+ * Purpose: Overlaps lexing, parsing and code generation on large inputs.
+ * 
+ * How it works:
+ * 1. A lexer thread pushes batches of tokens into a token ring
+ * 2. A parser thread pulls tokens from that ring, runs the analysis
+ *    passes on each completed top-level statement and pushes it into a
+ *    statement ring
+ * 3. The calling thread hands the statements to the code generator in
+ *    order
+ * 
+ * The generated code and error messages are identical to those of the
+ * single-threaded streaming mode.
+ */
+class Pipeline
+{
+	std::istream& input;
+	std::function<void(Statement*)> generate;
+	std::function<Statement*(Statement*)> prepare;
+
+public:
+	size_t tokenCount;
+	size_t statementCount;
+	RingStats tokenQueueStats;
+	RingStats statementQueueStats;
+
+	/**
+	 * generate is called on the calling thread with each statement, in
+	 * order; the pipeline deletes the statement afterwards.
+	 * prepare is called on the parser thread for each statement before it
+	 * is queued. It returns the statement to generate, or nullptr if it
+	 * deleted the statement, and may throw to report an error in it.
+	 */
+	Pipeline(std::istream& in, std::function<void(Statement*)> generate,
+		std::function<Statement*(Statement*)> prepare = nullptr);
+
+	/**
+	 * Runs all three stages to completion. An error in a statement is
+	 * rethrown on the calling thread after the statements before it were
+	 * emitted.
+	 */
+	void run();
+
+	/**
+	 * Writes queue occupancy statistics. A queue that is usually full
+	 * points at a slow consumer; one that is usually empty at a slow
+	 * producer.
+	 */
+	void reportStats(std::ostream& out) const;
+};
@@ -0,0 +1,91 @@
+#include "RangeOptimizer.h"
+#include "AllocProfiler.h"
+
+using namespace std;
+
+RangeOptimizer::RangeOptimizer()
+	: decidedBranchCount(0), unwrappedCount(0), narrowedCount(0)
+{
+}
+
+void RangeOptimizer::reset()
+{
+	decidedBranchCount = 0;
+	unwrappedCount = 0;
+	narrowedCount = 0;
+}
+
+void RangeOptimizer::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	graph.build(program);
+	if (!ranges.compute(program, graph))
+	{
+		return;
+	}
+
+	for (int block : graph.order)
+	{
+		if (!ranges.isReached(block))
+		{
+			continue;	// only reached through branches decided here
+		}
+		ranges.enter(block);
+		for (IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			// Evaluated as wrapping, a range that is not full is exact
+			if (instruction.wraps && !ranges.evaluate(instruction).isFull())
+			{
+				instruction.wraps = false;
+				unwrappedCount++;
+			}
+			if (instruction.opcode == IrOpcode::Branch && instruction.target != instruction.falseTarget)
+			{
+				int outcome = ValueRanges::decide(instruction.compare, ranges.range(instruction.left),
+					ranges.range(instruction.right));
+				if (outcome >= 0)
+				{
+					IrInstruction jump(IrOpcode::Jump);
+					jump.target = outcome ? instruction.target : instruction.falseTarget;
+					instruction = jump;
+					decidedBranchCount++;
+				}
+			}
+			ranges.step(instruction);
+		}
+	}
+
+	if (!program.fragment)
+	{
+		selectWidths(program);
+	}
+}
+
+void RangeOptimizer::selectWidths(IrProgram& program)
+{
+	size_t slots = program.variableNames.size();
+	program.variableBits.assign(slots, 32);
+	for (size_t slot = 0; slot < slots; slot++)
+	{
+		ValueRange stored = ranges.storedRange(static_cast<int>(slot));
+		if (stored.isEmpty())
+		{
+			continue;	// not stored anywhere reached
+		}
+		if (stored.fits(-128, 127))
+		{
+			program.variableBits[slot] = 8;
+		}
+		else if (stored.fits(-32768, 32767))
+		{
+			program.variableBits[slot] = 16;
+		}
+		else
+		{
+			continue;
+		}
+		narrowedCount++;
+	}
+}
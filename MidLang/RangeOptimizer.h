@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+#include "ValueRanges.h"
+
+/**
+ * RangeOptimizer (Optimization pass on the IR)
+ *
+ * Purpose: Uses the value ranges found by ValueRanges to remove tests
+ * whose outcome is known, to drop wraparound that cannot happen, and to
+ * give variables whose values all fit in 8 or 16 bits a smaller type.
+ *
+ * How it works:
+ * 1. ValueRanges finds the range of every variable and temporary
+ * 2. A branch whose comparison always holds, or never does, becomes a
+ *    jump; BlockOptimizer and the structured generator leave out what is
+ *    no longer reached
+ * 3. Wrapping +, - and * (the closed forms of LoopCollapser) whose exact
+ *    result is known to fit in an int become ordinary arithmetic, which
+ *    StrengthReducer can then rewrite
+ * 4. In a whole program, each variable gets the fewest of 8, 16 or 32
+ *    bits that hold every value stored in it (IrProgram::variableBits),
+ *    and is declared as int8_t, int16_t or int
+ *
+ * Variables are never made wider than 32 bits, since none needs more:
+ * the +, - and * of the program itself do not overflow in a program whose
+ * C++ is defined (the tests run it under the undefined behavior
+ * sanitizer), and those the other passes add wrap modulo 2^32
+ * (IrInstruction::wraps), so every value stored is the 32-bit one the
+ * unoptimized program computes. Fragments keep all their variables at 32
+ * bits, since later statements may store anything in them.
+ */
+class RangeOptimizer
+{
+	ControlFlowGraph graph;
+	ValueRanges ranges;
+
+	void selectWidths(IrProgram& program);
+
+public:
+	// Statistics since the last reset()
+	size_t decidedBranchCount;	// branches that became jumps
+	size_t unwrappedCount;		// wrapping operations that cannot wrap
+	size_t narrowedCount;		// variables with 8 or 16 bits
+
+	RangeOptimizer();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Optimizes a whole program or one fragment in place.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,609 @@
+#include "ReductionSplitter.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+	// a compare b is b mirrored a
+	IrCompare mirror(IrCompare compare)
+	{
+		switch (compare)
+		{
+		case IrCompare::Less: return IrCompare::Greater;
+		case IrCompare::Greater: return IrCompare::Less;
+		case IrCompare::LessEqual: return IrCompare::GreaterEqual;
+		case IrCompare::GreaterEqual: return IrCompare::LessEqual;
+		default: return compare;
+		}
+	}
+
+	IrInstruction operation(IrOpcode opcode, const IrOperand& dest, const IrOperand& left, const IrOperand& right)
+	{
+		IrInstruction instruction(opcode);
+		instruction.dest = dest;
+		instruction.left = left;
+		instruction.right = right;
+		return instruction;
+	}
+
+	IrInstruction branch(const IrOperand& left, IrCompare compare, const IrOperand& right, int target, int falseTarget)
+	{
+		IrInstruction instruction(IrOpcode::Branch);
+		instruction.left = left;
+		instruction.compare = compare;
+		instruction.right = right;
+		instruction.target = target;
+		instruction.falseTarget = falseTarget;
+		return instruction;
+	}
+
+	IrInstruction jump(int target)
+	{
+		IrInstruction instruction(IrOpcode::Jump);
+		instruction.target = target;
+		return instruction;
+	}
+}
+
+ReductionSplitter::ReductionSplitter()
+	: copyNumber(0), labelCounter(0), splitCount(0), accumulatorCount(0)
+{
+}
+
+void ReductionSplitter::reset()
+{
+	labelCounter = 0;
+	splitCount = 0;
+	accumulatorCount = 0;
+}
+
+void ReductionSplitter::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (program.fragment || program.blocks.size() < 2 || settings.accumulators < 2)
+	{
+		return;
+	}
+
+	int count = static_cast<int>(program.blocks.size());
+	graph.build(program);
+	loopOf.assign(count, -1);
+	position.assign(count, -1);
+	insertedAfter.assign(count, -1);
+	insertedEnd.assign(count, -1);
+	kindOf.assign(program.variableNames.size(), Kind::None);
+	reads.assign(program.variableNames.size(), 0);
+	temporaryOf.assign(program.temporaryCount, -1);
+	temporaryCopy.assign(program.temporaryCount, -1);
+	useCount.assign(program.temporaryCount, 0);
+	for (const IrBlock& block : program.blocks)
+	{
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary)
+				{
+					useCount[operand->value]++;
+				}
+			}
+		}
+	}
+
+	// Only innermost loops qualify, so the order does not matter. New
+	// blocks are appended, so the graph still describes the old ones
+	bool changed = false;
+	for (int header : graph.order)
+	{
+		changed |= split(program, header);
+	}
+	if (!changed)
+	{
+		return;
+	}
+
+	// Put the new blocks after the preheader that jumps to them, which
+	// also keeps the last block last
+	order.clear();
+	for (int block = 0; block < count; block++)
+	{
+		order.push_back(block);
+		for (int inserted = insertedAfter[block]; inserted >= 0 && inserted < insertedEnd[block]; inserted++)
+		{
+			order.push_back(inserted);
+		}
+	}
+	program.reorderBlocks(order);
+}
+
+bool ReductionSplitter::split(IrProgram& program, int header)
+{
+	if (!graph.collectLoop(header, members, loopOf))
+	{
+		return false;
+	}
+	int preheader = graph.findPreheader(program, header, loopOf);
+	if (preheader < 0)
+	{
+		return false;
+	}
+
+	// The header only tests the condition
+	const vector<IrInstruction>& test = program.blocks[header].instructions;
+	if (test.size() != 1 || test[0].opcode != IrOpcode::Branch
+		|| (loopOf[test[0].target] == header) == (loopOf[test[0].falseTarget] == header))
+	{
+		return false;
+	}
+	bool continueIfTrue = loopOf[test[0].target] == header;
+	int entry = continueIfTrue ? test[0].target : test[0].falseTarget;
+
+	// Without inner loops, every body block runs at most once per iteration
+	body.clear();
+	size_t size = 0;
+	for (int block : members)
+	{
+		if (block == header)
+		{
+			continue;
+		}
+		for (int successor : graph.successors[block])
+		{
+			if (successor != header && (loopOf[successor] != header || graph.isBackEdge(block, successor)))
+			{
+				return false;
+			}
+		}
+		body.push_back(block);
+		size += program.blocks[block].instructions.size();
+	}
+	int accumulators = settings.accumulators;
+	if (size * static_cast<size_t>(accumulators) > settings.budget)
+	{
+		return false;
+	}
+	sort(body.begin(), body.end());
+	for (size_t i = 0; i < body.size(); i++)
+	{
+		position[body[i]] = static_cast<int>(i);
+	}
+
+	classify(program, header);
+
+	// counter compare bound, with a bound the loop does not change
+	IrCompare compare = continueIfTrue ? test[0].compare : IrProgram::negate(test[0].compare);
+	IrOperand counter = test[0].left;
+	IrOperand bound = test[0].right;
+	if (counter.kind != IrOperand::Variable || kindOf[counter.value] == Kind::None)
+	{
+		swap(counter, bound);
+		compare = mirror(compare);
+	}
+	int step = 0;
+	bool counting = counter.kind == IrOperand::Variable && kindOf[counter.value] != Kind::None
+		&& bound.kind != IrOperand::Constant
+		&& (bound.kind != IrOperand::Variable || kindOf[bound.value] == Kind::None)
+		&& findCounter(program, header, counter, step)
+		&& (step > 0 ? compare == IrCompare::Less || compare == IrCompare::LessEqual
+			: compare == IrCompare::Greater || compare == IrCompare::GreaterEqual);
+
+	// The stored variables that are reductions; the others become Other
+	reductions.clear();
+	for (int block : body)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (!counting || !instruction.definesValue() || instruction.dest.kind != IrOperand::Variable)
+			{
+				continue;
+			}
+			int slot = instruction.dest.value;
+			Kind kind = kindOf[slot];
+			if (kind == Kind::Other || kind == Kind::None)
+			{
+				continue;
+			}
+			if (reads[slot] != 0 || slot == counter.value
+				|| ((kind == Kind::Sum || kind == Kind::Product) && program.bits(slot) != 32))
+			{
+				kindOf[slot] = Kind::Other;		// a narrowed variable could not hold the partial results
+				continue;
+			}
+			Reduction reduction;
+			reduction.slot = slot;
+			reduction.kind = kind;
+			reduction.first = -1;
+			reductions.push_back(reduction);
+			kindOf[slot] = Kind::None;		// listed once
+		}
+	}
+	for (const Reduction& reduction : reductions)
+	{
+		kindOf[reduction.slot] = reduction.kind;
+	}
+
+	// The counter stays on the right side of the bound for all copies
+	// while it is at most bound - distance, which must fit in an int
+	long long distance = static_cast<long long>(settings.accumulators - 1) * step;
+	bool changed = !reductions.empty() && distance >= INT_MIN && distance <= INT_MAX;
+	if (changed)
+	{
+		rewrite(program, header, preheader, entry, counter, bound, compare, step);
+	}
+
+	// Leave kindOf and reads cleared for the next loop
+	for (int block : members)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			for (const IrOperand* operand : { &instruction.dest, &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable && static_cast<size_t>(operand->value) < kindOf.size())
+				{
+					kindOf[operand->value] = Kind::None;
+					reads[operand->value] = 0;
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+void ReductionSplitter::rewrite(IrProgram& program, int header, int preheader, int entry, const IrOperand& counter,
+	const IrOperand& bound, IrCompare compare, int step)
+{
+	int accumulators = settings.accumulators;
+	int distance = (accumulators - 1) * step;
+	string suffix = "_" + to_string(++labelCounter);
+	for (Reduction& reduction : reductions)
+	{
+		reduction.first = static_cast<int>(program.variableNames.size());
+		for (int copy = 1; copy < accumulators; copy++)
+		{
+			program.variableNames.push_back(program.variableNames[reduction.slot] + "_" + to_string(copy + 1));
+		}
+	}
+	accumulatorOf.assign(program.variableNames.size(), -1);
+
+	int check = program.addBlock("L_REDUCE_CHECK", suffix);
+	int start = program.addBlock("L_REDUCE_START", suffix);
+	int loop = program.addBlock("L_REDUCE", suffix);
+	int first = static_cast<int>(program.blocks.size());
+	for (int copy = 0; copy < accumulators; copy++)
+	{
+		for (const Reduction& reduction : reductions)
+		{
+			accumulatorOf[reduction.slot] = copy == 0 ? -1 : reduction.first + copy - 1;
+		}
+		int next = copy + 1 < accumulators ? copyIndex(first + static_cast<int>(body.size()) * (copy + 1), entry) : loop;
+		copyBody(program, header, next, "_R" + to_string(labelCounter) + "_" + to_string(copy + 1));
+	}
+	int end = program.addBlock("L_REDUCE_END", suffix);
+
+	// bound - distance must not overflow
+	program.blocks[check].instructions.push_back(branch(bound, step > 0 ? IrCompare::GreaterEqual : IrCompare::LessEqual,
+		IrOperand::constant(step > 0 ? INT_MIN + distance : INT_MAX + distance), start, header));
+
+	vector<IrInstruction>& starting = program.blocks[start].instructions;
+	IrOperand limit = IrOperand::temporary(program.newTemporary());
+	starting.push_back(operation(IrOpcode::Subtract, limit, bound, IrOperand::constant(distance)));
+	for (const Reduction& reduction : reductions)
+	{
+		IrOperand initial = reduction.kind == Kind::Sum ? IrOperand::constant(0)
+			: reduction.kind == Kind::Product ? IrOperand::constant(1) : IrOperand::variable(reduction.slot);
+		for (int copy = 1; copy < accumulators; copy++)
+		{
+			starting.push_back(operation(IrOpcode::Copy, IrOperand::variable(reduction.first + copy - 1), initial,
+				IrOperand()));
+		}
+	}
+	starting.push_back(jump(loop));
+
+	program.blocks[loop].instructions.push_back(branch(counter, compare, limit, copyIndex(first, entry), end));
+
+	// s = s + s_2 + ... for sums and products, then a test and a store of
+	// each s_k for minimums and maximums
+	int current = end;
+	for (size_t index = 0; index < reductions.size(); index++)
+	{
+		const Reduction& reduction = reductions[index];
+		IrOperand total = IrOperand::variable(reduction.slot);
+		for (int copy = 1; copy < accumulators; copy++)
+		{
+			IrOperand partial = IrOperand::variable(reduction.first + copy - 1);
+			if (reduction.kind == Kind::Sum || reduction.kind == Kind::Product)
+			{
+				program.blocks[current].instructions.push_back(operation(
+					reduction.kind == Kind::Sum ? IrOpcode::Add : IrOpcode::Multiply, total, total, partial));
+				program.blocks[current].instructions.back().wraps = true;
+				continue;
+			}
+			string label = suffix + "_" + to_string(index + 1) + "_" + to_string(copy + 1);
+			int store = program.addBlock("L_REDUCE_STORE", label);
+			int next = program.addBlock("L_REDUCE_NEXT", label);
+			program.blocks[current].instructions.push_back(branch(partial,
+				reduction.kind == Kind::Minimum ? IrCompare::Less : IrCompare::Greater, total, store, next));
+			program.blocks[store].instructions.push_back(operation(IrOpcode::Copy, total, partial, IrOperand()));
+			program.blocks[store].instructions.push_back(jump(next));
+			current = next;
+		}
+	}
+	program.blocks[current].instructions.push_back(jump(header));
+
+	program.blocks[preheader].instructions.back().target = check;
+	insertedAfter[preheader] = check;
+	insertedEnd[preheader] = static_cast<int>(program.blocks.size());
+	splitCount++;
+	accumulatorCount += reductions.size() * static_cast<size_t>(accumulators - 1);
+}
+
+bool ReductionSplitter::findCounter(const IrProgram& program, int header, const IrOperand& counter, int& step) const
+{
+	// One store to the counter, i = i + c, on every path around the loop
+	int stores = 0;
+	int storeBlock = -1;
+	for (int block : body)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			if (!instructions[i].definesValue() || instructions[i].dest != counter)
+			{
+				continue;
+			}
+			stores++;
+			storeBlock = block;
+
+			// Value numbering may leave i = t with t = i + c computed earlier in the block
+			const IrInstruction* update = &instructions[i];
+			if (update->opcode == IrOpcode::Copy && update->left.kind == IrOperand::Temporary)
+			{
+				for (size_t j = i; j-- > 0;)
+				{
+					if (instructions[j].definesValue() && instructions[j].dest == update->left)
+					{
+						update = &instructions[j];
+						break;
+					}
+				}
+			}
+			bool constantRight = update->right.kind == IrOperand::Constant;
+			if (update->wraps)
+			{
+				stores++;
+			}
+			else if (update->opcode == IrOpcode::Add && update->left == counter && constantRight)
+			{
+				step = update->right.value;
+			}
+			else if (update->opcode == IrOpcode::Add && update->right == counter
+				&& update->left.kind == IrOperand::Constant)
+			{
+				step = update->left.value;
+			}
+			else if (update->opcode == IrOpcode::Subtract && update->left == counter && constantRight
+				&& update->right.value != INT_MIN)
+			{
+				step = -update->right.value;
+			}
+			else
+			{
+				stores++;
+			}
+		}
+	}
+	if (stores != 1 || step == 0)
+	{
+		return false;
+	}
+	for (int latch : graph.predecessors[header])
+	{
+		if (loopOf[latch] == header && !graph.dominates(storeBlock, latch))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void ReductionSplitter::classify(const IrProgram& program, int header)
+{
+	for (int block : members)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable)
+				{
+					reads[operand->value]++;
+				}
+			}
+		}
+	}
+
+	for (int block : body)
+	{
+		const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const IrInstruction& instruction = instructions[i];
+			if (!instruction.definesValue() || instruction.dest.kind != IrOperand::Variable)
+			{
+				continue;
+			}
+			int slot = instruction.dest.value;
+
+			// s = s op x, or s = t after t = s op x where only this uses t
+			const IrInstruction* update = &instruction;
+			if (instruction.opcode == IrOpcode::Copy && instruction.left.kind == IrOperand::Temporary
+				&& useCount[instruction.left.value] == 1)
+			{
+				for (size_t j = i; j-- > 0;)
+				{
+					if (instructions[j].definesValue() && instructions[j].dest == instruction.left)
+					{
+						update = &instructions[j];
+						break;
+					}
+				}
+			}
+			Kind kind = updateKind(*update, slot);
+			if (kind != Kind::Other)
+			{
+				reads[slot]--;
+			}
+			else if (instruction.opcode == IrOpcode::Copy)
+			{
+				kind = selectKind(program, header, block, slot);
+			}
+			if (kindOf[slot] == Kind::None || kindOf[slot] == kind)
+			{
+				kindOf[slot] = kind;
+			}
+			else
+			{
+				kindOf[slot] = Kind::Other;
+			}
+		}
+	}
+}
+
+ReductionSplitter::Kind ReductionSplitter::updateKind(const IrInstruction& instruction, int slot) const
+{
+	IrOperand accumulator = IrOperand::variable(slot);
+	bool left = instruction.left == accumulator && instruction.right != accumulator;
+	bool right = instruction.right == accumulator && instruction.left != accumulator;
+	switch (instruction.opcode)
+	{
+	case IrOpcode::Add: return left || right ? Kind::Sum : Kind::Other;
+	case IrOpcode::Subtract: return left ? Kind::Sum : Kind::Other;
+	case IrOpcode::Multiply: return left || right ? Kind::Product : Kind::Other;
+	default: return Kind::Other;
+	}
+}
+
+ReductionSplitter::Kind ReductionSplitter::selectKind(const IrProgram& program, int header, int block, int slot)
+{
+	// if (x < s) { s = x; }: a block of just s = x, entered only from a
+	// branch on x and s whose other way goes to the same block as it does,
+	// directly or through an empty block
+	const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+	if (instructions.size() != 2 || instructions[1].opcode != IrOpcode::Jump || graph.predecessors[block].size() != 1)
+	{
+		return Kind::Other;
+	}
+	int join = instructions[1].target;
+	int test = graph.predecessors[block][0];
+	const IrInstruction& condition = program.blocks[test].terminator();
+	if (loopOf[test] != header || test == header || condition.opcode != IrOpcode::Branch
+		|| condition.target == condition.falseTarget)
+	{
+		return Kind::Other;
+	}
+	int other = condition.target == block ? condition.falseTarget : condition.target;
+	const vector<IrInstruction>& otherInstructions = program.blocks[other].instructions;
+	if (other != join && (loopOf[other] != header || other == header || otherInstructions.size() != 1
+		|| otherInstructions[0].opcode != IrOpcode::Jump || otherInstructions[0].target != join))
+	{
+		return Kind::Other;
+	}
+
+	// Normalized to x compare s, true when s = x is stored
+	IrOperand accumulator = IrOperand::variable(slot);
+	const IrOperand& value = instructions[0].left;
+	IrCompare compare = condition.compare;
+	if (condition.left == accumulator && condition.right == value)
+	{
+		compare = mirror(compare);
+	}
+	else if (condition.left != value || condition.right != accumulator)
+	{
+		return Kind::Other;
+	}
+	if (condition.target != block)
+	{
+		compare = IrProgram::negate(compare);
+	}
+
+	Kind kind = compare == IrCompare::Less || compare == IrCompare::LessEqual ? Kind::Minimum
+		: compare == IrCompare::Greater || compare == IrCompare::GreaterEqual ? Kind::Maximum : Kind::Other;
+	if (kind != Kind::Other)
+	{
+		reads[slot]--;
+	}
+	return kind;
+}
+
+int ReductionSplitter::copyBody(IrProgram& program, int header, int next, const string& suffix)
+{
+	int first = static_cast<int>(program.blocks.size());
+	for (int block : body)
+	{
+		program.addBlock(program.blocks[block].label, suffix);
+	}
+
+	// Temporaries defined in the body are numbered anew in each copy
+	copyNumber++;
+	for (int block : body)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Temporary)
+			{
+				temporaryOf[instruction.dest.value] = program.newTemporary();
+				temporaryCopy[instruction.dest.value] = copyNumber;
+			}
+		}
+	}
+
+	for (int block : body)
+	{
+		vector<IrInstruction>& instructions = program.blocks[copyIndex(first, block)].instructions;
+		instructions = program.blocks[block].instructions;
+		for (IrInstruction& instruction : instructions)
+		{
+			// The updates of sums and products wrap, since they now add up
+			// in another order
+			if (IrProgram::isArithmetic(instruction.opcode))
+			{
+				for (const IrOperand* operand : { &instruction.left, &instruction.right })
+				{
+					if (operand->kind == IrOperand::Variable && static_cast<size_t>(operand->value) < kindOf.size()
+						&& (kindOf[operand->value] == Kind::Sum || kindOf[operand->value] == Kind::Product))
+					{
+						instruction.wraps = true;
+					}
+				}
+			}
+			for (IrOperand* operand : { &instruction.dest, &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Temporary && static_cast<size_t>(operand->value) < temporaryCopy.size()
+					&& temporaryCopy[operand->value] == copyNumber)
+				{
+					operand->value = temporaryOf[operand->value];
+				}
+				else if (operand->kind == IrOperand::Variable && accumulatorOf[operand->value] >= 0)
+				{
+					operand->value = accumulatorOf[operand->value];
+				}
+			}
+		}
+
+		IrInstruction& last = instructions.back();
+		for (int* target : { &last.target, &last.falseTarget })
+		{
+			if (*target >= 0)
+			{
+				*target = *target == header ? next : copyIndex(first, *target);
+			}
+		}
+	}
+	return first;
+}
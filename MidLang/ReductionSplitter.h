@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * How ReductionSplitter splits a reduction.
+ */
+struct ReductionSettings
+{
+	int accumulators;	// body copies per test, each with its own accumulators; 1 for none
+	size_t budget;		// most body instructions, over all copies
+
+	ReductionSettings() : accumulators(4), budget(128) {}
+};
+
+/**
+ * ReductionSplitter (Optimization pass on the IR)
+ *
+ * Purpose: Breaks the chain of dependences through the accumulator of a
+ * reduction loop such as
+ *     while (i < n) { v = i * i / 7; s = s + v; if (v > m) { m = v; } i = i + 1; }
+ * so that the C++ compiler can overlap, or vectorize, the iterations.
+ * Every addition to s must otherwise wait for the one before it.
+ *
+ * How it works:
+ * 1. Takes innermost loops whose header tests a counter against a bound
+ *    that is not a constant (loops with a constant bound are left to
+ *    LoopUnroller) and does not change in the loop, where the counter is
+ *    changed once per iteration by i = i + c, toward the bound
+ * 2. A variable is a reduction if the loop reads it only to combine it
+ *    with a value that does not depend on it, and to store the result
+ *    back: s = s + x, s = s - x, s = s * x, or if (x < m) { m = x; } for
+ *    a minimum and if (x > m) { m = x; } for a maximum (also with <= and
+ *    >=). A variable used for more than one of these is not
+ * 3. A new loop runs settings.accumulators copies of the body per test,
+ *    while the counter is at most bound - (accumulators - 1) * c. Copy k
+ *    combines into its own new variable s_k instead of s, which starts
+ *    at 0 for a sum, at 1 for a product and at s for a minimum or
+ *    maximum. After the new loop, s is combined with every s_k, and the
+ *    original loop runs the remaining iterations
+ *
+ * Sums and products are computed modulo 2^32: the new loop's additions
+ * and multiplications wrap, since a partial result may overflow where
+ * the original order would not. Modulo 2^32 + and * are associative and
+ * commutative, and a result that fits in an int is the same as the
+ * original's; minimum and maximum do not depend on the order at all. A
+ * sum or product in a variable narrowed by RangeOptimizer is not split.
+ * The counter goes through the same values as in the original loop. The
+ * new variables make this skip a fragment of a streamed program, whose
+ * later slots are not known yet.
+ */
+class ReductionSplitter
+{
+	enum class Kind
+	{
+		None,		// not stored in the loop
+		Sum,
+		Product,
+		Minimum,
+		Maximum,
+		Other		// stored or read some other way
+	};
+
+	struct Reduction
+	{
+		int slot;
+		Kind kind;
+		int first;		// slot of the accumulator of copy 1; copy k uses first + k - 1
+	};
+
+	ControlFlowGraph graph;
+	std::vector<int> loopOf;
+	std::vector<int> members;
+	std::vector<int> body;				// members other than the header, in block order
+	std::vector<int> position;			// by block: index in body
+	std::vector<int> insertedAfter;		// by block: first block inserted after it, or -1
+	std::vector<int> insertedEnd;
+	std::vector<int> order;
+	std::vector<Kind> kindOf;			// by slot, for the loop being split
+	std::vector<int> reads;				// by slot: reads in the loop that are not part of a reduction
+	std::vector<int> useCount;			// by temporary
+	std::vector<int> temporaryOf;		// by temporary: its number in the copy being made
+	std::vector<int> temporaryCopy;		// by temporary: copy temporaryOf belongs to
+	std::vector<int> accumulatorOf;		// by slot: accumulator of the copy being made, or -1
+	std::vector<Reduction> reductions;
+	int copyNumber;						// counting across runs
+	int labelCounter;
+
+	bool split(IrProgram& program, int header);
+	bool findCounter(const IrProgram& program, int header, const IrOperand& counter, int& step) const;
+	void classify(const IrProgram& program, int header);
+	Kind updateKind(const IrInstruction& instruction, int slot) const;
+	Kind selectKind(const IrProgram& program, int header, int block, int slot);
+	void rewrite(IrProgram& program, int header, int preheader, int entry, const IrOperand& counter,
+		const IrOperand& bound, IrCompare compare, int step);
+	int copyBody(IrProgram& program, int header, int next, const std::string& suffix);
+	int copyIndex(int first, int block) const { return first + position[block]; }
+
+public:
+	ReductionSettings settings;
+
+	// Statistics since the last reset()
+	size_t splitCount;			// loops given a loop of body copies with their own accumulators
+	size_t accumulatorCount;	// accumulator variables added
+
+	ReductionSplitter();
+
+	/**
+	 * Clears the statistics and the label numbering, keeping the settings
+	 * and internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Splits the reductions of a whole program; fragments are left
+	 * unchanged.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,191 @@
+#include "Resolver.h"
+#include "AllocProfiler.h"
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+Resolver::Resolver()
+{
+}
+
+void Resolver::reset()
+{
+	visible.clear();
+	declared.clear();
+	scopeStarts.clear();
+	slotNames.clear();
+	errors.clear();
+}
+
+void Resolver::resolve(ProgramNode* program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	resolveBlock(program->statements);
+	throwErrors();
+	program->slotNames = &slotNames;
+}
+
+void Resolver::resolveTopLevel(Statement* statement)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Analyze);
+	resolveStatement(statement);
+	throwErrors();
+}
+
+const vector<string>& Resolver::slots() const
+{
+	return slotNames;
+}
+
+void Resolver::beginScope()
+{
+	scopeStarts.push_back(declared.size());
+}
+
+void Resolver::endScope()
+{
+	size_t start = scopeStarts.back();
+	scopeStarts.pop_back();
+
+	for (size_t i = start; i < declared.size(); i++)
+	{
+		visible.erase(declared[i]);
+	}
+	declared.resize(start);
+}
+
+void Resolver::resolveBlock(const vector<Statement*>& statements)
+{
+	for (auto* statement : statements)
+	{
+		resolveStatement(statement);
+	}
+}
+
+void Resolver::resolveStatement(Statement* statement)
+{
+	if (VarDeclarationStatement* varDecl = dynamic_cast<VarDeclarationStatement*>(statement))
+	{
+		// The initializer cannot refer to the variable being declared
+		resolveExpression(varDecl->expression);
+		declare(varDecl);
+	}
+	else if (AssignmentStatement* assign = dynamic_cast<AssignmentStatement*>(statement))
+	{
+		resolveExpression(assign->expression);
+
+		auto symbol = visible.find(assign->variableName);
+		if (symbol == visible.end())
+		{
+			stringstream ss;
+			ss << "Assignment to undeclared variable '" << assign->variableName
+				<< "' at line " << assign->line << ", column " << assign->column;
+			errors.push_back(ss.str());
+		}
+		else
+		{
+			assign->slot = symbol->second.slot;
+		}
+	}
+	else if (PrintStatement* print = dynamic_cast<PrintStatement*>(statement))
+	{
+		resolveExpression(print->expression);
+	}
+	else if (PrintLineStatement* println = dynamic_cast<PrintLineStatement*>(statement))
+	{
+		resolveExpression(println->expression);
+	}
+	else if (IfStatement* ifStmt = dynamic_cast<IfStatement*>(statement))
+	{
+		resolveExpression(ifStmt->condition);
+
+		beginScope();
+		resolveBlock(ifStmt->thenStatements);
+		endScope();
+
+		beginScope();
+		resolveBlock(ifStmt->elseStatements);
+		endScope();
+	}
+	else if (WhileStatement* whileStmt = dynamic_cast<WhileStatement*>(statement))
+	{
+		resolveExpression(whileStmt->condition);
+
+		beginScope();
+		resolveBlock(whileStmt->bodyStatements);
+		endScope();
+	}
+}
+
+void Resolver::resolveExpression(Expression* expression)
+{
+	if (VariableReference* varRef = dynamic_cast<VariableReference*>(expression))
+	{
+		auto symbol = visible.find(varRef->name);
+		if (symbol == visible.end())
+		{
+			stringstream ss;
+			ss << "Undeclared variable '" << varRef->name
+				<< "' at line " << varRef->line << ", column " << varRef->column;
+			errors.push_back(ss.str());
+		}
+		else
+		{
+			varRef->slot = symbol->second.slot;
+		}
+	}
+	else if (BinaryExpression* binExpr = dynamic_cast<BinaryExpression*>(expression))
+	{
+		resolveExpression(binExpr->left);
+		resolveExpression(binExpr->right);
+	}
+	else if (BooleanExpression* boolExpr = dynamic_cast<BooleanExpression*>(expression))
+	{
+		resolveExpression(boolExpr->left);
+		resolveExpression(boolExpr->right);
+	}
+}
+
+void Resolver::declare(VarDeclarationStatement* declaration)
+{
+	Symbol symbol = { static_cast<int>(slotNames.size()), declaration->line, declaration->column };
+	auto inserted = visible.emplace(declaration->variableName, symbol);
+	if (!inserted.second)
+	{
+		const Symbol& previous = inserted.first->second;
+		stringstream ss;
+		ss << "Variable '" << declaration->variableName << "' is already declared at line "
+			<< declaration->line << ", column " << declaration->column
+			<< " (previous declaration at line " << previous.line << ", column " << previous.column << ")";
+		errors.push_back(ss.str());
+
+		// Later uses keep referring to the first declaration
+		declaration->slot = previous.slot;
+		return;
+	}
+
+	declaration->slot = symbol.slot;
+	declared.push_back(declaration->variableName);
+	slotNames.push_back(declaration->variableName);
+}
+
+void Resolver::throwErrors()
+{
+	if (errors.empty())
+	{
+		return;
+	}
+
+	stringstream ss;
+	for (size_t i = 0; i < errors.size(); i++)
+	{
+		if (i > 0)
+		{
+			ss << endl;
+		}
+		ss << errors[i];
+	}
+	errors.clear();
+	throw runtime_error(ss.str());
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "AST.h"
+#include "NodePool.h"
+
+/**
+ * Resolver (Semantic Analyzer)
+ *
+ * Purpose: Checks that every variable is declared before it is used, and
+ * numbers the variables so later stages can use array-indexed storage.
+ *
+ * How it works:
+ * 1. Walks the AST in program order, opening a scope for each if, else
+ *    and while block
+ * 2. Gives each VarDeclarationStatement the next free slot (0, 1, 2, ...)
+ * 3. Annotates each VariableReference and AssignmentStatement with the
+ *    slot of the declaration it refers to
+ * 4. Reports undeclared variables, and declarations of a name that is
+ *    already visible (shadowing is not allowed, so the goto-style backend
+ *    can keep all variables in one flat scope)
+ *
+ * Blocks that are not nested in each other may declare the same name;
+ * each declaration gets its own slot.
+ */
+class Resolver
+{
+	struct Symbol
+	{
+		int slot;
+		int line;
+		int column;
+	};
+
+	PooledMap<std::string, Symbol> visible;
+	std::vector<std::string> declared;		// names in declaration order, innermost scope last
+	std::vector<size_t> scopeStarts;		// index into declared where each open scope begins
+	std::vector<std::string> slotNames;
+	std::vector<std::string> errors;
+
+	void beginScope();
+	void endScope();
+	void resolveStatement(Statement* statement);
+	void resolveBlock(const vector<Statement*>& statements);
+	void resolveExpression(Expression* expression);
+	void declare(VarDeclarationStatement* declaration);
+	void throwErrors();
+
+public:
+	Resolver();
+
+	/**
+	 * Forgets all variables, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Resolves a whole program and points it at the slot names, which
+	 * stay valid until reset(). Throws runtime_error listing every
+	 * problem found.
+	 */
+	void resolve(ProgramNode* program);
+
+	/**
+	 * Resolves one top-level statement of a streamed program. Variables
+	 * declared by earlier calls stay visible.
+	 */
+	void resolveTopLevel(Statement* statement);
+
+	/**
+	 * Variable name of each slot assigned so far.
+	 */
+	const std::vector<std::string>& slots() const;
+};
@@ -0,0 +1,244 @@
+#include "SlotAllocator.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+
+using namespace std;
+
+SlotAllocator::SlotAllocator()
+	: words(0), savedSlotCount(0), removedCopyCount(0)
+{
+}
+
+void SlotAllocator::reset()
+{
+	savedSlotCount = 0;
+	removedCopyCount = 0;
+}
+
+void SlotAllocator::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	int slots = static_cast<int>(program.variableNames.size());
+	if (program.fragment || slots < 2)
+	{
+		return;
+	}
+
+	graph.build(program);
+	words = (slots + 63) / 64;
+	computeLiveness(program);
+	findConflicts(program);
+	int count = assignSlots(program);
+	if (count == slots)
+	{
+		return;
+	}
+	renumber(program);
+	savedSlotCount += slots - count;
+}
+
+void SlotAllocator::computeLiveness(const IrProgram& program)
+{
+	size_t size = program.blocks.size() * words;
+	used.assign(size, 0);
+	stored.assign(size, 0);
+	liveIn.assign(size, 0);
+	liveOut.assign(size, 0);
+
+	for (int block : graph.order)
+	{
+		uint64_t* reads = &used[block * words];
+		uint64_t* writes = &stored[block * words];
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable && !has(writes, operand->value))
+				{
+					add(reads, operand->value);
+				}
+			}
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Variable)
+			{
+				add(writes, instruction.dest.value);
+			}
+		}
+	}
+
+	// Backwards problem, so blocks are visited in postorder
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = graph.order.size(); i-- > 0;)
+		{
+			int block = graph.order[i];
+			uint64_t* out = &liveOut[block * words];
+			for (int successor : graph.successors[block])
+			{
+				const uint64_t* in = &liveIn[successor * words];
+				for (size_t w = 0; w < words; w++)
+				{
+					out[w] |= in[w];
+				}
+			}
+
+			uint64_t* in = &liveIn[block * words];
+			const uint64_t* reads = &used[block * words];
+			const uint64_t* writes = &stored[block * words];
+			for (size_t w = 0; w < words; w++)
+			{
+				uint64_t value = reads[w] | (out[w] & ~writes[w]);
+				if (value != in[w])
+				{
+					in[w] = value;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+void SlotAllocator::findConflicts(const IrProgram& program)
+{
+	size_t slots = program.variableNames.size();
+	conflicts.resize(slots);
+	for (size_t slot = 0; slot < slots; slot++)
+	{
+		conflicts[slot].clear();
+	}
+	copiedFrom.assign(slots, -1);
+
+	live.resize(words);
+	for (int block : graph.order)
+	{
+		copy(liveOut.begin() + block * words, liveOut.begin() + (block + 1) * words, live.begin());
+		const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		for (size_t i = instructions.size(); i-- > 0;)
+		{
+			const IrInstruction& instruction = instructions[i];
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Variable)
+			{
+				int slot = instruction.dest.value;
+				int source = instruction.opcode == IrOpcode::Copy && instruction.left.kind == IrOperand::Variable
+					? instruction.left.value : -1;
+				if (source >= 0 && source < slot)
+				{
+					copiedFrom[slot] = source;
+				}
+				for (size_t w = 0; w < words; w++)
+				{
+					int other = static_cast<int>(w * 64);
+					for (uint64_t bits = live[w]; bits != 0; bits >>= 1, other++)
+					{
+						// Slots are numbered in order, so only the later
+						// one of the two needs to know
+						if ((bits & 1) && other != slot && other != source)
+						{
+							conflicts[max(slot, other)].push_back(min(slot, other));
+						}
+					}
+				}
+				remove(live.data(), slot);
+			}
+			for (const IrOperand* operand : { &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable)
+				{
+					add(live.data(), operand->value);
+				}
+			}
+		}
+	}
+}
+
+int SlotAllocator::assignSlots(const IrProgram& program)
+{
+	int slots = static_cast<int>(program.variableNames.size());
+	newSlot.assign(slots, -1);
+	busy.clear();
+	reserved.clear();
+	names.clear();
+
+	// Declaration order, so a slot is reused by the variables declared
+	// after its first one has died, much like a linear scan
+	const uint64_t* entry = &liveIn[0];
+	for (int slot = 0; slot < slots; slot++)
+	{
+		int chosen = -1;
+		if (!has(entry, slot))
+		{
+			for (int other : conflicts[slot])
+			{
+				busy[newSlot[other]] = slot;
+			}
+			int source = copiedFrom[slot];
+			if (source >= 0 && busy[newSlot[source]] != slot && !reserved[newSlot[source]])
+			{
+				chosen = newSlot[source];
+			}
+			for (int candidate = 0; candidate < static_cast<int>(busy.size()) && chosen < 0; candidate++)
+			{
+				if (busy[candidate] != slot && !reserved[candidate])
+				{
+					chosen = candidate;
+				}
+			}
+		}
+		if (chosen < 0)
+		{
+			chosen = static_cast<int>(busy.size());
+			busy.push_back(-1);
+			reserved.push_back(has(entry, slot) ? 1 : 0);
+			names.push_back(program.variableNames[slot]);
+		}
+		newSlot[slot] = chosen;
+	}
+	return static_cast<int>(busy.size());
+}
+
+void SlotAllocator::renumber(IrProgram& program)
+{
+	for (IrBlock& block : program.blocks)
+	{
+		vector<IrInstruction>& instructions = block.instructions;
+		size_t kept = 0;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			IrInstruction& instruction = instructions[i];
+			for (IrOperand* operand : { &instruction.dest, &instruction.left, &instruction.right })
+			{
+				if (operand->kind == IrOperand::Variable)
+				{
+					operand->value = newSlot[operand->value];
+				}
+			}
+			if (instruction.opcode == IrOpcode::Copy && instruction.dest == instruction.left)
+			{
+				removedCopyCount++;
+				continue;
+			}
+			if (kept != i)
+			{
+				instructions[kept] = instruction;
+			}
+			kept++;
+		}
+		instructions.erase(instructions.begin() + kept, instructions.end());
+	}
+
+	// A shared slot must hold the values of all its variables
+	if (!program.variableBits.empty())
+	{
+		bits.assign(names.size(), 8);
+		for (size_t slot = 0; slot < newSlot.size(); slot++)
+		{
+			unsigned char& shared = bits[newSlot[slot]];
+			shared = max(shared, static_cast<unsigned char>(program.bits(static_cast<int>(slot))));
+		}
+		program.variableBits.swap(bits);
+	}
+	program.variableNames.swap(names);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * SlotAllocator (Optimization pass on the IR)
+ *
+ * Purpose: Lets variables whose values are never needed at the same time
+ * share one slot, and so one C++ variable. In
+ *     var a = inputInt(); println(a * 2);
+ *     var b = inputInt(); println(b + 1);
+ * a and b both become a, since a is dead once b is read.
+ *
+ * How it works:
+ * 1. Liveness: the slots each block reads before storing them, and those
+ *    it stores, give the slots live at the start and end of every block,
+ *    iterated backwards over the control flow graph until nothing changes
+ * 2. Interference: walking each block backwards from the slots live at
+ *    its end, a store to a slot conflicts with every other slot live
+ *    right after it (except the one it copies, which holds the same value)
+ * 3. Slots are given new numbers in declaration order, each taking the
+ *    number of a slot it is copied from if it can, so the copy goes away,
+ *    or else the lowest one that no conflicting slot has taken yet
+ * 4. Every operand is renumbered, and copies of a slot to itself are
+ *    removed. The shared slot keeps the name of its first variable, and
+ *    the widest type of all of them
+ *
+ * Slots that may be read before any store keep a slot of their own.
+ * Fragments are left alone, since later statements of a streamed program
+ * still see their variables.
+ */
+class SlotAllocator
+{
+	ControlFlowGraph graph;
+	size_t words;							// 64-bit words per set of slots
+	std::vector<uint64_t> liveIn;			// by block, words each
+	std::vector<uint64_t> liveOut;
+	std::vector<uint64_t> used;				// read before any store in the block
+	std::vector<uint64_t> stored;
+	std::vector<uint64_t> live;				// work space, one set
+	std::vector<std::vector<int>> conflicts;	// by slot: the lower slots it conflicts with
+	std::vector<int> copiedFrom;			// by slot: a lower slot copied to it, or -1
+	std::vector<int> newSlot;				// by slot
+	std::vector<int> busy;					// by new slot: the slot that found it taken last
+	std::vector<char> reserved;				// by new slot: owned by a slot read before any store
+	std::vector<std::string> names;
+	std::vector<unsigned char> bits;		// by new slot
+
+	void computeLiveness(const IrProgram& program);
+	void findConflicts(const IrProgram& program);
+	int assignSlots(const IrProgram& program);		// returns the number of new slots
+	void renumber(IrProgram& program);
+
+	static bool has(const uint64_t* set, int slot) { return (set[slot >> 6] >> (slot & 63)) & 1; }
+	static void add(uint64_t* set, int slot) { set[slot >> 6] |= uint64_t(1) << (slot & 63); }
+	static void remove(uint64_t* set, int slot) { set[slot >> 6] &= ~(uint64_t(1) << (slot & 63)); }
+
+public:
+	// Statistics since the last reset()
+	size_t savedSlotCount;		// slots that no longer have a variable of their own
+	size_t removedCopyCount;	// copies that became a slot copied to itself
+
+	SlotAllocator();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Shares the slots of a whole program. Fragments are not changed.
+	 */
+	void run(IrProgram& program);
+};
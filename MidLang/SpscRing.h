@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * RingStats - Occupancy counters for one SpscRing.
+ *
+ * Producer-side fields are only written by the producer thread and
+ * consumer-side fields only by the consumer thread, so they need no
+ * synchronization; read them after both threads have finished.
+ */
+struct RingStats
+{
+	// Producer side
+	size_t pushes = 0;
+	size_t occupancySum = 0;	// items already queued, summed over pushes
+	size_t maxOccupancy = 0;
+	size_t fullWaits = 0;		// times the producer had to wait for room
+	size_t fullSleeps = 0;		// of those, times it went to sleep
+
+	// Consumer side
+	size_t emptyWaits = 0;		// times the consumer had to wait for an item
+	size_t emptySleeps = 0;		// of those, times it went to sleep
+
+	double averageOccupancy() const
+	{
+		return pushes == 0 ? 0.0 : static_cast<double>(occupancySum) / pushes;
+	}
+};
+
+/**
+ * SpscRing - Single-producer / single-consumer ring buffer, lock-free
+ * unless one side has to sleep.
+ *
+ * How it works:
+ * 1. The producer writes a slot and then publishes it by advancing tail
+ * 2. The consumer reads a slot and then releases it by advancing head
+ * 3. Each index is written by exactly one thread, so acquire/release
+ *    ordering on the two counters is all the synchronization needed
+ * 4. A blocking push or pop yields for a while, then sleeps on a
+ *    condition variable so an idle stage gives its core away. The other
+ *    side only takes the lock to wake it when a sleeper is registered
+ */
+template <typename T>
+class SpscRing
+{
+	std::vector<T> slots;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head;	// next slot to read (consumer)
+	alignas(64) std::atomic<size_t> tail;	// next slot to write (producer)
+	alignas(64) std::atomic<int> sleepers;	// threads in wait(), 0 or 1
+	std::mutex lock;
+	std::condition_variable changed;
+
+	static const int spinCount = 64;		// yields before going to sleep
+
+	/**
+	 * Wakes the other side if it sleeps. Called after publishing head or
+	 * tail; the fence orders that store before the sleepers load, pairing
+	 * with the one in wait().
+	 */
+	void notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) != 0)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			changed.notify_all();
+		}
+	}
+
+	/**
+	 * Retries attempt() until it succeeds, returning true, or until
+	 * cancelled is set, returning false. ready() tells without side
+	 * effects whether attempt() would succeed now. Cancelling does not
+	 * notify, so a sleeper checks the flag again every millisecond.
+	 */
+	template <typename Attempt, typename Ready>
+	bool wait(Attempt attempt, Ready ready, const std::atomic<bool>& cancelled, size_t& sleeps)
+	{
+		bool slept = false;
+		for (int spin = 0; !attempt(); spin++)
+		{
+			if (cancelled.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			if (spin < spinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> guard(lock);
+			sleepers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!ready() && !cancelled.load(std::memory_order_acquire))
+			{
+				if (!slept)
+				{
+					sleeps++;
+					slept = true;
+				}
+				changed.wait_for(guard, std::chrono::milliseconds(1));
+			}
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+public:
+	RingStats stats;
+
+	/**
+	 * Capacity is rounded up to a power of two.
+	 */
+	explicit SpscRing(size_t capacity)
+		: head(0), tail(0), sleepers(0)
+	{
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	size_t capacity() const
+	{
+		return slots.size();
+	}
+
+	/**
+	 * Moves item into the ring. Returns false (leaving item untouched)
+	 * if the ring is full. Producer thread only.
+	 */
+	bool tryPush(T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t occupancy = t - head.load(std::memory_order_acquire);
+		if (occupancy == slots.size())
+		{
+			return false;
+		}
+
+		slots[t & mask] = std::move(item);
+		tail.store(t + 1, std::memory_order_release);
+		notify();
+
+		stats.pushes++;
+		stats.occupancySum += occupancy;
+		if (occupancy > stats.maxOccupancy)
+		{
+			stats.maxOccupancy = occupancy;
+		}
+		return true;
+	}
+
+	/**
+	 * Moves the oldest item out of the ring. Returns false if the ring
+	 * is empty. Consumer thread only.
+	 */
+	bool tryPop(T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		notify();
+		return true;
+	}
+
+	/**
+	 * Blocking push: waits until there is room. Returns false if
+	 * cancelled is set while waiting.
+	 */
+	bool push(T& item, const std::atomic<bool>& cancelled)
+	{
+		if (tryPush(item))
+		{
+			return true;
+		}
+
+		stats.fullWaits++;
+		return wait([&]() { return tryPush(item); },
+			[&]() { return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) < capacity(); },
+			cancelled, stats.fullSleeps);
+	}
+
+	/**
+	 * Blocking pop: waits until an item arrives. Returns false if
+	 * cancelled is set (e.g. the producer has finished) and the ring
+	 * is empty.
+	 */
+	bool pop(T& item, const std::atomic<bool>& cancelled)
+	{
+		if (tryPop(item))
+		{
+			return true;
+		}
+
+		stats.emptyWaits++;
+		// The producer may have pushed a last item before finishing
+		return wait([&]() { return tryPop(item); },
+			[&]() { return head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire); },
+			cancelled, stats.emptySleeps) || tryPop(item);
+	}
+};
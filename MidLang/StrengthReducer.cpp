@@ -0,0 +1,482 @@
+#include "StrengthReducer.h"
+#include "AllocProfiler.h"
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	IrInstruction operation(IrOpcode opcode, const IrOperand& dest, const IrOperand& left, const IrOperand& right)
+	{
+		IrInstruction instruction(opcode);
+		instruction.dest = dest;
+		instruction.left = left;
+		instruction.right = right;
+		return instruction;
+	}
+
+	int lowestBit(unsigned value)
+	{
+		int bit = 0;
+		while ((value & 1) == 0)
+		{
+			value >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+
+	int highestBit(unsigned value)
+	{
+		int bit = 0;
+		while (value >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+
+	bool isPowerOfTwo(unsigned value)
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+}
+
+StrengthReducer::StrengthReducer()
+	: loopNumber(0), reducedCount(0), inductionCount(0)
+{
+}
+
+void StrengthReducer::reset()
+{
+	reducedCount = 0;
+	inductionCount = 0;
+}
+
+void StrengthReducer::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	if (!program.fragment && program.blocks.size() >= 2)
+	{
+		graph.build(program);
+		loopOf.assign(program.blocks.size(), -1);
+		for (size_t i = graph.order.size(); i-- > 0;)
+		{
+			reduceInductionVariables(program, graph.order[i]);
+		}
+	}
+
+	// Ranges show which dividends are never negative
+	bool divides = false;
+	for (const IrBlock& block : program.blocks)
+	{
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			divides |= instruction.opcode == IrOpcode::Divide && instruction.right.kind == IrOperand::Constant;
+		}
+	}
+	bool knowsRanges = false;
+	if (divides)
+	{
+		graph.build(program);
+		knowsRanges = ranges.compute(program, graph);
+	}
+
+	for (size_t b = 0; b < program.blocks.size(); b++)
+	{
+		IrBlock& block = program.blocks[b];
+		bool found = false;
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			found |= instruction.opcode == IrOpcode::Multiply || instruction.opcode == IrOpcode::Divide;
+		}
+		if (!found)
+		{
+			continue;
+		}
+
+		bool reached = knowsRanges && ranges.isReached(static_cast<int>(b));
+		if (reached)
+		{
+			ranges.enter(static_cast<int>(b));
+		}
+		rewritten.clear();
+		for (const IrInstruction& instruction : block.instructions)
+		{
+			bool nonNegative = reached && ranges.range(instruction.left).low >= 0;
+			if (!reduceMultiply(program, instruction, rewritten)
+				&& !reduceDivide(program, instruction, nonNegative, rewritten))
+			{
+				rewritten.push_back(instruction);
+			}
+			if (reached)
+			{
+				ranges.step(instruction);
+			}
+		}
+		block.instructions.swap(rewritten);
+	}
+}
+
+void StrengthReducer::reduceInductionVariables(IrProgram& program, int header)
+{
+	if (!graph.collectLoop(header, members, loopOf))
+	{
+		return;
+	}
+	int preheader = graph.findPreheader(program, header, loopOf);
+	if (preheader < 0)
+	{
+		return;
+	}
+
+	loopNumber++;
+	if (storedIn.size() < program.variableNames.size())
+	{
+		storedIn.resize(program.variableNames.size(), -1);
+		induction.resize(program.variableNames.size(), 0);
+	}
+	for (int block : members)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (!instruction.definesValue() || instruction.dest.kind != IrOperand::Variable)
+			{
+				continue;
+			}
+			int slot = instruction.dest.value;
+			if (storedIn[slot] != loopNumber)
+			{
+				storedIn[slot] = loopNumber;
+				induction[slot] = 1;
+			}
+			if (increment(instruction) == 0)
+			{
+				induction[slot] = 0;
+			}
+		}
+	}
+
+	// Products of an induction variable and a constant whose additive
+	// updates fit in an int
+	auto isInduction = [this](const IrOperand& operand)
+	{
+		return operand.kind == IrOperand::Variable && storedIn[operand.value] == loopNumber && induction[operand.value];
+	};
+	auto updatesFit = [&](int slot, int factor)
+	{
+		for (int block : members)
+		{
+			for (const IrInstruction& instruction : program.blocks[block].instructions)
+			{
+				long long update = static_cast<long long>(increment(instruction)) * factor;
+				if (instruction.dest.kind == IrOperand::Variable && instruction.dest.value == slot
+					&& (update < INT_MIN || update > INT_MAX))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	scaled.clear();
+	for (int block : members)
+	{
+		for (const IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			if (instruction.opcode != IrOpcode::Multiply || instruction.wraps)
+			{
+				continue;
+			}
+			const IrOperand& variable = isInduction(instruction.left) ? instruction.left : instruction.right;
+			const IrOperand& factor = isInduction(instruction.left) ? instruction.right : instruction.left;
+			if (!isInduction(variable) || factor.kind != IrOperand::Constant || factor.value < 2
+				|| findScaled(variable.value, factor.value) >= 0 || !updatesFit(variable.value, factor.value))
+			{
+				continue;
+			}
+
+			Scaled product;
+			product.slot = variable.value;
+			product.factor = factor.value;
+			product.scaled = static_cast<int>(program.variableNames.size());
+			program.variableNames.push_back(program.variableNames[product.slot] + "_x" + to_string(product.factor));
+			scaled.push_back(product);
+		}
+	}
+	if (scaled.empty())
+	{
+		return;
+	}
+
+	// The new variables wrap around: the loop may not run at all, or stop
+	// before i * k is reached, so their values may be ones the program
+	// never computes. Where i * k was used, it fit and so does the variable
+	vector<IrInstruction>& before = program.blocks[preheader].instructions;
+	for (const Scaled& product : scaled)
+	{
+		IrInstruction start = operation(IrOpcode::Multiply, IrOperand::variable(product.scaled),
+			IrOperand::variable(product.slot), IrOperand::constant(product.factor));
+		start.wraps = true;
+		before.insert(before.end() - 1, start);
+	}
+
+	for (int block : members)
+	{
+		vector<IrInstruction>& instructions = program.blocks[block].instructions;
+		rewritten.clear();
+		for (const IrInstruction& instruction : instructions)
+		{
+			if (instruction.opcode == IrOpcode::Multiply && !instruction.wraps)
+			{
+				const IrOperand& variable = isInduction(instruction.left) ? instruction.left : instruction.right;
+				const IrOperand& factor = isInduction(instruction.left) ? instruction.right : instruction.left;
+				int index = isInduction(variable) && factor.kind == IrOperand::Constant
+					? findScaled(variable.value, factor.value) : -1;
+				if (index >= 0)
+				{
+					IrInstruction copy(IrOpcode::Copy);
+					copy.dest = instruction.dest;
+					copy.left = IrOperand::variable(scaled[index].scaled);
+					rewritten.push_back(copy);
+					inductionCount++;
+					continue;
+				}
+			}
+
+			rewritten.push_back(instruction);
+			int step = increment(instruction);
+			if (step == 0 || !isInduction(instruction.dest))
+			{
+				continue;
+			}
+			for (const Scaled& product : scaled)
+			{
+				if (product.slot == instruction.dest.value)
+				{
+					IrOperand target = IrOperand::variable(product.scaled);
+					rewritten.push_back(operation(IrOpcode::Add, target, target,
+						IrOperand::constant(step * product.factor)));
+					rewritten.back().wraps = true;
+				}
+			}
+		}
+		instructions.swap(rewritten);
+	}
+}
+
+int StrengthReducer::increment(const IrInstruction& instruction) const
+{
+	const IrOperand& dest = instruction.dest;
+	if (dest.kind != IrOperand::Variable)
+	{
+		return 0;
+	}
+	if (instruction.opcode == IrOpcode::Add)
+	{
+		if (instruction.left == dest && instruction.right.kind == IrOperand::Constant)
+		{
+			return instruction.right.value;
+		}
+		if (instruction.right == dest && instruction.left.kind == IrOperand::Constant)
+		{
+			return instruction.left.value;
+		}
+	}
+	if (instruction.opcode == IrOpcode::Subtract && instruction.left == dest
+		&& instruction.right.kind == IrOperand::Constant && instruction.right.value != INT_MIN)
+	{
+		return -instruction.right.value;
+	}
+	return 0;
+}
+
+int StrengthReducer::findScaled(int slot, int factor) const
+{
+	for (size_t i = 0; i < scaled.size(); i++)
+	{
+		if (scaled[i].slot == slot && scaled[i].factor == factor)
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+bool StrengthReducer::reduceMultiply(IrProgram& program, const IrInstruction& instruction, vector<IrInstruction>& out)
+{
+	if (instruction.opcode != IrOpcode::Multiply || instruction.wraps)
+	{
+		return false;	// the shifts could overflow where the product wraps
+	}
+
+	IrOperand value = instruction.left;
+	IrOperand factor = instruction.right;
+	if (value.kind == IrOperand::Constant)
+	{
+		swap(value, factor);
+	}
+	if (value.kind == IrOperand::Constant || factor.kind != IrOperand::Constant || factor.value < 2)
+	{
+		return false;
+	}
+
+	// Only one or two bits set: with more, the shifts cost more than the
+	// multiplication, and x * (2^a - 2^b) could overflow in x << a
+	unsigned bits = static_cast<unsigned>(factor.value);
+	int high = highestBit(bits);
+	unsigned rest = bits - (1u << high);
+	if (rest != 0 && !isPowerOfTwo(rest))
+	{
+		return false;
+	}
+
+	if (rest == 0)
+	{
+		out.push_back(operation(IrOpcode::ShiftLeft, instruction.dest, value, IrOperand::constant(high)));
+	}
+	else
+	{
+		IrOperand shifted = IrOperand::temporary(program.newTemporary());
+		out.push_back(operation(IrOpcode::ShiftLeft, shifted, value, IrOperand::constant(high)));
+		IrOperand other = value;
+		int low = lowestBit(rest);
+		if (low > 0)
+		{
+			other = IrOperand::temporary(program.newTemporary());
+			out.push_back(operation(IrOpcode::ShiftLeft, other, value, IrOperand::constant(low)));
+		}
+		out.push_back(operation(IrOpcode::Add, instruction.dest, shifted, other));
+	}
+	reducedCount++;
+	return true;
+}
+
+bool StrengthReducer::reduceDivide(IrProgram& program, const IrInstruction& instruction, bool nonNegative,
+	vector<IrInstruction>& out)
+{
+	if (instruction.opcode != IrOpcode::Divide || instruction.left.kind == IrOperand::Constant
+		|| instruction.right.kind != IrOperand::Constant)
+	{
+		return false;
+	}
+
+	// x / 0 and INT_MIN / -1 must still trap; x / 1 and x / INT_MIN are
+	// not worth it
+	int divisor = instruction.right.value;
+	if (divisor == 0 || divisor == 1 || divisor == -1 || divisor == INT_MIN)
+	{
+		return false;
+	}
+
+	if (divisor > 0)
+	{
+		dividePositive(program, instruction.left, divisor, nonNegative, instruction.dest, out);
+	}
+	else
+	{
+		// Rounding toward zero makes x / -d equal to -(x / d)
+		IrOperand quotient = IrOperand::temporary(program.newTemporary());
+		dividePositive(program, instruction.left, -divisor, nonNegative, quotient, out);
+		out.push_back(operation(IrOpcode::Subtract, instruction.dest, IrOperand::constant(0), quotient));
+	}
+	reducedCount++;
+	return true;
+}
+
+void StrengthReducer::dividePositive(IrProgram& program, const IrOperand& dividend, int divisor, bool nonNegative,
+	const IrOperand& dest, vector<IrInstruction>& out)
+{
+	if (isPowerOfTwo(static_cast<unsigned>(divisor)) && nonNegative)
+	{
+		out.push_back(operation(IrOpcode::ShiftRight, dest, dividend,
+			IrOperand::constant(lowestBit(static_cast<unsigned>(divisor)))));
+		return;
+	}
+	if (isPowerOfTwo(static_cast<unsigned>(divisor)))
+	{
+		// The top k bits of x >> (k - 1) are copies of the sign, so
+		// shifting them down gives 2^k - 1 for a negative x and 0 otherwise
+		int k = lowestBit(static_cast<unsigned>(divisor));
+		IrOperand sign = dividend;
+		if (k > 1)
+		{
+			sign = IrOperand::temporary(program.newTemporary());
+			out.push_back(operation(IrOpcode::ShiftRight, sign, dividend, IrOperand::constant(k - 1)));
+		}
+		IrOperand bias = IrOperand::temporary(program.newTemporary());
+		out.push_back(operation(IrOpcode::ShiftRightLogical, bias, sign, IrOperand::constant(32 - k)));
+		IrOperand biased = IrOperand::temporary(program.newTemporary());
+		out.push_back(operation(IrOpcode::Add, biased, dividend, bias));
+		out.push_back(operation(IrOpcode::ShiftRight, dest, biased, IrOperand::constant(k)));
+		return;
+	}
+
+	int multiplier;
+	int shift;
+	divisionMagic(divisor, multiplier, shift);
+
+	IrOperand high = IrOperand::temporary(program.newTemporary());
+	out.push_back(operation(IrOpcode::MultiplyHigh, high, dividend, IrOperand::constant(multiplier)));
+	if (multiplier < 0)
+	{
+		// M stands for M + 2^32 here
+		IrOperand corrected = IrOperand::temporary(program.newTemporary());
+		out.push_back(operation(IrOpcode::Add, corrected, high, dividend));
+		high = corrected;
+	}
+	if (shift > 0)
+	{
+		IrOperand shifted = IrOperand::temporary(program.newTemporary());
+		out.push_back(operation(IrOpcode::ShiftRight, shifted, high, IrOperand::constant(shift)));
+		high = shifted;
+	}
+	if (nonNegative)
+	{
+		out.back().dest = dest;		// nothing to round up
+		return;
+	}
+	IrOperand negative = IrOperand::temporary(program.newTemporary());
+	out.push_back(operation(IrOpcode::ShiftRightLogical, negative, dividend, IrOperand::constant(31)));
+	out.push_back(operation(IrOpcode::Add, dest, high, negative));
+}
+
+void StrengthReducer::divisionMagic(int divisor, int& multiplier, int& shift)
+{
+	// Smallest p with 2^p > nc * (d - 2^p mod d), where nc is the largest
+	// dividend for which nc mod d = d - 1
+	const unsigned two31 = 0x80000000u;
+	unsigned d = static_cast<unsigned>(divisor);
+	unsigned nc = two31 - 1 - two31 % d;
+	int p = 31;
+	unsigned q1 = two31 / nc;
+	unsigned r1 = two31 - q1 * nc;
+	unsigned q2 = two31 / d;
+	unsigned r2 = two31 - q2 * d;
+	unsigned delta;
+	do
+	{
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= nc)
+		{
+			q1++;
+			r1 -= nc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= d)
+		{
+			q2++;
+			r2 -= d;
+		}
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	multiplier = static_cast<int>(q2 + 1);
+	shift = p - 32;
+}
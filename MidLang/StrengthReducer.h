@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+#include "ValueRanges.h"
+
+/**
+ * StrengthReducer (Optimization pass on the IR)
+ *
+ * Purpose: Replaces multiplications and divisions by constants with
+ * cheaper shifts, additions and multiplications.
+ *
+ * How it works:
+ * 1. In a loop, a variable whose only stores are i = i + c or i = i - c
+ *    is an induction variable. Each i * k in the loop is replaced by a
+ *    new variable that starts at i * k before the loop and is increased
+ *    by c * k wherever i is increased
+ * 2. x * 2^a becomes x << a, and x * (2^a + 2^b) becomes
+ *    (x << a) + (x << b)
+ * 3. x / 2^k adds 2^k - 1 to a negative x and shifts it right by k, so
+ *    the quotient is rounded toward zero like the C++ division
+ * 4. x / d for any other d (except 0, 1, -1 and INT_MIN) takes the upper
+ *    half of x * M for a "magic" M, shifts it right and adds 1 for a
+ *    negative x (Hacker's Delight, chapter 10). A negative d divides by
+ *    -d and negates the quotient
+ * 5. Where ValueRanges shows that x is never negative, steps 3 and 4
+ *    leave out the correction for a negative x: x / 8 becomes x >> 3
+ *
+ * No rewrite adds an overflow that the original did not have; the
+ * variables of step 1 wrap around, since they are computed before the
+ * loop and increased once more than i * k is used. A left shift is
+ * written as an unsigned shift, since shifting a negative number left is
+ * undefined before C++20; shifting it right is defined in C++20, and by
+ * GCC, Clang and MSVC for earlier standards. Step 1 needs
+ * new variable slots, so it is skipped for a fragment of a streamed
+ * program, whose later slots are not known yet.
+ */
+class StrengthReducer
+{
+	struct Scaled
+	{
+		int slot;		// of the induction variable
+		int factor;
+		int scaled;		// slot of the variable that holds slot * factor
+	};
+
+	ControlFlowGraph graph;
+	ValueRanges ranges;
+	std::vector<int> loopOf;
+	std::vector<int> members;
+	std::vector<int> storedIn;		// by slot: number of the last loop found to store it
+	std::vector<char> induction;	// by slot: all of its stores in that loop are increments
+	int loopNumber;					// counting across runs
+	std::vector<Scaled> scaled;		// of the loop being processed
+	std::vector<IrInstruction> rewritten;
+
+	void reduceInductionVariables(IrProgram& program, int header);
+	int increment(const IrInstruction& instruction) const;	// step of i = i + c, or 0
+	int findScaled(int slot, int factor) const;
+	void reduce(IrProgram& program, const IrInstruction& instruction, std::vector<IrInstruction>& out);
+	bool reduceMultiply(IrProgram& program, const IrInstruction& instruction, std::vector<IrInstruction>& out);
+	bool reduceDivide(IrProgram& program, const IrInstruction& instruction, bool nonNegative,
+		std::vector<IrInstruction>& out);
+	void dividePositive(IrProgram& program, const IrOperand& dividend, int divisor, bool nonNegative,
+		const IrOperand& dest, std::vector<IrInstruction>& out);
+
+public:
+	// Statistics since the last reset()
+	size_t reducedCount;		// multiplications and divisions rewritten
+	size_t inductionCount;		// induction variable products made additive
+
+	StrengthReducer();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Reduces a whole program or one fragment in place.
+	 */
+	void run(IrProgram& program);
+
+	/**
+	 * The multiplier M and shift s for signed division by divisor (at
+	 * least 2, not a power of 2): x / divisor is the upper half of x * M,
+	 * plus x if M is negative, shifted right by s, plus 1 if x < 0.
+	 */
+	static void divisionMagic(int divisor, int& multiplier, int& shift);
+};
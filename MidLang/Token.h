@@ -2,6 +2,7 @@
 #define TOKEN_H
 
 #include <string>
+#include <utility>
 
 /**
  * TokenType - Types of tokens in MidLang Stage 1
@@ -63,8 +64,22 @@ public:
     int line;
     int column;
 
-    Token(TokenType t, const std::string& v, int l, int c)
-        : type(t), value(v), line(l), column(c) {}
+    Token(TokenType t, std::string v, int l, int c)
+        : type(t), value(std::move(v)), line(l), column(c) {}
+};
+
+/**
+ * TokenSource - Anything the parser can pull tokens from one at a time.
+ * Implemented by the Lexer, and by the token queue of the pipeline.
+ */
+class TokenSource {
+public:
+    virtual ~TokenSource() = default;
+
+    /**
+     * Returns the next token; EOF_TOKEN once the input is exhausted.
+     */
+    virtual Token next() = 0;
 };
 
 #endif // TOKEN_H
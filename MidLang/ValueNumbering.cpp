@@ -0,0 +1,331 @@
+#include "ValueNumbering.h"
+#include "AllocProfiler.h"
+
+using namespace std;
+
+ValueNumbering::ValueNumbering()
+	: reusedCount(0)
+{
+}
+
+void ValueNumbering::reset()
+{
+	reusedCount = 0;
+}
+
+void ValueNumbering::run(IrProgram& program)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	int count = static_cast<int>(program.blocks.size());
+	graph.build(program);
+	children.resize(count);
+	for (int block = 0; block < count; block++)
+	{
+		children[block].clear();
+	}
+	for (int block : graph.order)
+	{
+		if (block != 0)
+		{
+			children[graph.dominator[block]].push_back(block);
+		}
+	}
+
+	// Each variable starts with its own unknown value
+	holder.clear();
+	expressions.clear();
+	constants.clear();
+	log.clear();
+	numberOfVariable.resize(program.variableNames.size());
+	for (size_t slot = 0; slot < program.variableNames.size(); slot++)
+	{
+		numberOfVariable[slot] = newValue();
+		holder.back() = IrOperand::variable(static_cast<int>(slot));
+	}
+	numberOfTemporary.assign(program.temporaryCount, -1);
+	replacement.assign(program.temporaryCount, IrOperand());
+	visited.assign(count, -1);
+	killed.assign(program.variableNames.size(), -1);
+	logMark.resize(count);
+
+	// Depth first along the dominator tree, undoing what a block learned
+	// when its subtree is done
+	stack.clear();
+	stack.push_back(make_pair(0, 0));
+	logMark[0] = log.size();
+	visit(program, 0);
+	while (!stack.empty())
+	{
+		pair<int, size_t>& top = stack.back();
+		if (top.second < children[top.first].size())
+		{
+			int child = children[top.first][top.second++];
+			stack.push_back(make_pair(child, 0));
+			logMark[child] = log.size();
+			visit(program, child);
+			continue;
+		}
+		undo(logMark[top.first]);
+		stack.pop_back();
+	}
+
+	// Unreachable blocks are not visited, but may still be written out
+	for (int block = 0; block < count; block++)
+	{
+		if (graph.isReachable(block))
+		{
+			continue;
+		}
+		for (IrInstruction& instruction : program.blocks[block].instructions)
+		{
+			rename(instruction.left);
+			rename(instruction.right);
+		}
+	}
+}
+
+void ValueNumbering::visit(IrProgram& program, int block)
+{
+	if (block != 0)
+	{
+		killStores(program, block);
+	}
+
+	vector<IrInstruction>& instructions = program.blocks[block].instructions;
+	size_t kept = 0;
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		IrInstruction& instruction = instructions[i];
+		rename(instruction.left);
+		rename(instruction.right);
+		if (number(instruction))
+		{
+			if (kept != i)
+			{
+				instructions[kept] = instruction;
+			}
+			kept++;
+		}
+	}
+	instructions.erase(instructions.begin() + kept, instructions.end());
+}
+
+void ValueNumbering::killStores(const IrProgram& program, int block)
+{
+	// The block continues from the end of its immediate dominator, unless
+	// other blocks can run in between
+	int dominator = graph.dominator[block];
+	const vector<int>& sources = graph.predecessors[block];
+	if (sources.size() == 1 && sources[0] == dominator)
+	{
+		return;
+	}
+
+	pending.clear();
+	for (int source : sources)
+	{
+		if (source != dominator && visited[source] != block)
+		{
+			visited[source] = block;
+			pending.push_back(source);
+		}
+	}
+	while (!pending.empty())
+	{
+		int current = pending.back();
+		pending.pop_back();
+		for (const IrInstruction& instruction : program.blocks[current].instructions)
+		{
+			if (instruction.definesValue() && instruction.dest.kind == IrOperand::Variable
+				&& killed[instruction.dest.value] != block)
+			{
+				killed[instruction.dest.value] = block;
+				setVariable(instruction.dest.value, newValue());
+			}
+		}
+		for (int source : graph.predecessors[current])
+		{
+			if (source != dominator && visited[source] != block)
+			{
+				visited[source] = block;
+				pending.push_back(source);
+			}
+		}
+	}
+}
+
+bool ValueNumbering::number(IrInstruction& instruction)
+{
+	if (!instruction.definesValue())
+	{
+		return true;
+	}
+
+	int value;
+	if (instruction.opcode == IrOpcode::Input)
+	{
+		value = newValue();
+	}
+	else if (instruction.opcode == IrOpcode::Copy)
+	{
+		value = valueOf(instruction.left);
+	}
+	else
+	{
+		Expression expression;
+		expression.opcode = instruction.opcode;
+		expression.wraps = instruction.wraps;
+		expression.left = valueOf(instruction.left);
+		expression.right = valueOf(instruction.right);
+		bool commutative = instruction.opcode == IrOpcode::Add || instruction.opcode == IrOpcode::Multiply
+			|| instruction.opcode == IrOpcode::MultiplyHigh;
+		if (commutative && expression.left > expression.right)
+		{
+			swap(expression.left, expression.right);
+		}
+
+		auto found = expressions.find(expression);
+		if (found == expressions.end())
+		{
+			value = newValue();
+			expressions.emplace(expression, value);
+			Change change;
+			change.kind = Change::Added;
+			change.expression = expression;
+			log.push_back(change);
+		}
+		else
+		{
+			value = found->second;
+			IrOperand earlier = availableHolder(value);
+			if (earlier.kind != IrOperand::None)
+			{
+				reusedCount++;
+				if (earlier == instruction.dest)
+				{
+					return false;	// the variable already holds it
+				}
+				if (instruction.dest.kind == IrOperand::Temporary && earlier.kind != IrOperand::Variable)
+				{
+					replacement[instruction.dest.value] = earlier;
+					return false;
+				}
+
+				// A variable may change before the uses of the result, so
+				// it is copied here
+				instruction.opcode = IrOpcode::Copy;
+				instruction.left = earlier;
+				instruction.right = IrOperand();
+				instruction.wraps = false;
+			}
+		}
+	}
+
+	if (instruction.dest.kind == IrOperand::Temporary)
+	{
+		numberOfTemporary[instruction.dest.value] = value;
+	}
+	else
+	{
+		setVariable(instruction.dest.value, value);
+	}
+	if (availableHolder(value).kind == IrOperand::None)
+	{
+		setHolder(value, instruction.dest);
+	}
+	return true;
+}
+
+int ValueNumbering::newValue()
+{
+	holder.push_back(IrOperand());
+	return static_cast<int>(holder.size()) - 1;
+}
+
+int ValueNumbering::valueOf(const IrOperand& operand)
+{
+	switch (operand.kind)
+	{
+	case IrOperand::Constant:
+	{
+		auto found = constants.find(operand.value);
+		if (found != constants.end())
+		{
+			return found->second;
+		}
+		int value = newValue();
+		holder[value] = operand;	// the same in every block, so never undone
+		constants.emplace(operand.value, value);
+		return value;
+	}
+	case IrOperand::Variable:
+		return numberOfVariable[operand.value];
+	default:
+		if (numberOfTemporary[operand.value] < 0)
+		{
+			numberOfTemporary[operand.value] = newValue();
+		}
+		return numberOfTemporary[operand.value];
+	}
+}
+
+IrOperand ValueNumbering::availableHolder(int value) const
+{
+	const IrOperand& current = holder[value];
+	if (current.kind == IrOperand::Variable && numberOfVariable[current.value] != value)
+	{
+		return IrOperand();		// stored since
+	}
+	return current;
+}
+
+void ValueNumbering::setVariable(int slot, int value)
+{
+	Change change;
+	change.kind = Change::VariableNumber;
+	change.index = slot;
+	change.oldNumber = numberOfVariable[slot];
+	log.push_back(change);
+	numberOfVariable[slot] = value;
+}
+
+void ValueNumbering::setHolder(int value, const IrOperand& operand)
+{
+	Change change;
+	change.kind = Change::Holder;
+	change.index = value;
+	change.oldHolder = holder[value];
+	log.push_back(change);
+	holder[value] = operand;
+}
+
+void ValueNumbering::rename(IrOperand& operand) const
+{
+	if (operand.kind == IrOperand::Temporary && replacement[operand.value].kind != IrOperand::None)
+	{
+		operand = replacement[operand.value];
+	}
+}
+
+void ValueNumbering::undo(size_t mark)
+{
+	while (log.size() > mark)
+	{
+		const Change& change = log.back();
+		switch (change.kind)
+		{
+		case Change::VariableNumber:
+			numberOfVariable[change.index] = change.oldNumber;
+			break;
+		case Change::Holder:
+			holder[change.index] = change.oldHolder;
+			break;
+		case Change::Added:
+			expressions.erase(change.expression);
+			break;
+		}
+		log.pop_back();
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+#include "NodePool.h"
+
+/**
+ * ValueNumbering (Optimization pass on the IR)
+ *
+ * Purpose: Computes each repeated expression once. In
+ *     x = (a * b + c) * (a * b + c);
+ * a * b + c is computed a single time, and later uses of a * b in blocks
+ * that can only be reached through this one reuse it as well.
+ *
+ * How it works:
+ * 1. Every value gets a number. Equal constants have the same number, a
+ *    copy has the number of what it copies, and an operation has the same
+ *    number as an earlier one with the same operator and operand numbers
+ *    (in either order for + and *)
+ * 2. An operation whose number is already held by a temporary, a constant
+ *    or a variable that still holds it is replaced: a temporary by the
+ *    holder everywhere it is used, a variable store by a copy
+ * 3. Storing a variable gives it a new number, so expressions that read
+ *    its old value no longer match
+ * 4. Blocks are visited along the dominator tree, and each starts with
+ *    the numbers at the end of its immediate dominator. Variables stored
+ *    on a path from there to the block (around a loop, or in the other
+ *    branch of an if) get new numbers first
+ *
+ * inputInt() always gives a new number, so two reads are never merged.
+ */
+class ValueNumbering
+{
+	struct Expression
+	{
+		IrOpcode opcode;
+		bool wraps;
+		int left;		// value numbers
+		int right;
+
+		bool operator==(const Expression& other) const
+		{
+			return opcode == other.opcode && wraps == other.wraps && left == other.left && right == other.right;
+		}
+	};
+
+	struct ExpressionHash
+	{
+		size_t operator()(const Expression& expression) const
+		{
+			size_t hash = static_cast<size_t>(expression.opcode) * 2 + (expression.wraps ? 1 : 0);
+			hash = hash * 1000003u ^ static_cast<size_t>(expression.left);
+			return hash * 1000003u ^ static_cast<size_t>(expression.right);
+		}
+	};
+
+	// An entry of the undo log, restored when the walk leaves a block
+	struct Change
+	{
+		enum Kind
+		{
+			VariableNumber,		// index: slot
+			Holder,				// index: value number
+			Added				// expression
+		};
+
+		Kind kind;
+		int index;
+		int oldNumber;			// VariableNumber
+		IrOperand oldHolder;	// Holder
+		Expression expression;	// Added
+	};
+
+	ControlFlowGraph graph;
+	std::vector<std::vector<int>> children;		// by block, in the dominator tree
+	std::vector<std::pair<int, size_t>> stack;	// block and next child
+	std::vector<size_t> logMark;				// by block: undo log size when it was entered
+	std::vector<int> numberOfVariable;			// by slot
+	std::vector<int> numberOfTemporary;			// -1 until defined
+	std::vector<IrOperand> holder;				// by value number: a constant, temporary or variable
+	std::vector<IrOperand> replacement;			// by temporary: what its uses read instead
+	PooledMap<Expression, int, ExpressionHash> expressions;
+	PooledMap<int, int> constants;				// value number of each constant seen
+	std::vector<Change> log;
+	std::vector<int> visited;					// by block: the block whose paths were last walked
+	std::vector<int> pending;
+	std::vector<int> killed;					// by slot: likewise
+
+	void visit(IrProgram& program, int block);
+	void killStores(const IrProgram& program, int block);	// on paths from the immediate dominator
+	bool number(IrInstruction& instruction);	// returns false if it is removed
+	int newValue();
+	int valueOf(const IrOperand& operand);
+	IrOperand availableHolder(int value) const;
+	void setVariable(int slot, int value);
+	void setHolder(int value, const IrOperand& operand);
+	void rename(IrOperand& operand) const;
+	void undo(size_t mark);
+
+public:
+	// Statistics since the last reset()
+	size_t reusedCount;		// operations replaced by an earlier value
+
+	ValueNumbering();
+
+	/**
+	 * Clears the statistics, keeping internal buffers.
+	 */
+	void reset();
+
+	/**
+	 * Removes the repeated expressions of a whole program or one fragment.
+	 */
+	void run(IrProgram& program);
+};
@@ -0,0 +1,436 @@
+#include "ValueRanges.h"
+#include "AllocProfiler.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+	// Results that do not fit in an int overflow, which is undefined
+	// unless the operation wraps around
+	ValueRange fit(long long low, long long high, bool wraps)
+	{
+		if (low >= INT_MIN && high <= INT_MAX)
+		{
+			return ValueRange(static_cast<int>(low), static_cast<int>(high));
+		}
+		if (wraps || low > INT_MAX || high < INT_MIN)
+		{
+			return ValueRange();
+		}
+		return ValueRange(static_cast<int>(max(low, static_cast<long long>(INT_MIN))),
+			static_cast<int>(min(high, static_cast<long long>(INT_MAX))));
+	}
+
+	ValueRange fitCorners(long long a, long long b, long long c, long long d, bool wraps)
+	{
+		return fit(min(min(a, b), min(c, d)), max(max(a, b), max(c, d)), wraps);
+	}
+
+	// Truncating division grows with the dividend and, for a divisor of
+	// one sign, moves one way with the divisor, so the corners are the
+	// extremes
+	ValueRange divideBy(const ValueRange& dividend, long long low, long long high)
+	{
+		return fitCorners(dividend.low / low, dividend.low / high, dividend.high / low, dividend.high / high, false);
+	}
+
+	IrCompare mirror(IrCompare compare)
+	{
+		switch (compare)
+		{
+		case IrCompare::Less: return IrCompare::Greater;
+		case IrCompare::Greater: return IrCompare::Less;
+		case IrCompare::LessEqual: return IrCompare::GreaterEqual;
+		case IrCompare::GreaterEqual: return IrCompare::LessEqual;
+		default: return compare;
+		}
+	}
+
+	// The part of value for which "value compare other" can hold
+	ValueRange narrow(const ValueRange& value, IrCompare compare, const ValueRange& other)
+	{
+		long long low = value.low;
+		long long high = value.high;
+		switch (compare)
+		{
+		case IrCompare::Less:
+			high = min(high, other.high - 1LL);
+			break;
+		case IrCompare::LessEqual:
+			high = min(high, static_cast<long long>(other.high));
+			break;
+		case IrCompare::Greater:
+			low = max(low, other.low + 1LL);
+			break;
+		case IrCompare::GreaterEqual:
+			low = max(low, static_cast<long long>(other.low));
+			break;
+		case IrCompare::Equal:
+			low = max(low, static_cast<long long>(other.low));
+			high = min(high, static_cast<long long>(other.high));
+			break;
+		case IrCompare::NotEqual:
+			if (other.low == other.high)
+			{
+				low += low == other.low ? 1 : 0;
+				high -= high == other.low ? 1 : 0;
+			}
+			break;
+		}
+		if (low > high)
+		{
+			return ValueRange::empty();
+		}
+		return ValueRange(static_cast<int>(low), static_cast<int>(high));
+	}
+}
+
+ValueRange ValueRange::join(const ValueRange& a, const ValueRange& b)
+{
+	return ValueRange(min(a.low, b.low), max(a.high, b.high));
+}
+
+ValueRanges::ValueRanges()
+	: slots(0), analyzed(false)
+{
+}
+
+bool ValueRanges::compute(const IrProgram& program, const ControlFlowGraph& graph)
+{
+	MIDLANG_ALLOC_PHASE(AllocPhase::Optimize);
+	MIDLANG_ALLOC_CATEGORY(AllocCategory::Vectors);
+
+	slots = program.variableNames.size();
+	size_t blocks = program.blocks.size();
+	analyzed = blocks > 0 && blocks * (slots + 1) <= maxStates;
+	if (!analyzed)
+	{
+		return false;
+	}
+
+	entry.assign(blocks * slots, ValueRange::empty());
+	fill(entry.begin(), entry.begin() + slots, ValueRange());
+	reached.assign(blocks, 0);
+	reached[0] = 1;
+	walks.assign(blocks, 0);
+	temporaries.assign(program.temporaryCount, ValueRange::empty());
+	forward.assign(blocks, 1);
+	for (int block : graph.order)
+	{
+		for (int predecessor : graph.predecessors[block])
+		{
+			if (graph.orderNumber[predecessor] >= graph.orderNumber[block])
+			{
+				forward[block] = 0;
+			}
+		}
+	}
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int block : graph.order)
+		{
+			if (reached[block])
+			{
+				walks[block]++;
+				changed |= walk(program, block, Walk::Widen);
+			}
+		}
+	}
+
+	// Each narrowing walk starts every block from the ranges of the walk
+	// before, so its results are still sound and can only shrink
+	for (int round = 0; round < 2; round++)
+	{
+		narrowed.assign(entry.size(), ValueRange::empty());
+		fill(narrowed.begin(), narrowed.begin() + slots, ValueRange());
+		narrowedReached.assign(blocks, 0);
+		narrowedReached[0] = 1;
+		for (int block : graph.order)
+		{
+			if (reached[block])
+			{
+				walk(program, block, Walk::Narrow);
+			}
+		}
+		for (size_t i = 0; i < entry.size(); i++)
+		{
+			entry[i] = ValueRange(max(entry[i].low, narrowed[i].low), min(entry[i].high, narrowed[i].high));
+		}
+		for (size_t block = 0; block < blocks; block++)
+		{
+			reached[block] &= narrowedReached[block];
+		}
+	}
+
+	stored.assign(slots, ValueRange::empty());
+	for (int block : graph.order)
+	{
+		if (reached[block])
+		{
+			walk(program, block, Walk::Record);
+		}
+	}
+	return true;
+}
+
+bool ValueRanges::walk(const IrProgram& program, int block, Walk kind)
+{
+	current.assign(entry.begin() + block * slots, entry.begin() + (block + 1) * slots);
+	if (kind == Walk::Narrow && forward[block])
+	{
+		// Every way into the block has been walked already, so what they
+		// passed on holds as well as the ranges of the walk before
+		if (!narrowedReached[block])
+		{
+			return false;
+		}
+		const ValueRange* state = &narrowed[block * slots];
+		for (size_t slot = 0; slot < slots; slot++)
+		{
+			current[slot] = ValueRange(max(current[slot].low, state[slot].low), min(current[slot].high, state[slot].high));
+		}
+	}
+	const vector<IrInstruction>& instructions = program.blocks[block].instructions;
+	for (const IrInstruction& instruction : instructions)
+	{
+		if (!instruction.definesValue())
+		{
+			continue;
+		}
+		ValueRange value = evaluate(instruction);
+		const IrOperand& dest = instruction.dest;
+		if (dest.kind == IrOperand::Temporary && static_cast<size_t>(dest.value) < temporaries.size())
+		{
+			temporaries[dest.value] = value;
+		}
+		else if (dest.kind == IrOperand::Variable && static_cast<size_t>(dest.value) < slots)
+		{
+			current[dest.value] = value;
+			if (kind == Walk::Record)
+			{
+				stored[dest.value] = ValueRange::join(stored[dest.value], value);
+			}
+		}
+	}
+
+	if (kind == Walk::Record || instructions.empty())
+	{
+		return false;
+	}
+	const IrInstruction& last = instructions.back();
+	if (last.opcode == IrOpcode::Jump || (last.opcode == IrOpcode::Branch && last.target == last.falseTarget))
+	{
+		return pass(last.target, nullptr, false, kind);
+	}
+	if (last.opcode == IrOpcode::Branch)
+	{
+		bool changed = pass(last.target, &last, true, kind);
+		changed |= pass(last.falseTarget, &last, false, kind);
+		return changed;
+	}
+	return false;
+}
+
+bool ValueRanges::pass(int successor, const IrInstruction* branch, bool taken, Walk kind)
+{
+	edge = current;
+	if (branch != nullptr)
+	{
+		IrCompare compare = taken ? branch->compare : IrProgram::negate(branch->compare);
+		ValueRange left = rangeIn(edge, branch->left);
+		ValueRange right = rangeIn(edge, branch->right);
+		if (decide(compare, left, right) == 0)
+		{
+			return false;
+		}
+		if (branch->left.kind == IrOperand::Variable && static_cast<size_t>(branch->left.value) < slots)
+		{
+			edge[branch->left.value] = left = narrow(left, compare, right);
+		}
+		if (branch->right.kind == IrOperand::Variable && static_cast<size_t>(branch->right.value) < slots)
+		{
+			edge[branch->right.value] = narrow(rangeIn(edge, branch->right), mirror(compare), left);
+		}
+		for (const ValueRange& range : edge)
+		{
+			if (range.isEmpty())
+			{
+				return false;
+			}
+		}
+	}
+
+	bool widen = kind == Walk::Widen;
+	vector<ValueRange>& states = widen ? entry : narrowed;
+	vector<char>& into = widen ? reached : narrowedReached;
+	bool changed = !into[successor];
+	into[successor] = 1;
+	ValueRange* state = &states[successor * slots];
+	for (size_t slot = 0; slot < slots; slot++)
+	{
+		ValueRange joined = ValueRange::join(state[slot], edge[slot]);
+		if (joined == state[slot])
+		{
+			continue;
+		}
+		if (widen && walks[successor] >= 2)
+		{
+			joined.low = joined.low < state[slot].low ? INT_MIN : joined.low;
+			joined.high = joined.high > state[slot].high ? INT_MAX : joined.high;
+		}
+		state[slot] = joined;
+		changed = true;
+	}
+	return changed;
+}
+
+void ValueRanges::enter(int block)
+{
+	current.assign(entry.begin() + block * slots, entry.begin() + (block + 1) * slots);
+}
+
+void ValueRanges::step(const IrInstruction& instruction)
+{
+	if (instruction.definesValue() && instruction.dest.kind == IrOperand::Variable
+		&& static_cast<size_t>(instruction.dest.value) < slots)
+	{
+		current[instruction.dest.value] = evaluate(instruction);
+	}
+}
+
+ValueRange ValueRanges::rangeIn(const vector<ValueRange>& state, const IrOperand& operand) const
+{
+	switch (operand.kind)
+	{
+	case IrOperand::Constant:
+		return ValueRange(operand.value, operand.value);
+	case IrOperand::Variable:
+		if (static_cast<size_t>(operand.value) < slots)
+		{
+			return state[operand.value];
+		}
+		break;
+	case IrOperand::Temporary:
+		// Empty until the walk reaches the definition
+		if (static_cast<size_t>(operand.value) < temporaries.size() && !temporaries[operand.value].isEmpty())
+		{
+			return temporaries[operand.value];
+		}
+		break;
+	default:
+		break;
+	}
+	return ValueRange();
+}
+
+ValueRange ValueRanges::range(const IrOperand& operand) const
+{
+	return rangeIn(current, operand);
+}
+
+ValueRange ValueRanges::evaluate(const IrInstruction& instruction) const
+{
+	ValueRange left = range(instruction.left);
+	ValueRange right = range(instruction.right);
+	long long a = left.low;
+	long long b = left.high;
+	long long c = right.low;
+	long long d = right.high;
+	bool constantShift = c == d && c >= 0 && c < 32;
+
+	switch (instruction.opcode)
+	{
+	case IrOpcode::Copy:
+		return left;
+	case IrOpcode::Add:
+		return fit(a + c, b + d, instruction.wraps);
+	case IrOpcode::Subtract:
+		return fit(a - d, b - c, instruction.wraps);
+	case IrOpcode::Multiply:
+		return fitCorners(a * c, a * d, b * c, b * d, instruction.wraps);
+	case IrOpcode::MultiplyHigh:
+		// The upper half of the product grows with the product
+		return fitCorners((a * c) >> 32, (a * d) >> 32, (b * c) >> 32, (b * d) >> 32, false);
+	case IrOpcode::Divide:
+	{
+		// Division by zero is undefined, so only the other divisors count
+		ValueRange result = ValueRange::empty();
+		if (c < 0)
+		{
+			result = ValueRange::join(result, divideBy(left, c, min(d, -1LL)));
+		}
+		if (d > 0)
+		{
+			result = ValueRange::join(result, divideBy(left, max(c, 1LL), d));
+		}
+		return result.isEmpty() ? ValueRange() : result;
+	}
+	case IrOpcode::ShiftLeft:
+		if (constantShift)
+		{
+			return fit(a * (1LL << c), b * (1LL << c), true);
+		}
+		break;
+	case IrOpcode::ShiftRight:
+		if (constantShift)
+		{
+			return ValueRange(static_cast<int>(a >> c), static_cast<int>(b >> c));
+		}
+		break;
+	case IrOpcode::ShiftRightLogical:
+		if (constantShift)
+		{
+			// Negative values become the largest ones
+			if (c == 0 || a >= 0 || b < 0)
+			{
+				return c == 0 ? left : ValueRange(static_cast<int>(static_cast<unsigned>(a) >> c),
+					static_cast<int>(static_cast<unsigned>(b) >> c));
+			}
+			return ValueRange(0, static_cast<int>(0xffffffffu >> c));
+		}
+		break;
+	default:
+		break;
+	}
+	return ValueRange();
+}
+
+ValueRange ValueRanges::storedRange(int slot) const
+{
+	return static_cast<size_t>(slot) < stored.size() ? stored[slot] : ValueRange();
+}
+
+int ValueRanges::decide(IrCompare compare, const ValueRange& left, const ValueRange& right)
+{
+	if (left.isEmpty() || right.isEmpty())
+	{
+		return -1;
+	}
+	switch (compare)
+	{
+	case IrCompare::Less:
+		return left.high < right.low ? 1 : left.low >= right.high ? 0 : -1;
+	case IrCompare::LessEqual:
+		return left.high <= right.low ? 1 : left.low > right.high ? 0 : -1;
+	case IrCompare::Greater:
+		return decide(IrCompare::Less, right, left);
+	case IrCompare::GreaterEqual:
+		return decide(IrCompare::LessEqual, right, left);
+	case IrCompare::Equal:
+		if (left.low == left.high && left == right)
+		{
+			return 1;
+		}
+		return left.high < right.low || right.high < left.low ? 0 : -1;
+	case IrCompare::NotEqual:
+	{
+		int equal = decide(IrCompare::Equal, left, right);
+		return equal < 0 ? -1 : 1 - equal;
+	}
+	}
+	return -1;
+}
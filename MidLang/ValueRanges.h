@@ -0,0 +1,144 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include "ControlFlowGraph.h"
+#include "IR.h"
+
+/**
+ * The values an int may have: low to high. Empty (low > high) in code
+ * that is never reached.
+ */
+struct ValueRange
+{
+	int low;
+	int high;
+
+	ValueRange() : low(INT_MIN), high(INT_MAX) {}
+	ValueRange(int low, int high) : low(low), high(high) {}
+
+	static ValueRange empty() { return ValueRange(INT_MAX, INT_MIN); }
+
+	bool isEmpty() const { return low > high; }
+	bool isFull() const { return low == INT_MIN && high == INT_MAX; }
+	bool fits(int min, int max) const { return min <= low && high <= max; }
+
+	bool operator==(const ValueRange& other) const { return low == other.low && high == other.high; }
+	bool operator!=(const ValueRange& other) const { return !(*this == other); }
+
+	/**
+	 * The smallest range holding both.
+	 */
+	static ValueRange join(const ValueRange& a, const ValueRange& b);
+};
+
+/**
+ * ValueRanges (Range analysis)
+ *
+ * Purpose: The range of values each variable and temporary of an
+ * IrProgram can have at each point, so passes can decide comparisons,
+ * leave out sign corrections and choose narrower types.
+ *
+ * How it works:
+ * 1. Walks the reachable blocks in reverse postorder, starting each from
+ *    the join of the variable ranges its predecessors end with, and
+ *    computes the range of each result from those of its operands.
+ *    Arithmetic that does not wrap is assumed not to overflow, as in C++
+ * 2. A branch narrows the variables it compares on each edge: after
+ *    "if i < 10", i is at most 9 on the taken edge. An edge that cannot
+ *    be taken passes nothing on
+ * 3. The walks repeat until nothing changes. A range that still grows at
+ *    the start of a block walked twice already is widened to INT_MIN or
+ *    INT_MAX on that side, so loops settle, and two more walks then
+ *    narrow the widened ranges again from the branches. In those, a
+ *    block that is only entered from blocks walked before it starts from
+ *    what they pass on, so a narrower range reaches the end of a loop
+ *    body through its ifs in one walk
+ * 4. A last walk records the range of every temporary (each is assigned
+ *    once) and of all values stored in each variable
+ *
+ * Variables are unknown at the start of a program or fragment. Programs
+ * with more than maxStates block and variable pairs are not analyzed.
+ * compute() keeps the capacity of its vectors between programs.
+ */
+class ValueRanges
+{
+	enum class Walk
+	{
+		Widen,		// to a fixed point, widening ranges that keep growing
+		Narrow,		// once more from the last ranges, into narrowed
+		Record		// temporaries and stored ranges only
+	};
+
+	size_t slots;
+	bool analyzed;
+	std::vector<ValueRange> entry;			// by block, slots each: ranges at its start
+	std::vector<char> reached;				// by block
+	std::vector<int> walks;					// by block: times walked while widening
+	std::vector<ValueRange> narrowed;		// entry and reached of a narrowing walk
+	std::vector<char> narrowedReached;
+	std::vector<char> forward;				// by block: entered only from blocks before it in the order
+	std::vector<ValueRange> temporaries;
+	std::vector<ValueRange> stored;			// by slot
+	std::vector<ValueRange> current;		// ranges of the variables at the cursor
+	std::vector<ValueRange> edge;			// work space of pass()
+
+	bool walk(const IrProgram& program, int block, Walk kind);	// true if a successor changed
+	bool pass(int successor, const IrInstruction* branch, bool taken, Walk kind);
+	ValueRange rangeIn(const std::vector<ValueRange>& state, const IrOperand& operand) const;
+
+public:
+	static const size_t maxStates = 1 << 20;
+
+	ValueRanges();
+
+	/**
+	 * Analyzes program, with graph built for it. Returns false (and
+	 * knows nothing) if the program is too large.
+	 */
+	bool compute(const IrProgram& program, const ControlFlowGraph& graph);
+
+	bool isAnalyzed() const { return analyzed; }
+
+	/**
+	 * False for blocks that no path reaches with the ranges found, such
+	 * as the arm of a branch that is never taken.
+	 */
+	bool isReached(int block) const { return analyzed && reached[block]; }
+
+	/**
+	 * Moves the cursor to the start of a reachable block.
+	 */
+	void enter(int block);
+
+	/**
+	 * Moves the cursor past an instruction of the block entered, as
+	 * analyzed: an instruction added since then is not understood.
+	 */
+	void step(const IrInstruction& instruction);
+
+	/**
+	 * The range of an operand at the cursor. Anything that was not
+	 * analyzed (new slots and temporaries) may be any int.
+	 */
+	ValueRange range(const IrOperand& operand) const;
+
+	/**
+	 * The range of the result of an arithmetic instruction or a Copy at
+	 * the cursor.
+	 */
+	ValueRange evaluate(const IrInstruction& instruction) const;
+
+	/**
+	 * Every value stored in a variable anywhere. Empty if it is never
+	 * stored.
+	 */
+	ValueRange storedRange(int slot) const;
+
+	/**
+	 * 1 if "left compare right" holds for all values of the ranges, 0 if
+	 * for none, -1 if that depends on the values.
+	 */
+	static int decide(IrCompare compare, const ValueRange& left, const ValueRange& right);
+};
@@ -0,0 +1,213 @@
+#include "midlang.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include "Compiler.h"
+
+using namespace std;
+
+struct midlang_context
+{
+	Compiler compiler;
+	string error;
+};
+
+namespace
+{
+	/**
+	 * Stream buffer that writes straight into a midlang_buffer,
+	 * growing it through the caller's callback.
+	 */
+	class OutputBuffer : public streambuf
+	{
+		midlang_buffer* buffer;
+
+	public:
+		bool failed;
+
+		OutputBuffer(midlang_buffer* buffer)
+			: buffer(buffer), failed(false)
+		{
+			setp(buffer->data + buffer->size, buffer->data + buffer->capacity);
+		}
+
+		size_t used() const
+		{
+			return buffer->size + static_cast<size_t>(pptr() - pbase());
+		}
+
+		/**
+		 * Makes room for at least needed bytes in total.
+		 */
+		bool reserve(size_t needed)
+		{
+			if (needed <= buffer->capacity)
+			{
+				return true;
+			}
+
+			size_t size = used();
+			size_t capacity = max(needed, max(buffer->capacity * 2, static_cast<size_t>(256)));
+			char* data = buffer->grow != nullptr
+				? buffer->grow(buffer->user_data, buffer->data, capacity)
+				: static_cast<char*>(realloc(buffer->data, capacity));
+			if (data == nullptr)
+			{
+				failed = true;
+				return false;
+			}
+
+			buffer->data = data;
+			buffer->capacity = capacity;
+			buffer->size = size;
+			setp(data + size, data + capacity);
+			return true;
+		}
+
+		/**
+		 * Records the written length and NUL-terminates the contents.
+		 */
+		bool finish()
+		{
+			size_t size = used();
+			if (!reserve(size + 1))
+			{
+				return false;
+			}
+			buffer->size = size;
+			buffer->data[size] = '\0';
+			setp(buffer->data + size, buffer->data + buffer->capacity);
+			return true;
+		}
+
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			if (traits_type::eq_int_type(ch, traits_type::eof()))
+			{
+				return traits_type::not_eof(ch);
+			}
+			if (!reserve(used() + 1))
+			{
+				return traits_type::eof();
+			}
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+			return ch;
+		}
+
+		streamsize xsputn(const char* text, streamsize count) override
+		{
+			size_t length = static_cast<size_t>(count);
+			if (epptr() - pptr() < count && !reserve(used() + length))
+			{
+				return 0;
+			}
+			memcpy(pptr(), text, length);
+			pbump(static_cast<int>(count));
+			return count;
+		}
+	};
+}
+
+midlang_context* midlang_context_create(void)
+{
+	// The compiler's constructor allocates too, and no exception may
+	// reach a C caller
+	try
+	{
+		return new midlang_context();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void midlang_context_destroy(midlang_context* context)
+{
+	delete context;
+}
+
+const char* midlang_context_error(const midlang_context* context)
+{
+	return context != nullptr ? context->error.c_str() : "";
+}
+
+midlang_status midlang_compile_with_context(midlang_context* context,
+	const char* source, size_t length, const midlang_options* options, midlang_buffer* output)
+{
+	if (context == nullptr || (source == nullptr && length != 0) || output == nullptr
+		|| (options != nullptr && options->size < offsetof(midlang_options, backend) + sizeof(options->backend)))
+	{
+		return MIDLANG_ERROR_INVALID_ARGUMENT;
+	}
+
+	size_t originalSize = output->size;
+	midlang_status status = MIDLANG_OK;
+
+	try
+	{
+		context->error.clear();
+		context->compiler.backend = options != nullptr && options->backend == MIDLANG_BACKEND_ASSEMBLY
+			? BackendKind::Assembly
+			: BackendKind::Structured;
+
+		OutputBuffer buffer(output);
+		ostream out(&buffer);
+		context->compiler.compile(source, length, out);
+
+		if (buffer.failed || !buffer.finish())
+		{
+			context->error = "Cannot grow the output buffer";
+			status = MIDLANG_ERROR_OUT_OF_MEMORY;
+		}
+	}
+	catch (const bad_alloc&)
+	{
+		context->error = "Out of memory";
+		status = MIDLANG_ERROR_OUT_OF_MEMORY;
+	}
+	catch (const exception& ex)
+	{
+		context->error = ex.what();
+		status = MIDLANG_ERROR_COMPILE;
+	}
+
+	if (status != MIDLANG_OK)
+	{
+		output->size = originalSize;
+	}
+	return status;
+}
+
+midlang_status midlang_compile(const char* source, size_t length,
+	const midlang_options* options, midlang_buffer* output)
+{
+	try
+	{
+		midlang_context context;
+		return midlang_compile_with_context(&context, source, length, options, output);
+	}
+	catch (...)
+	{
+		return MIDLANG_ERROR_OUT_OF_MEMORY;
+	}
+}
+
+void midlang_buffer_free(midlang_buffer* buffer)
+{
+	if (buffer != nullptr)
+	{
+		free(buffer->data);
+		buffer->data = nullptr;
+		buffer->size = 0;
+		buffer->capacity = 0;
+	}
+}
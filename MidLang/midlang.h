@@ -0,0 +1,125 @@
+#ifndef MIDLANG_H
+#define MIDLANG_H
+
+/**
+ * libmidlang C API
+ *
+ * Compiles MidLang source held in memory into C++ source written to a
+ * caller-provided growable buffer, without spawning the transpiler or
+ * touching the file system.
+ *
+ * All functions are reentrant: no global state is shared, so different
+ * threads may compile at the same time as long as each uses its own
+ * context (or midlang_compile(), which uses a temporary one).
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(MIDLANG_BUILD_SHARED)
+#define MIDLANG_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(MIDLANG_USE_SHARED)
+#define MIDLANG_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define MIDLANG_API __attribute__((visibility("default")))
+#else
+#define MIDLANG_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Output style of the generated C++ code.
+ */
+typedef enum midlang_backend
+{
+    MIDLANG_BACKEND_STRUCTURED = 0,   /* if/while blocks (transpiler) */
+    MIDLANG_BACKEND_ASSEMBLY = 1      /* labels and gotos (transpiler_asm) */
+} midlang_backend;
+
+typedef enum midlang_status
+{
+    MIDLANG_OK = 0,
+    MIDLANG_ERROR_COMPILE = 1,        /* syntax error; see midlang_context_error() */
+    MIDLANG_ERROR_OUT_OF_MEMORY = 2,  /* allocation or buffer growth failed */
+    MIDLANG_ERROR_INVALID_ARGUMENT = 3
+} midlang_status;
+
+/**
+ * Compilation options. size must be sizeof(midlang_options) as the caller
+ * was built with it, so that fields added in later versions can be told
+ * apart from the end of an older struct; MIDLANG_OPTIONS_INIT sets it and
+ * the defaults.
+ */
+typedef struct midlang_options
+{
+    size_t size;
+    midlang_backend backend;
+} midlang_options;
+
+#define MIDLANG_OPTIONS_INIT { sizeof(midlang_options), MIDLANG_BACKEND_STRUCTURED }
+
+/**
+ * Growable output buffer owned by the caller.
+ *
+ * Generated code is appended at data + size. When more room is needed,
+ * grow is called with the current data pointer and the required capacity
+ * and must return a block of at least that many bytes holding the old
+ * contents (or NULL on failure). If grow is NULL, realloc() is used and
+ * the data can be released with midlang_buffer_free().
+ *
+ * After a successful compile data[size] is a terminating NUL that is not
+ * counted in size. On failure size is restored to its previous value.
+ */
+typedef struct midlang_buffer
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+    char* (*grow)(void* user_data, char* data, size_t new_capacity);
+    void* user_data;
+} midlang_buffer;
+
+/**
+ * Reusable compilation context. Holds the error message of the last
+ * failed compilation. A context must not be used by two threads at once.
+ */
+typedef struct midlang_context midlang_context;
+
+/**
+ * Creates a context, or returns NULL if there is not enough memory.
+ */
+MIDLANG_API midlang_context* midlang_context_create(void);
+MIDLANG_API void midlang_context_destroy(midlang_context* context);
+
+/**
+ * Message describing why the last compilation with this context failed,
+ * or an empty string.
+ */
+MIDLANG_API const char* midlang_context_error(const midlang_context* context);
+
+/**
+ * Compiles length bytes of MidLang source. options may be NULL for the
+ * defaults (structured backend); options whose size does not cover the
+ * backend give MIDLANG_ERROR_INVALID_ARGUMENT.
+ */
+MIDLANG_API midlang_status midlang_compile_with_context(midlang_context* context,
+    const char* source, size_t length, const midlang_options* options, midlang_buffer* output);
+
+/**
+ * Same as midlang_compile_with_context() with a temporary context.
+ */
+MIDLANG_API midlang_status midlang_compile(const char* source, size_t length,
+    const midlang_options* options, midlang_buffer* output);
+
+/**
+ * Releases a buffer grown with realloc() (grow == NULL) and resets it.
+ */
+MIDLANG_API void midlang_buffer_free(midlang_buffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIDLANG_H */
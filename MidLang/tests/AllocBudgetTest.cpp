@@ -0,0 +1,176 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include "AllocProfiler.h"
+#include "Compiler.h"
+
+using namespace std;
+
+namespace
+{
+	// Allocations per token a compiler may make after one compilation: it
+	// makes about 0.4 with libstdc++, as its pools are still filling (none
+	// once warm, see checkReuse), and the rest leaves room for other libraries
+	const double budget = 0.75;
+
+	const char* const source =
+		"var n = inputInt();\n"
+		"var sum = 0;\n"
+		"var odd = 0;\n"
+		"var i = 0;\n"
+		"while (i < n) {\n"
+		"    sum = sum + i * 3;\n"
+		"    if (i / 2 * 2 != i) {\n"
+		"        odd = odd + 1;\n"
+		"    } else {\n"
+		"        print(i);\n"
+		"    }\n"
+		"    i = i + 1;\n"
+		"}\n"
+		"var j = 0;\n"
+		"while (j < 8) {\n"
+		"    sum = sum - j;\n"
+		"    j = j + 1;\n"
+		"}\n"
+		"if (sum > 100) {\n"
+		"    println(sum);\n"
+		"} else {\n"
+		"    println(odd);\n"
+		"}\n";
+
+	// A tiny program for the reuse benchmark, compiled many times by one
+	// compiler once the buffers and pools it draws on have grown to size
+	const char* const tinySource =
+		"var x = inputInt();\n"
+		"var y = x * 2 + 1;\n"
+		"if (y > 10) {\n"
+		"    println(y);\n"
+		"} else {\n"
+		"    println(x);\n"
+		"}\n"
+		"while (x > 0) {\n"
+		"    x = x - 1;\n"
+		"}\n";
+	const int warmUpCompilations = 100;
+	const int reusedCompilations = 100000;
+
+	/**
+	 * Discards the generated code without allocating, so the test only
+	 * counts the compiler's own allocations.
+	 */
+	class NullBuffer : public streambuf
+	{
+	protected:
+		int overflow(int c) override
+		{
+			return c;
+		}
+	};
+
+	bool check(BackendKind backend, const char* name)
+	{
+		NullBuffer buffer;
+		ostream out(&buffer);
+		Compiler compiler(backend);
+
+		// The first compilation grows the buffers that later ones reuse
+		compiler.compile(source, out);
+		AllocProfiler::reset();
+		compiler.compile(source, out);
+
+		double perToken = AllocProfiler::allocationsPerToken(compiler.tokenCount);
+		ostringstream report;
+		AllocProfiler::report(report, compiler.tokenCount);
+		ostringstream figure;
+		figure << "Compiler (all but other): " << AllocProfiler::compiler().allocations << " allocations, "
+			<< AllocProfiler::compiler().bytes << " bytes (" << perToken << " per token)";
+
+		bool passed = true;
+		if (report.str().find(figure.str()) == string::npos)
+		{
+			cerr << name << ": the report does not show \"" << figure.str() << "\":" << endl << report.str();
+			passed = false;
+		}
+		if (perToken > budget)
+		{
+			cerr << name << ": " << perToken << " allocations per token exceeds the budget of " << budget
+				<< endl << report.str();
+			passed = false;
+		}
+		return passed;
+	}
+
+	/**
+	 * Compiles the tiny program 100,000 times with one warmed-up compiler
+	 * and checks that none of those compilations allocates. Prints the
+	 * time per compilation, and what the first compilation allocated for
+	 * comparison. Only the compiler's phases count: the IR checks of
+	 * debug builds allocate in "other".
+	 */
+	bool checkReuse(BackendKind backend, const char* name)
+	{
+		NullBuffer buffer;
+		ostream out(&buffer);
+		Compiler compiler(backend);
+		size_t length = strlen(tinySource);
+
+		AllocProfiler::reset();
+		compiler.compile(tinySource, length, out);
+		size_t firstAllocations = AllocProfiler::compiler().allocations;
+		for (int i = 1; i < warmUpCompilations; i++)
+		{
+			compiler.compile(tinySource, length, out);
+		}
+
+		AllocProfiler::reset();
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < reusedCompilations; i++)
+		{
+			compiler.compile(tinySource, length, out);
+		}
+		chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+		size_t allocations = AllocProfiler::compiler().allocations;
+
+		cout << name << ": " << reusedCompilations << " compilations in " << elapsed.count() / 1000 << " ms ("
+			<< elapsed.count() / reusedCompilations << " us each), " << allocations << " allocations after "
+			<< warmUpCompilations << " to warm up; the first made " << firstAllocations << endl;
+		if (allocations != 0)
+		{
+			cerr << name << ": a reused compiler still allocates" << endl;
+			AllocProfiler::report(cerr, compiler.tokenCount);
+			return false;
+		}
+		return true;
+	}
+}
+
+/**
+ * Checks that a warmed-up compiler stays within its allocation budget,
+ * and that the report prints the figure the budget is checked against.
+ * With --reuse, runs the reuse benchmark instead: a warmed-up compiler
+ * must not allocate at all.
+ */
+int main(int argc, char* argv[])
+{
+	if (!AllocProfiler::enabled())
+	{
+		cerr << "This test needs a build with MIDLANG_ALLOC_PROFILE defined" << endl;
+		return 1;
+	}
+
+	bool passed;
+	if (argc > 1 && strcmp(argv[1], "--reuse") == 0)
+	{
+		passed = checkReuse(BackendKind::Structured, "structured");
+		passed &= checkReuse(BackendKind::Assembly, "assembly");
+	}
+	else
+	{
+		passed = check(BackendKind::Structured, "structured");
+		passed &= check(BackendKind::Assembly, "assembly");
+	}
+	return passed ? 0 : 1;
+}
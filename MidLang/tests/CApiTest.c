@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "midlang.h"
+
+/*
+ * Checks the C API of libmidlang through the shared library, from C:
+ * compiling with and without a context, growing the output buffer with
+ * realloc() and with a callback, failures that leave the buffer as it
+ * was, the error message of a failed compilation, and compiling again
+ * with the context that failed.
+ */
+
+static const char program[] =
+	"var n = inputInt();\n"
+	"var i = 0;\n"
+	"while (i < n) {\n"
+	"    println(i * i);\n"
+	"    i = i + 1;\n"
+	"}\n";
+
+static int failures = 0;
+
+static void check(int condition, const char* what)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "Failed: %s\n", what);
+		failures++;
+	}
+}
+
+/* Grows with realloc() like the default, counting calls, until limit */
+typedef struct growth
+{
+	int calls;
+	int limit;
+} growth;
+
+static char* grow(void* user_data, char* data, size_t new_capacity)
+{
+	growth* state = (growth*)user_data;
+	if (state->calls == state->limit)
+	{
+		return NULL;
+	}
+	state->calls++;
+	return (char*)realloc(data, new_capacity);
+}
+
+static void checkCompile(void)
+{
+	midlang_buffer output = { 0 };
+	midlang_options options = MIDLANG_OPTIONS_INIT;
+	midlang_buffer assembly = { 0 };
+	midlang_buffer none = { 0 };
+
+	check(midlang_compile(program, strlen(program), NULL, &output) == MIDLANG_OK, "midlang_compile");
+	check(output.data != NULL && strstr(output.data, "int main()") != NULL, "midlang_compile writes a program");
+	check(output.data != NULL && strlen(output.data) == output.size, "the output ends with a NUL after size");
+	check(output.capacity > output.size, "the capacity holds the NUL");
+	check(strstr(output.data, "goto") == NULL, "the structured backend by default");
+
+	options.backend = MIDLANG_BACKEND_ASSEMBLY;
+	check(midlang_compile(program, strlen(program), &options, &assembly) == MIDLANG_OK,
+		"midlang_compile with options");
+	check(assembly.data != NULL && strstr(assembly.data, "goto") != NULL, "the assembly backend");
+
+	options.size = 0;
+	check(midlang_compile(program, strlen(program), &options, &none) == MIDLANG_ERROR_INVALID_ARGUMENT,
+		"options without their size");
+	check(midlang_compile(NULL, 1, NULL, &none) == MIDLANG_ERROR_INVALID_ARGUMENT, "no source");
+	check(midlang_compile(program, strlen(program), NULL, NULL) == MIDLANG_ERROR_INVALID_ARGUMENT, "no buffer");
+	check(none.data == NULL && none.size == 0, "invalid arguments leave the buffer alone");
+
+	midlang_buffer_free(&output);
+	check(output.data == NULL && output.size == 0 && output.capacity == 0, "midlang_buffer_free resets the buffer");
+	midlang_buffer_free(&output);
+	midlang_buffer_free(NULL);
+	midlang_buffer_free(&assembly);
+}
+
+static void checkContext(void)
+{
+	midlang_context* context = midlang_context_create();
+	midlang_buffer expected = { 0 };
+	midlang_buffer output = { 0 };
+	midlang_buffer small = { 0 };
+	growth state = { 0, -1 };
+	growth limited = { 0, 1 };
+	static const char header[] = "// generated\n";
+	static const char syntaxError[] = "var x = 1;\nprintln(x +);\n";
+	static const char undeclared[] = "var x = 1;\nprintln(y);\n";
+
+	check(context != NULL, "midlang_context_create");
+	if (context == NULL)
+	{
+		return;
+	}
+	check(strcmp(midlang_context_error(context), "") == 0, "no error before the first compilation");
+	check(strcmp(midlang_context_error(NULL), "") == 0, "no error without a context");
+	check(midlang_compile_with_context(NULL, program, strlen(program), NULL, &output)
+		== MIDLANG_ERROR_INVALID_ARGUMENT, "no context");
+
+	check(midlang_compile(program, strlen(program), NULL, &expected) == MIDLANG_OK, "the expected output");
+
+	/* Appends to what the buffer holds, growing it from 16 bytes */
+	output.data = (char*)malloc(16);
+	output.capacity = 16;
+	output.grow = grow;
+	output.user_data = &state;
+	memcpy(output.data, header, strlen(header));
+	output.size = strlen(header);
+	check(midlang_compile_with_context(context, program, strlen(program), NULL, &output) == MIDLANG_OK,
+		"midlang_compile_with_context");
+	check(state.calls > 1, "the buffer grows through the callback");
+	check(output.size == strlen(header) + expected.size, "the output is appended");
+	check(memcmp(output.data, header, strlen(header)) == 0, "the buffer keeps what it held");
+	check(strcmp(output.data + strlen(header), expected.data) == 0, "a context compiles as midlang_compile does");
+
+	/* A callback that fails leaves the buffer at its size */
+	small.data = (char*)malloc(16);
+	small.capacity = 16;
+	small.grow = grow;
+	small.user_data = &limited;
+	memcpy(small.data, header, strlen(header));
+	small.size = strlen(header);
+	check(midlang_compile_with_context(context, program, strlen(program), NULL, &small)
+		== MIDLANG_ERROR_OUT_OF_MEMORY, "a callback that cannot grow the buffer");
+	check(limited.calls == 1, "the callback is called until it fails");
+	check(small.size == strlen(header) && memcmp(small.data, header, strlen(header)) == 0,
+		"a failed compilation keeps the contents");
+	check(strcmp(midlang_context_error(context), "Cannot grow the output buffer") == 0,
+		"the message for a buffer that cannot grow");
+	free(small.data);
+
+	output.size = 0;
+	check(midlang_compile_with_context(context, syntaxError, strlen(syntaxError), NULL, &output)
+		== MIDLANG_ERROR_COMPILE, "a syntax error");
+	check(strcmp(midlang_context_error(context), "Unexpected token: 15 at line 2, column 12") == 0,
+		"the message for a syntax error");
+	check(output.size == 0, "a syntax error keeps the size");
+
+	check(midlang_compile_with_context(context, undeclared, strlen(undeclared), NULL, &output)
+		== MIDLANG_ERROR_COMPILE, "an undeclared variable");
+	check(strcmp(midlang_context_error(context), "Undeclared variable 'y' at line 2, column 9") == 0,
+		"the message for an undeclared variable");
+
+	/* The context that failed compiles the same code again */
+	check(midlang_compile_with_context(context, program, strlen(program), NULL, &output) == MIDLANG_OK,
+		"compiling again after a failure");
+	check(strcmp(midlang_context_error(context), "") == 0, "a compilation clears the message");
+	check(output.size == expected.size && strcmp(output.data, expected.data) == 0,
+		"the output after a failure");
+
+	free(output.data);
+	midlang_buffer_free(&expected);
+	midlang_context_destroy(context);
+	midlang_context_destroy(NULL);
+}
+
+int main(void)
+{
+	checkCompile();
+	checkContext();
+	if (failures == 0)
+	{
+		printf("All C API checks passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "GeneratedProgram.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+string compilerCommand(int argc, char* argv[], int first)
+{
+	string command;
+	for (int i = first; i < argc; i++)
+	{
+		if (!command.empty())
+		{
+			command += " ";
+		}
+		command += argv[i];
+	}
+	return command;
+}
+
+bool runGeneratedProgram(const string& compiler, const string& base, const string& code,
+	const string& input, const string& expected, bool fails)
+{
+	{
+		ofstream source(base + ".cpp");
+		source << code;
+		ofstream in(base + ".in");
+		in << input;
+	}
+
+	string build = compiler + " " + base + ".cpp -o " + base;
+	if (system(build.c_str()) != 0)
+	{
+		cerr << base << ": could not build the generated code with: " << build << endl;
+		return false;
+	}
+	string run = "./" + base + " < " + base + ".in > " + base + ".out";
+	bool failed = system(run.c_str()) != 0;
+	if (failed != fails)
+	{
+		cerr << base << (failed ? ": the generated program failed" : ": the generated program did not fail")
+			<< " (see " << base << ".cpp)" << endl;
+		return false;
+	}
+
+	string output = readFile(base + ".out");
+	if (output == expected)
+	{
+		return true;
+	}
+	istringstream got(output);
+	istringstream want(expected);
+	string gotLine;
+	string wantLine;
+	int line = 1;
+	while (getline(want, wantLine) && getline(got, gotLine) && gotLine == wantLine)
+	{
+		line++;
+	}
+	cerr << base << ": the output differs from the expected output from line " << line << " on (see "
+		<< base << ".out and " << base << ".cpp)" << endl;
+	return false;
+}
+
+string readFile(const string& path)
+{
+	ifstream file(path);
+	ostringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Joins the command-line arguments from first on into the command that
+ * compiles generated C++, such as "c++ -std=c++17 -fsanitize=undefined".
+ */
+std::string compilerCommand(int argc, char* argv[], int first);
+
+/**
+ * Writes code to base.cpp, builds it into base with the compiler command,
+ * runs it with input and compares what it prints with expected. Returns
+ * false, after saying why on cerr, if any step fails. If fails is set,
+ * the program has to stop with an error (such as a division by zero)
+ * after printing expected.
+ */
+bool runGeneratedProgram(const std::string& compiler, const std::string& base, const std::string& code,
+	const std::string& input, const std::string& expected, bool fails = false);
+
+/**
+ * The contents of a file, or an empty string if it cannot be read.
+ */
+std::string readFile(const std::string& path);
@@ -0,0 +1,242 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Compiler.h"
+#include "GeneratedProgram.h"
+
+using namespace std;
+
+namespace
+{
+	struct Level
+	{
+		OptimizationLevel level;
+		const char* name;
+	};
+
+	const Level levels[] = {
+		{ OptimizationLevel::None, "O0" },
+		{ OptimizationLevel::Basic, "O1" },
+		{ OptimizationLevel::Full, "O2" },
+		{ OptimizationLevel::Size, "Os" }
+	};
+
+	enum class Mode
+	{
+		Whole,
+		Streaming,
+		Pipelined
+	};
+
+	// The pass settings the options change
+	struct Settings
+	{
+		FusionSettings fusion;
+		EvaluationSettings evaluation;
+		UnrollSettings unrolling;
+		ReductionSettings reduction;
+		SelectSettings selection;
+	};
+
+	/**
+	 * Reads a setting option as the driver does; false if option is not
+	 * one of them.
+	 */
+	bool parseSetting(const string& option, Settings& settings)
+	{
+		if (option.compare(0, 16, "--fusion-budget=") == 0)
+		{
+			settings.fusion.maxVariables = static_cast<size_t>(atoi(option.c_str() + 16));
+		}
+		else if (option.compare(0, 14, "--eval-budget=") == 0)
+		{
+			settings.evaluation.stepBudget = static_cast<size_t>(atoi(option.c_str() + 14));
+		}
+		else if (option.compare(0, 16, "--unroll-budget=") == 0)
+		{
+			settings.unrolling.fullBudget = static_cast<size_t>(atoi(option.c_str() + 16));
+		}
+		else if (option.compare(0, 16, "--unroll-factor=") == 0)
+		{
+			settings.unrolling.factor = atoi(option.c_str() + 16);
+		}
+		else if (option.compare(0, 25, "--reduction-accumulators=") == 0)
+		{
+			settings.reduction.accumulators = atoi(option.c_str() + 25);
+		}
+		else if (option.compare(0, 16, "--select-budget=") == 0)
+		{
+			settings.selection.budget = static_cast<size_t>(atoi(option.c_str() + 16));
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * The C++ code for source; the pass statistics go to statistics if it
+	 * is given.
+	 */
+	string transpile(BackendKind backend, OptimizationLevel level, Mode mode, const Settings& settings,
+		const string& source, ostream* statistics = nullptr)
+	{
+		Compiler compiler(backend);
+		compiler.passes.level = level;
+		compiler.fusion = settings.fusion;
+		compiler.evaluation = settings.evaluation;
+		compiler.unrolling = settings.unrolling;
+		compiler.reduction = settings.reduction;
+		compiler.selection = settings.selection;
+		ostringstream code;
+		istringstream in(source);
+		if (mode == Mode::Whole)
+		{
+			compiler.compile(source, code);
+		}
+		else if (mode == Mode::Streaming)
+		{
+			compiler.compileStreaming(in, code);
+		}
+		else
+		{
+			compiler.compilePipelined(in, code);
+		}
+		if (statistics != nullptr)
+		{
+			compiler.passes.printStatistics(*statistics);
+		}
+		return code.str();
+	}
+}
+
+/**
+ * Compiles a MidLang program with both code generators, at every
+ * optimization level and whole, streamed and pipelined, builds each
+ * distinct C++ program it gets and checks that it prints the expected
+ * output when given the input.
+ *
+ * The options come first:
+ * --name=NAME names the files written for the test (the program's name
+ *   by default), so tests of one program with other options can run at
+ *   the same time
+ * --fails expects the program to stop with an error, such as a division
+ *   by zero, after printing the expected output
+ * --stats=TEXT checks that the pass statistics (as --stats prints them)
+ *   of the whole program at -O2 with the structured generator contain
+ *   TEXT, such as "Fused 1 loop(s)"; it may be given more than once
+ * --fusion-budget=N, --eval-budget=N, --unroll-budget=N,
+ *   --unroll-factor=K, --reduction-accumulators=K and --select-budget=N
+ *   set the pass settings as the driver's options do
+ *
+ * Then comes the program, name.mid, with its input in name.in (if it
+ * reads any) and its output in name.expected. The rest is the command
+ * that compiles the generated C++, which is run with the source file and
+ * "-o <executable>" added.
+ */
+int main(int argc, char* argv[])
+{
+	string name;
+	bool fails = false;
+	vector<string> statistics;
+	Settings settings;
+	int first = 1;
+	for (; first < argc && string(argv[first]).compare(0, 2, "--") == 0; first++)
+	{
+		string option = argv[first];
+		if (option.compare(0, 7, "--name=") == 0)
+		{
+			name = option.substr(7);
+		}
+		else if (option == "--fails")
+		{
+			fails = true;
+		}
+		else if (option.compare(0, 8, "--stats=") == 0)
+		{
+			statistics.push_back(option.substr(8));
+		}
+		else if (!parseSetting(option, settings))
+		{
+			cerr << "Unknown option: " << option << endl;
+			return 1;
+		}
+	}
+	if (argc - first < 2)
+	{
+		cerr << "Usage: " << argv[0] << " [options] <program.mid> <c++ compiler> [flags...]" << endl;
+		return 1;
+	}
+	string path = argv[first];
+	string stem = path.substr(0, path.rfind('.'));
+	if (name.empty())
+	{
+		name = stem.substr(stem.find_last_of("/\\") + 1);
+	}
+	string source = readFile(path);
+	string input = readFile(stem + ".in");
+	string expected = readFile(stem + ".expected");
+	string compiler = compilerCommand(argc, argv, first + 1);
+	if (source.empty() || expected.empty())
+	{
+		cerr << "Cannot read " << path << " or " << stem << ".expected" << endl;
+		return 1;
+	}
+
+	bool passed = true;
+	if (!statistics.empty())
+	{
+		ostringstream report;
+		try
+		{
+			transpile(BackendKind::Structured, OptimizationLevel::Full, Mode::Whole, settings, source, &report);
+		}
+		catch (const exception& e)
+		{
+			report << e.what() << endl;
+		}
+		for (const string& text : statistics)
+		{
+			if (report.str().find(text) == string::npos)
+			{
+				cerr << name << ": the pass statistics do not contain \"" << text << "\":" << endl << report.str();
+				passed = false;
+			}
+		}
+	}
+
+	set<string> built;
+	for (BackendKind backend : { BackendKind::Structured, BackendKind::Assembly })
+	{
+		for (const Level& level : levels)
+		{
+			for (Mode mode : { Mode::Whole, Mode::Streaming, Mode::Pipelined })
+			{
+				string code;
+				try
+				{
+					code = transpile(backend, level.level, mode, settings, source);
+				}
+				catch (const exception& e)
+				{
+					cerr << name << ": " << e.what() << endl;
+					passed = false;
+					continue;
+				}
+				if (!built.insert(code).second)
+				{
+					continue;
+				}
+				string base = name + (backend == BackendKind::Assembly ? "_assembly_" : "_structured_") + level.name
+					+ (mode == Mode::Whole ? "" : mode == Mode::Streaming ? "_stream" : "_pipeline");
+				passed &= runGeneratedProgram(compiler, base, code, input, expected, fails);
+			}
+		}
+	}
+	return passed ? 0 : 1;
+}
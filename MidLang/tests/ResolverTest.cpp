@@ -0,0 +1,181 @@
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "Compiler.h"
+
+using namespace std;
+
+namespace
+{
+	struct Case
+	{
+		const char* name;
+		const char* source;
+		const char* message;			// of a whole program
+		const char* streamedMessage;	// when streamed, if it differs: only the first failing statement counts
+	};
+
+	const Case cases[] = {
+		{
+			"undeclared variable",
+			"var x = 1;\n"
+			"while (x < 3) {\n"
+			"    x = x + y;\n"
+			"}\n",
+			"Undeclared variable 'y' at line 3, column 13",
+			nullptr
+		},
+		{
+			"assignment to an undeclared variable",
+			"var x = 1;\n"
+			"if (x > 0) {\n"
+			"    count = x;\n"
+			"}\n",
+			"Assignment to undeclared variable 'count' at line 3, column 5",
+			nullptr
+		},
+		{
+			"redeclaration in a nested scope",
+			"var total = 0;\n"
+			"var i = 0;\n"
+			"while (i < 2) {\n"
+			"    var total = i;\n"
+			"    i = i + 1;\n"
+			"}\n",
+			"Variable 'total' is already declared at line 4, column 9 (previous declaration at line 1, column 5)",
+			nullptr
+		},
+		{
+			"redeclaration in a later statement",
+			"var a = 1;\n"
+			"println(a);\n"
+			"  var a = 2;\n",
+			"Variable 'a' is already declared at line 3, column 7 (previous declaration at line 1, column 5)",
+			nullptr
+		},
+		{
+			"variable of a sibling scope",
+			"if (1 < 2) {\n"
+			"    var t = 1;\n"
+			"} else {\n"
+			"    var t = 2;\n"
+			"}\n"
+			"println(t);\n",
+			"Undeclared variable 't' at line 6, column 9",
+			nullptr
+		},
+		{
+			"initializer reading its own variable",
+			"var v = v + 1;\n",
+			"Undeclared variable 'v' at line 1, column 9",
+			nullptr
+		},
+		{
+			"several errors",
+			"println(a);\n"
+			"var b = c;\n"
+			"b = d;\n",
+			"Undeclared variable 'a' at line 1, column 9\n"
+			"Undeclared variable 'c' at line 2, column 9\n"
+			"Undeclared variable 'd' at line 3, column 5",
+			"Undeclared variable 'a' at line 1, column 9"
+		}
+	};
+
+	enum class Mode
+	{
+		Whole,
+		Streaming,
+		Pipelined
+	};
+
+	const char* modeName(Mode mode)
+	{
+		return mode == Mode::Whole ? "whole" : mode == Mode::Streaming ? "streamed" : "pipelined";
+	}
+
+	/**
+	 * The message the compiler fails with, or an empty string if it does
+	 * not fail.
+	 */
+	string compileError(Compiler& compiler, Mode mode, const string& source)
+	{
+		ostringstream code;
+		istringstream in(source);
+		try
+		{
+			if (mode == Mode::Whole)
+			{
+				compiler.compile(source, code);
+			}
+			else if (mode == Mode::Streaming)
+			{
+				compiler.compileStreaming(in, code);
+			}
+			else
+			{
+				compiler.compilePipelined(in, code);
+			}
+		}
+		catch (const exception& e)
+		{
+			return e.what();
+		}
+		return "";
+	}
+}
+
+/**
+ * Checks the exact messages that the resolver gives for undeclared
+ * variables, assignments to them and redeclarations, with the line and
+ * column of the name. It compiles whole programs, and streams them one
+ * top-level statement at a time (Resolver::resolveTopLevel) on the main
+ * thread and pipelined. One compiler is used for all of them, so each
+ * also checks that a failure leaves nothing behind for the next
+ * compilation.
+ */
+int main()
+{
+	Compiler compiler(BackendKind::Structured);
+	bool passed = true;
+	for (const Case& test : cases)
+	{
+		for (Mode mode : { Mode::Whole, Mode::Streaming, Mode::Pipelined })
+		{
+			string expected = mode != Mode::Whole && test.streamedMessage != nullptr ? test.streamedMessage : test.message;
+			string message = compileError(compiler, mode, test.source);
+			if (message != expected)
+			{
+				cerr << test.name << " (" << modeName(mode) << "): expected" << endl << expected << endl
+					<< "but got" << endl << message << endl;
+				passed = false;
+			}
+		}
+	}
+
+	// Redeclaring a variable of a closed scope is not an error
+	const string valid =
+		"var i = 0;\n"
+		"while (i < 2) {\n"
+		"    var square = i * i;\n"
+		"    i = i + 1;\n"
+		"}\n"
+		"var square = 5;\n"
+		"println(square);\n";
+	for (Mode mode : { Mode::Whole, Mode::Streaming, Mode::Pipelined })
+	{
+		string message = compileError(compiler, mode, valid);
+		if (!message.empty())
+		{
+			cerr << "declaring a variable of a closed scope again (" << modeName(mode) << "): " << message << endl;
+			passed = false;
+		}
+	}
+
+	if (passed)
+	{
+		cout << "All resolver diagnostics are as expected" << endl;
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Compiler.h"
+#include "GeneratedProgram.h"
+#include "StrengthReducer.h"
+
+using namespace std;
+
+namespace
+{
+	// Divisors and factors written as constants; the pass rewrites all
+	// of them but 1, -1, 0 and INT_MIN, which are here to check that
+	const int divisors[] = {
+		2, 3, 5, 6, 7, 8, 10, 12, 25, 125, 641, 1000, 4096, 65536, 1000000007, 1073741824, INT_MAX,
+		-2, -3, -7, -8, -641, -65536, INT_MAX * -1, 1, -1, INT_MIN
+	};
+	const int factors[] = {
+		2, 3, 5, 6, 7, 9, 10, 12, 17, 24, 31, 33, 40, 96, 127, 1024, 65536, 1 << 30,
+		-2, -3, -6, -8, -10, -1024, 1, -1, 0
+	};
+
+	vector<int> dividends()
+	{
+		vector<int> values = {
+			INT_MIN, INT_MIN + 1, INT_MIN + 2, -(1 << 30) - 1, -(1 << 30), -65537, -65536, -1001, -1000,
+			-641, -9, -8, -7, -6, -3, -2, -1, 0, 1, 2, 3, 6, 7, 8, 9, 641, 1000, 1001, 65535, 65536,
+			(1 << 30) - 1, 1 << 30, 1000000006, 1000000007, INT_MAX - 2, INT_MAX - 1, INT_MAX
+		};
+		mt19937 random(20260101);
+		uniform_int_distribution<int> any(INT_MIN, INT_MAX);
+		uniform_int_distribution<int> small(-100000, 100000);
+		for (int i = 0; i < 200; i++)
+		{
+			values.push_back(any(random));
+			values.push_back(small(random));
+		}
+		return values;
+	}
+
+	string literal(long long value)
+	{
+		// MidLang has no unary minus
+		if (value == INT_MIN)
+		{
+			return "(0 - 2147483647 - 1)";
+		}
+		return value < 0 ? "(0 - " + to_string(-value) + ")" : to_string(value);
+	}
+
+	/**
+	 * Checks the multiplier and shift of divisionMagic against / for
+	 * every divisor the pass may ask it for.
+	 */
+	bool checkMagic(const vector<int>& values)
+	{
+		vector<int> magicDivisors;
+		for (int divisor = 3; divisor < 5000; divisor++)
+		{
+			magicDivisors.push_back(divisor);
+		}
+		mt19937 random(7);
+		uniform_int_distribution<int> any(5000, INT_MAX);
+		for (int i = 0; i < 2000; i++)
+		{
+			magicDivisors.push_back(any(random));
+		}
+		magicDivisors.push_back(INT_MAX);
+		magicDivisors.push_back(1000000007);
+
+		for (int divisor : magicDivisors)
+		{
+			if ((divisor & (divisor - 1)) == 0)
+			{
+				continue;
+			}
+			int multiplier;
+			int shift;
+			StrengthReducer::divisionMagic(divisor, multiplier, shift);
+			for (int x : values)
+			{
+				int quotient = static_cast<int>((static_cast<long long>(x) * multiplier) >> 32);
+				if (multiplier < 0)
+				{
+					quotient += x;
+				}
+				quotient = (quotient >> shift) + (x < 0 ? 1 : 0);
+				if (quotient != x / divisor)
+				{
+					cerr << "divisionMagic(" << divisor << ") gives " << x << " / " << divisor << " = "
+						<< quotient << " instead of " << x / divisor << endl;
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * A program that prints x / d and x * k for each input x, and the
+	 * output it must print.
+	 */
+	void makeProgram(const vector<int>& values, string& source, string& input, string& expected)
+	{
+		ostringstream program;
+		ostringstream output;
+		program << "var n = inputInt();\n"
+			"var x = 0;\n"
+			"var i = 0;\n"
+			"while (i < n) {\n"
+			"    x = inputInt();\n";
+		for (int divisor : divisors)
+		{
+			// INT_MIN / -1 overflows
+			if (divisor == -1)
+			{
+				program << "    if (x > " << literal(INT_MIN) << ") {\n"
+					"        println(x / " << literal(divisor) << ");\n"
+					"    }\n";
+			}
+			else
+			{
+				program << "    println(x / " << literal(divisor) << ");\n";
+			}
+		}
+		// Known non-negative dividends leave out the correction for x < 0
+		program << "    if (x >= 0) {\n";
+		for (int divisor : divisors)
+		{
+			program << "        println(x / " << literal(divisor) << ");\n";
+		}
+		program << "    }\n";
+		for (int factor : factors)
+		{
+			long long bound = factor == 0 ? INT_MAX : INT_MAX / llabs(factor);
+			program << "    if (x >= " << literal(-bound) << ") {\n"
+				"        if (x <= " << bound << ") {\n"
+				"            println(x * " << literal(factor) << ");\n"
+				"            println(" << literal(factor) << " * x);\n"
+				"        }\n"
+				"    }\n";
+		}
+		program << "    i = i + 1;\n"
+			"}\n";
+
+		// Products of an induction variable become additions
+		program << "var start = inputInt();\n"
+			"var j = start;\n"
+			"while (j < start + 300) {\n"
+			"    println(j * 37);\n"
+			"    println(j * " << literal(-12) << ");\n"
+			"    j = j + 7;\n"
+			"}\n";
+
+		ostringstream in;
+		in << values.size() << "\n";
+		for (int x : values)
+		{
+			in << x << "\n";
+			for (int divisor : divisors)
+			{
+				if (divisor != -1 || x != INT_MIN)
+				{
+					output << x / divisor << "\n";
+				}
+			}
+			if (x >= 0)
+			{
+				for (int divisor : divisors)
+				{
+					output << x / divisor << "\n";
+				}
+			}
+			for (int factor : factors)
+			{
+				long long bound = factor == 0 ? INT_MAX : INT_MAX / llabs(factor);
+				if (x >= -bound && x <= bound)
+				{
+					output << x * factor << "\n" << factor * x << "\n";
+				}
+			}
+		}
+		const int start = -150;
+		in << start << "\n";
+		for (int j = start; j < start + 300; j += 7)
+		{
+			output << j * 37 << "\n" << j * -12 << "\n";
+		}
+
+		source = program.str();
+		input = in.str();
+		expected = output.str();
+	}
+
+	/**
+	 * Transpiles the program, builds it with the C++ compiler command
+	 * and compares what it prints with the expected output.
+	 */
+	bool checkProgram(BackendKind backend, const char* name, const string& compiler, const string& source,
+		const string& input, const string& expected)
+	{
+		ostringstream code;
+		Compiler(backend).compile(source, code);
+		return runGeneratedProgram(compiler, string("strength_reduction_") + name, code.str(), input, expected);
+	}
+}
+
+/**
+ * Checks that the division and multiplication rewrites of StrengthReducer
+ * compute what / and * do, over boundary and random values: directly for
+ * the division multipliers, and through the code both generators write.
+ *
+ * The arguments are the command that compiles the generated C++, such as
+ * "c++ -std=c++17 -fsanitize=undefined"; it is run with the source file
+ * and "-o <executable>" added.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "Usage: " << argv[0] << " <c++ compiler> [flags...]" << endl;
+		return 1;
+	}
+	string compiler = compilerCommand(argc, argv, 1);
+
+	vector<int> values = dividends();
+	bool passed = checkMagic(values);
+
+	string source;
+	string input;
+	string expected;
+	makeProgram(values, source, input, expected);
+	passed &= checkProgram(BackendKind::Structured, "structured", compiler, source, input, expected);
+	passed &= checkProgram(BackendKind::Assembly, "assembly", compiler, source, input, expected);
+	return passed ? 0 : 1;
+}